@@ -0,0 +1,72 @@
+#ifndef ASYNCLOGGER_H
+#define ASYNCLOGGER_H
+
+#include <QtCore/QString>
+#include <QtCore/QFile>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <memory>
+
+enum class LogLevel : quint8 {
+    Debug,
+    Warning,
+    Error
+};
+
+// Background logger behind the LOG_* macros. Callers claim a slot in a
+// preallocated ring with one compare-and-swap, move their message into it
+// and return; nothing is formatted, allocated or written on their thread.
+// A writer thread drains the ring every few milliseconds, formats the
+// batch and appends it to a file that stays open. When the ring is full,
+// records are dropped and counted rather than blocking the caller.
+class AsyncLogger
+{
+public:
+    static AsyncLogger &instance();
+
+    void log(LogLevel level, QString message, const char *function, const char *file, int line);
+
+    // Records queued before start() are kept and written once the file is open
+    void start(const QString &filePath);
+    void stop();
+    void flush();
+    void setEcho(bool enable) { echo.store(enable, std::memory_order_relaxed); }
+
+    static const int CAPACITY = 8192; // power of two
+
+private:
+    struct Slot {
+        std::atomic<quint64> sequence;
+        qint64 timestamp; // microseconds since the epoch
+        quintptr thread;
+        const char *function;
+        const char *file;
+        int line;
+        LogLevel level;
+        QString message;
+    };
+
+    AsyncLogger();
+    ~AsyncLogger();
+
+    bool drain(QByteArray &batch);
+    void run();
+
+    std::unique_ptr<Slot[]> ring;
+    alignas(64) std::atomic<quint64> enqueuePos;
+    alignas(64) quint64 dequeuePos; // writer thread only
+    std::atomic<quint64> dropped;
+    std::atomic<bool> echo;
+
+    QFile file;
+    std::thread writer;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable drained;
+    bool running;
+    bool flushRequested;
+};
+
+#endif // ASYNCLOGGER_H
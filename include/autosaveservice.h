@@ -0,0 +1,53 @@
+#ifndef AUTOSAVESERVICE_H
+#define AUTOSAVESERVICE_H
+
+#include <QObject>
+#include <QHash>
+#include <QString>
+#include <QThreadPool>
+
+// Writes document snapshots off the GUI thread. The caller hands over a
+// QString copy, which only bumps a reference count; encoding and the
+// durable write (QSaveFile, which fsyncs before renaming into place) run on
+// a worker. At most one save per file is in flight: a snapshot arriving
+// while the previous one is still being written replaces any snapshot
+// already waiting, so a slow disk costs one pending copy, not a queue.
+// A snapshot hashing the same as the last one written to its file is
+// reported saved without touching the disk.
+class AutoSaveService : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit AutoSaveService(QObject *parent = nullptr);
+    ~AutoSaveService();
+
+    // 'revision' is handed back in saved() so the caller can tell whether
+    // the document changed while the write was running
+    void save(const QString &filePath, const QString &snapshot, quint64 revision);
+    bool isSaving(const QString &filePath) const { return jobs.contains(filePath); }
+    // Call when something else wrote the file, so the next save isn't skipped
+    void forget(const QString &filePath) { writtenHashes.remove(filePath); }
+
+    static QString writeSnapshot(const QString &filePath, const QString &snapshot);
+
+signals:
+    void saved(const QString &filePath, quint64 revision);
+    void saveFailed(const QString &filePath, const QString &message);
+
+private:
+    struct Job {
+        bool hasPending = false;
+        QString pendingSnapshot;
+        quint64 pendingRevision = 0;
+    };
+
+    void start(const QString &filePath, const QString &snapshot, quint64 revision);
+    void finish(const QString &filePath, quint64 revision, const QString &error, size_t hash);
+
+    QHash<QString, Job> jobs; // files with a write in flight
+    QHash<QString, size_t> writtenHashes;
+    QThreadPool pool;
+};
+
+#endif // AUTOSAVESERVICE_H
@@ -0,0 +1,45 @@
+#ifndef CHUNKSTORE_H
+#define CHUNKSTORE_H
+
+#include <QByteArray>
+#include <QList>
+#include <QSet>
+#include <QString>
+
+// Content-addressed storage for document snapshots. Data is cut into chunks
+// at content-defined boundaries (a rolling gear hash), so an edit only
+// changes the chunks around it and every other chunk keeps its boundaries
+// and its SHA-256 id. Chunks are stored compressed under their id, and
+// chunks already on disk are never written again: a small edit to a huge
+// document costs a few chunks plus the list of ids. Not thread-safe; the
+// owner keeps all calls on one thread.
+class ChunkStore
+{
+public:
+    explicit ChunkStore(const QString &directory);
+
+    // Writes the chunks of 'data' that aren't stored yet and returns the ids
+    // in order, or an empty list on failure
+    QList<QByteArray> store(const QByteArray &data);
+    // Deletes every chunk not in 'live'
+    void retain(const QSet<QByteArray> &live);
+    // Picks up chunks left by an earlier run, so retain() can collect them too
+    void scan();
+
+    static bool load(const QString &directory, const QList<QByteArray> &ids, QByteArray *data);
+    static QList<qsizetype> chunkBoundaries(const QByteArray &data);
+
+    static const int ID_SIZE = 32; // SHA-256
+
+private:
+    static QString chunkPath(const QString &directory, const QByteArray &id);
+
+    QString directory;
+    QSet<QByteArray> known; // ids written or seen on disk
+
+    static const int MIN_CHUNK = 2 * 1024;
+    static const int MAX_CHUNK = 64 * 1024;
+    static const int COMPRESSION_LEVEL = 1; // speed over ratio
+};
+
+#endif // CHUNKSTORE_H
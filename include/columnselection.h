@@ -0,0 +1,73 @@
+#ifndef COLUMNSELECTION_H
+#define COLUMNSELECTION_H
+
+#include <QtGui/QTextBlock>
+#include <QtGui/QFontMetricsF>
+#include <QtCore/QHash>
+
+class QTextDocument;
+
+// One row of a box selection. Positions are absolute document positions;
+// the virtual counts are columns of virtual space past the end of the line.
+struct ColumnSpan {
+    int startPosition;
+    int endPosition;
+    int startVirtual;
+    int endVirtual;
+};
+
+// Rectangular selection kept as a block range plus two x coordinates in
+// block-layout space. Rows are materialised lazily, so dragging over a huge
+// range only touches the rows that are painted or that enter/leave the box.
+class ColumnSelection
+{
+public:
+    ColumnSelection();
+
+    void setMetrics(const QFont &font, qreal tabStopDistance, qreal documentMargin);
+
+    void begin(const QTextBlock &block, qreal x);
+    void extendTo(const QTextBlock &block, qreal x);
+    void moveCaretTo(qreal x);
+    void clear();
+    void invalidate() { rowCache.clear(); }
+
+    bool isActive() const { return active; }
+    bool isEmpty() const;
+    bool containsBlock(int blockNumber) const;
+    int firstBlock() const { return qMin(anchorBlock, headBlock); }
+    int lastBlock() const { return qMax(anchorBlock, headBlock); }
+    int headBlockNumber() const { return headBlock; }
+    qreal leftX() const { return qMin(anchorX, headX); }
+    qreal rightX() const { return qMax(anchorX, headX); }
+    qreal caretX() const { return headX; }
+    int rowCount() const { return lastBlock() - firstBlock() + 1; }
+
+    ColumnSpan span(const QTextBlock &block) const;
+    qreal xForPosition(const QTextBlock &block, int position, int virtualColumns) const;
+    int positionForX(const QTextBlock &block, qreal x, int *virtualColumns) const;
+    qreal snappedX(const QTextBlock &block, qreal x) const;
+    // One column left (direction < 0) or right of x: a character inside the
+    // line, a space's width past its end
+    qreal stepX(const QTextBlock &block, qreal x, int direction) const;
+
+private:
+    qreal lineEndX(const QTextBlock &block) const;
+    qreal advanceTo(const QString &text, int length) const;
+    qreal stepAdvance(const QString &text, int *index, qreal x) const;
+
+    bool active;
+    int anchorBlock;
+    int headBlock;
+    qreal anchorX;
+    qreal headX;
+
+    QFontMetricsF metrics;
+    qreal tabStop;
+    qreal margin;
+    qreal spaceAdvance;
+
+    mutable QHash<int, ColumnSpan> rowCache;
+};
+
+#endif // COLUMNSELECTION_H
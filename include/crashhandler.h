@@ -7,29 +7,64 @@
 #include <QDir>
 #include <QDebug>
 #include <QCoreApplication>
+#include "asynclogger.h"
 
 class CrashHandler
 {
 public:
+    // Installs the signal handlers; cheap enough for the start of main()
     static void initialize();
+    // The log file, recovery path and report header; does file I/O, so it
+    // runs once the window is up. Until then a crash is reported on stderr.
+    static void initializeReporting();
+    static void shutdown();
     static void handleCrash(int signal);
-    static void logMessage(const QString& message, const QString& function = QString(), 
-                          const QString& file = QString(), int line = -1);
+    static void logMessage(LogLevel level, QString message, const char *function = nullptr,
+                           const char *file = nullptr, int line = -1)
+    {
+        AsyncLogger::instance().log(level, std::move(message), function, file, line);
+    }
     static QString getLogFilePath();
     static void enableDebugMode(bool enable);
 
+    // The text dumped to the recovery file on a crash. It is read from the
+    // signal handler, so the string must outlive the registration.
+    static void registerDocument(const QString *text);
+    static QString recoveryFilePath();
+    static bool hasRecoveryDump();
+    static QString readRecoveryDump();
+    static void clearRecoveryDump();
+
 private:
     static QString s_logFilePath;
     static bool s_debugMode;
-    static void ensureLogDirectoryExists();
-    static void writeToLog(const QString& message);
-    static QString getStackTrace();
     static QString getSystemInfo();
 };
 
-// Macro for easy logging
-#define LOG_DEBUG(msg) CrashHandler::logMessage(msg, __FUNCTION__, __FILE__, __LINE__)
-#define LOG_ERROR(msg) CrashHandler::logMessage(QString("ERROR: ") + msg, __FUNCTION__, __FILE__, __LINE__)
-#define LOG_WARNING(msg) CrashHandler::logMessage(QString("WARNING: ") + msg, __FUNCTION__, __FILE__, __LINE__)
+// Lowest level compiled in; set with -DTOAST_LOG_LEVEL=DEBUG|WARNING|ERROR|OFF
+#define TOAST_LOG_LEVEL_DEBUG 0
+#define TOAST_LOG_LEVEL_WARNING 1
+#define TOAST_LOG_LEVEL_ERROR 2
+#define TOAST_LOG_LEVEL_OFF 3
+#ifndef TOAST_LOG_LEVEL
+#define TOAST_LOG_LEVEL TOAST_LOG_LEVEL_DEBUG
+#endif
+
+// Macros for easy logging; levels below TOAST_LOG_LEVEL don't even evaluate their message
+#if TOAST_LOG_LEVEL <= TOAST_LOG_LEVEL_DEBUG
+#define LOG_DEBUG(msg) CrashHandler::logMessage(LogLevel::Debug, msg, __FUNCTION__, __FILE__, __LINE__)
+#else
+#define LOG_DEBUG(msg) do {} while (false)
+#endif
+#if TOAST_LOG_LEVEL <= TOAST_LOG_LEVEL_WARNING
+#define LOG_WARNING(msg) CrashHandler::logMessage(LogLevel::Warning, msg, __FUNCTION__, __FILE__, __LINE__)
+#else
+#define LOG_WARNING(msg) do {} while (false)
+#endif
+#if TOAST_LOG_LEVEL <= TOAST_LOG_LEVEL_ERROR
+#define LOG_ERROR(msg) CrashHandler::logMessage(LogLevel::Error, msg, __FUNCTION__, __FILE__, __LINE__)
+#else
+#define LOG_ERROR(msg) do {} while (false)
+#endif
 
-#endif // CRASHHANDLER_H 
\ No newline at end of file
+#endif // CRASHHANDLER_H
@@ -6,6 +6,7 @@
 #include <QCheckBox>
 #include <QPushButton>
 #include <QLabel>
+#include <QTimer>
 
 class FindDialog : public QDialog
 {
@@ -17,28 +18,37 @@ public:
     QString replaceText() const;
     bool caseSensitive() const;
     bool wholeWords() const;
+    bool regularExpression() const;
     bool searchBackwards() const;
     bool wrapAround() const;
 
 public slots:
     void showMessage(const QString &message);
+    void setMatchCount(int current, int total);
+    void showReplaceSummary(int count, qint64 elapsedMs);
+    // Off while the current document is read-only
+    void setReplaceEnabled(bool enabled);
 
 signals:
     void findNext();
     void findPrevious();
     void replaceRequested();
     void replaceAllRequested();
+    // Emitted once typing or option changes settle
+    void searchTextEdited();
 
 private slots:
     void enableFindButton(const QString &text);
     void replace();
     void replaceAll();
+    void scheduleIncrementalSearch();
 
 private:
     QLineEdit *searchLineEdit;
     QLineEdit *replaceLineEdit;
     QCheckBox *caseSensitiveCheckBox;
     QCheckBox *wholeWordsCheckBox;
+    QCheckBox *regexCheckBox;
     QCheckBox *searchBackwardsCheckBox;
     QCheckBox *wrapAroundCheckBox;
     QPushButton *findNextButton;
@@ -47,6 +57,11 @@ private:
     QPushButton *replaceAllButton;
     QPushButton *closeButton;
     QLabel *messageLabel;
+    QLabel *matchCountLabel;
+    QTimer *searchDebounceTimer;
+    bool replaceAllowed;
+
+    static const int SEARCH_DEBOUNCE_MS = 120;
 };
 
 #endif // FINDDIALOG_H 
\ No newline at end of file
@@ -0,0 +1,42 @@
+#ifndef REPLACEPREVIEWDIALOG_H
+#define REPLACEPREVIEWDIALOG_H
+
+#include <QDialog>
+#include "search/projectreplace.h"
+
+class QLabel;
+class QPushButton;
+class QTreeWidget;
+class QTreeWidgetItem;
+class QPlainTextEdit;
+
+// Lists every file a project-wide replace would change; selecting one shows
+// its changed lines. Unchecked files are left out of the commit.
+class ReplacePreviewDialog : public QDialog
+{
+    Q_OBJECT
+
+public:
+    ReplacePreviewDialog(const QVector<FileEdit> &edits, const QString &rootPath,
+                         QWidget *parent = nullptr);
+
+    QVector<FileEdit> selectedEdits() const;
+
+private slots:
+    void showDiff(QTreeWidgetItem *item);
+    void updateSummary();
+
+private:
+    void setupUi();
+    void createConnections();
+
+    QVector<FileEdit> edits;
+
+    QLabel *summaryLabel;
+    QTreeWidget *fileTree;
+    QPlainTextEdit *diffView;
+    QPushButton *applyButton;
+    QPushButton *cancelButton;
+};
+
+#endif // REPLACEPREVIEWDIALOG_H
@@ -2,7 +2,6 @@
 #define SETTINGSDIALOG_H
 
 #include <QDialog>
-#include <QSettings>
 
 class QTabWidget;
 class QFontComboBox;
@@ -89,8 +88,6 @@ private:
     QColor lineNumberBackgroundColor;
     QColor lineNumberForegroundColor;
     QColor currentLineColor;
-    
-    QSettings settings;
 };
 
 #endif // SETTINGSDIALOG_H 
\ No newline at end of file
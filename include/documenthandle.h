@@ -0,0 +1,43 @@
+#ifndef DOCUMENTHANDLE_H
+#define DOCUMENTHANDLE_H
+
+#include <QPointer>
+#include "editor.h"
+#include "sessionmanager.h"
+
+// One tab. Unloaded, a handle is just its DocumentState, plus the text when
+// there are unsaved changes. Loading gives it a CodeEditor, and with it the
+// QTextDocument, highlighter, layouts and undo history; unloading captures
+// the state again and frees all of that. The window keeps only the most
+// recently shown handles loaded.
+class DocumentHandle
+{
+public:
+    explicit DocumentHandle(const DocumentState &state = DocumentState());
+    ~DocumentHandle();
+
+    bool isLoaded() const { return !codeEditor.isNull(); }
+    CodeEditor *editor() const { return codeEditor; }
+    void attach(CodeEditor *editor); // takes ownership
+    void unload();
+
+    // As last stored; text shown in the editor may have moved on since
+    const DocumentState &savedState() const { return documentState; }
+    DocumentState state() const;
+    void storeState() { documentState = state(); }
+    void releaseSavedText();
+
+    QString filePath() const { return documentState.filePath; }
+    void setFilePath(const QString &filePath) { documentState.filePath = filePath; }
+    bool isModified() const;
+    void setModified(bool modified) { documentState.modified = modified; }
+    qsizetype loadedSize() const;
+
+    quint64 lastShown; // for least-recently-shown eviction
+
+private:
+    DocumentState documentState;
+    QPointer<CodeEditor> codeEditor;
+};
+
+#endif // DOCUMENTHANDLE_H
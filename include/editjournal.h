@@ -0,0 +1,68 @@
+#ifndef EDITJOURNAL_H
+#define EDITJOURNAL_H
+
+#include <QObject>
+#include <QFile>
+#include <QString>
+#include <QTimer>
+#include <QThreadPool>
+#include "chunkstore.h"
+
+// Write-ahead log of document edits for crash recovery. Every change is
+// appended as (position, removed length, inserted text), so the disk sees
+// roughly what was typed rather than the whole document. Records are
+// batched in memory and written on a worker. The log is split
+// into generations: checkpoint(text) starts a new journal at once and writes
+// the full text as that generation's base on a worker, then drops the older
+// generations. Checkpoints are lists of compressed chunks in a ChunkStore, so
+// a checkpoint after a small edit only writes the chunks that changed.
+// Recovery takes the newest complete checkpoint and replays the journals
+// from its generation on.
+class EditJournal : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit EditJournal(const QString &directory, QObject *parent = nullptr);
+    ~EditJournal();
+
+    // Returns false for an insertion over MAX_RECORD_CHARS; checkpoint instead
+    bool append(int position, int charsRemoved, const QString &inserted);
+    void flush();
+    void checkpoint(const QString &text);
+    qint64 bytesSinceCheckpoint() const { return journalBytes; }
+
+    static bool hasData(const QString &directory);
+    static bool recover(const QString &directory, QString *text);
+    static void discard(const QString &directory);
+
+    // Keeps the 32-bit payload size far from overflowing; bigger pastes
+    // are cheaper as a chunked checkpoint anyway
+    static const qsizetype MAX_RECORD_CHARS = 16 * 1024 * 1024;
+
+private:
+    bool openJournal(int newGeneration); // on the I/O thread
+    bool writeCheckpoint(int generation, const QString &text); // on the I/O thread
+    static void removeGenerationsBefore(const QString &directory, int generation);
+    static bool replayJournal(const QString &filePath, QString *text);
+    static QString journalPath(const QString &directory, int generation);
+    static QString checkpointPath(const QString &directory, int generation);
+    static QString chunkDirectory(const QString &directory);
+
+    QString directory;
+    QFile journal;
+    QByteArray pending;
+    QTimer *flushTimer;
+    ChunkStore chunks; // only touched on the I/O thread
+    QThreadPool ioPool;
+    int generation;
+    qint64 journalBytes;
+
+    static const quint32 MAGIC = 0x4c4e4a54; // "TJNL"
+    static const quint32 VERSION = 1;
+    static const quint32 CHECKPOINT_MAGIC = 0x504b4354; // "TCKP"
+    static const quint32 CHECKPOINT_VERSION = 1;
+    static const int FLUSH_DELAY = 1000; // ms
+};
+
+#endif // EDITJOURNAL_H
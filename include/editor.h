@@ -5,11 +5,12 @@
 #include <QtGui/QSyntaxHighlighter>
 #include <QtGui/QUndoStack>
 #include <QtGui/QUndoCommand>
-#include <QtCore/QSettings>
 #include <QtCore/QTimer>
 #include <QtCore/QHash>
 #include <QtCore/QVector>
 #include "splitviewcontainer.h"
+#include "columnselection.h"
+#include "gutterrenderer.h"
 
 class LineNumberArea;
 class SettingsDialog;
@@ -19,6 +20,10 @@ class QSize;
 class QWidget;
 class EditorToolBar;
 class EditorContextMenu;
+class FindAllEngine;
+class Minimap;
+struct SearchOptions;
+class SaveScheduler;
 
 // Forward declare CodeEditor for TextEditCommand
 class CodeEditor;
@@ -34,6 +39,7 @@ public:
 
 private:
     CodeEditor* editor;
+    bool applied; // pushed after the document already changed
     QString oldText;
     QString newText;
     int position;
@@ -101,19 +107,40 @@ public:
     void setFilePath(const QString& path) { filePath = path; emit filePathChanged(path); }
     QString getFilePath() const { return filePath; }
 
+    // Session state
+    const QString &documentSnapshot() const { return m_lastText; }
+    void setDocumentText(const QString &text);
+    QList<int> collapsedFolds() const;
+    void restoreFolds(const QList<int> &blocks);
+    // While deferred, text is shown without highlighting or fold detection;
+    // turning it off again catches up on both. Used while the window starts.
+    void setAnalysisDeferred(bool deferred);
+
     // View operations
     void resetZoom();
     void showReplaceDialog();
-    bool findNext() { return findNext(lastSearchText, lastCaseSensitive, lastWholeWords, true); }
-    bool findPrevious() { return findPrevious(lastSearchText, lastCaseSensitive, lastWholeWords, true); }
+    bool findNext() { return findNext(lastSearchText, lastCaseSensitive, lastWholeWords, lastRegularExpression, true); }
+    bool findPrevious() { return findPrevious(lastSearchText, lastCaseSensitive, lastWholeWords, lastRegularExpression, true); }
 
 signals:
     void filePathChanged(const QString& path);
+    void searchResultsChanged(int current, int total);
+    void searchPatternError(const QString &message);
+    void replaceAllFinished(int count, qint64 elapsedMs);
+    // A real text change, with highlighter-only passes filtered out
+    void textEdited(int position, int charsRemoved, const QString &inserted);
+    // The whole text was replaced (a load, not typing); 'text' is the new content
+    void documentReset(const QString &text);
 
 public slots:
-    void find(const QString &text, bool caseSensitive, bool wholeWords, bool searchBackwards, bool wrapAround);
-    void replace(const QString &searchText, const QString &replaceText, bool caseSensitive, bool wholeWords);
-    void replaceAll(const QString &searchText, const QString &replaceText, bool caseSensitive, bool wholeWords);
+    bool find(const QString &text, bool caseSensitive, bool wholeWords, bool searchBackwards, bool wrapAround,
+              bool regularExpression = false);
+    void clearSearchHighlights();
+    void incrementalFind(const QString &text, bool caseSensitive, bool wholeWords, bool regularExpression = false);
+    void replace(const QString &searchText, const QString &replaceText, bool caseSensitive, bool wholeWords,
+                 bool regularExpression = false);
+    void replaceAll(const QString &searchText, const QString &replaceText, bool caseSensitive, bool wholeWords,
+                    bool regularExpression = false);
     void showFindDialog();
     void undo();
     void redo();
@@ -133,6 +160,8 @@ public slots:
     void addCursorAtMousePosition(const QPoint &pos);
     void updateSplitView();
     void setLineNumbersVisible(bool visible);
+    void setMinimapVisible(bool visible);
+    void setSaveScheduler(SaveScheduler *scheduler);
 
 protected:
     void resizeEvent(QResizeEvent *event) override;
@@ -150,18 +179,26 @@ private slots:
     void updateLineNumberAreaWidth(int newBlockCount);
     void highlightCurrentLine();
     void updateLineNumberArea(const QRect &rect, int dy);
-    bool findNext(const QString &searchText, bool caseSensitive, bool wholeWords, bool wrapAround);
-    bool findPrevious(const QString &searchText, bool caseSensitive, bool wholeWords, bool wrapAround);
+    bool findNext(const QString &searchText, bool caseSensitive, bool wholeWords, bool regularExpression,
+                  bool wrapAround);
+    bool findPrevious(const QString &searchText, bool caseSensitive, bool wholeWords, bool regularExpression,
+                      bool wrapAround);
     void handleTextChanged(int position, int charsRemoved, int charsAdded);
     void highlightFoldingRegions();
     void updateCursors();
     void handleSelectionChanged();
+    void refreshSearchResults();
+    void reportSearchPosition();
 
 private:
     QWidget *lineNumberArea;
+    Minimap *minimap;
+    GutterRenderer gutter;
+    int gutterCurrentBlock; // block whose row shows the current-line marker
     QSyntaxHighlighter *highlighter;
     QUndoStack *m_undoStack;
     QString m_lastText;
+    quint64 editRevision; // bumped on every real edit, to match finished autosaves
     bool m_isUndoRedoOperation;
     
     bool findText(const QString &searchText, bool caseSensitive, bool wholeWords, bool searchBackwards, bool wrapAround);
@@ -169,7 +206,7 @@ private:
     QTextDocument::FindFlags getSearchFlags(bool caseSensitive, bool wholeWords, bool searchBackwards) const;
     void setupUndoRedo();
     SettingsDialog *settingsDialog;
-    QTimer *autoSaveTimer;
+    SaveScheduler *saveScheduler;
     QString currentFilePath;
     
     // Settings
@@ -184,19 +221,23 @@ private:
     QColor lineNumberForegroundColor;
     QColor currentLineColor;
     bool autoSaveEnabled;
-    int autoSaveInterval;
+    int autoSaveInterval; // minutes, the longest a modified document waits
     
     // Folding related members
     QHash<int, FoldedRegion> foldedRegions;
     int foldingMarginWidth;
     bool isFoldingEnabled;
     QColor foldingMarkerColor;
+    int foldCacheGeneration; // bumped when cached fold indents go stale
+    bool analysisDeferred;
+    QList<int> deferredFolds; // restoreFolds() while analysis was deferred
     
     // Multiple cursor support
     QVector<Cursor> cursors;
     QVector<Selection> selections;
     bool isColumnSelectionMode;
     QPoint columnSelectionOrigin;
+    ColumnSelection columnSelection;
     
     SplitViewContainer* splitViewContainer;
     QString filePath;
@@ -206,7 +247,10 @@ private:
     QString m_currentLanguage;
     
     void setupEditor();
-    void setupAutoSave();
+    void loadAutoSaveSettings();
+    void loadFontSettings();
+    void loadEditorSettings();
+    void loadColorSettings();
     void updateEditorColors();
     void updateEditorFont();
     void updateEditorSettings();
@@ -215,12 +259,14 @@ private:
     void detectFoldingRegions();
     bool isFoldableBlock(const QTextBlock &block) const;
     int getFoldingIndentLevel(const QTextBlock &block) const;
+    void invalidateFoldCache(int position, int length);
     void drawFoldingMarker(QPainter *painter, const QRect &rect, bool collapsed);
     void toggleFoldAt(const QTextBlock &block);
     void setBlockVisible(const QTextBlock &block, bool visible);
     QRect getFoldingMarkerRect(const QTextBlock &block) const;
     QString createPlaceholderText(const QTextBlock &startBlock, const QTextBlock &endBlock) const;
     void updateViewportMargins();
+    void updateGutterRow(int blockNumber);
     void ensureBlockIsVisible(const QTextBlock &block);
     QTextBlock findFoldingEndBlock(const QTextBlock &startBlock) const;
     void setupMultipleCursors();
@@ -231,10 +277,15 @@ private:
     void sortCursors();
     bool areCursorsOverlapping(const QTextCursor &c1, const QTextCursor &c2) const;
     void updateColumnSelection(const QPoint &pos);
-    QTextCursor createCursorForColumn(int blockNumber, int column);
+    void updateColumnSelectionMetrics();
+    bool handleColumnSelectionKeyPress(QKeyEvent *event);
+    void insertTextAtColumnSelection(const QString &text);
+    void deleteAtColumnSelection(bool isBackspace);
+    QString columnSelectionText() const;
+    void paintColumnSelection(QPainter *painter, const QTextBlock &block, int top, int bottom);
     void addCursorAtWordOccurrence(const QString &word);
     void ensureVisibleCursors();
-    void paintCursors(QPainter *painter);
+    void paintCursors(QPainter *painter, const QRect &exposed);
     QRect cursorRect(const QTextCursor &cursor) const;
     void handleMultipleCursorKeyPress(QKeyEvent *event);
     void setupSplitView();
@@ -243,9 +294,28 @@ private:
     QTextCursor expandSelectionToBoundary(const QTextCursor& cursor);
     QTextCursor shrinkSelectionToBoundary(const QTextCursor& cursor);
 
+    QString documentText(int position, int length) const;
+    QTextCursor findMatch(const QString &text, int from, bool caseSensitive,
+                          bool wholeWords, bool regularExpression, bool backwards) const;
+    bool checkSearchPattern(const QString &text, bool regularExpression);
+    bool hasSearchResults(const QString &text, const SearchOptions &options) const;
+    void deferRegexStep(const QString &text, bool caseSensitive, bool wholeWords,
+                        int from, bool backwards, bool wrapAround);
+    void updateSearchHighlights();
+    void paintSearchMatches(QPainter *painter, const QRect &rect);
+    void selectIncrementalMatch(bool searchFinished);
+    void updateMinimapMarks();
+
     QString lastSearchText;
     bool lastCaseSensitive;
     bool lastWholeWords;
+    bool lastRegularExpression;
+    FindAllEngine *findAllEngine;
+    QTimer *searchRefreshTimer;
+    bool searchResultsStale;
+    int incrementalAnchor; // where search-as-you-type looks for its first match, -1 when idle
+    bool incrementalBackwards; // pick the last match before the anchor instead
+    bool incrementalWrap;
 };
 
 class LineNumberArea : public QWidget
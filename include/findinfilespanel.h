@@ -0,0 +1,75 @@
+#ifndef FINDINFILESPANEL_H
+#define FINDINFILESPANEL_H
+
+#include <QDockWidget>
+#include <QHash>
+#include "search/filesearch.h"
+#include "search/projectreplace.h"
+
+class QLineEdit;
+class QCheckBox;
+class QPushButton;
+class QLabel;
+class QTreeWidget;
+class QTreeWidgetItem;
+class TrigramIndex;
+
+// Dock panel for project-wide search: query controls on top, hits grouped
+// by file below. Activating a hit asks the window to open it. Replace
+// rewrites every file of the last search after a preview.
+class FindInFilesPanel : public QDockWidget
+{
+    Q_OBJECT
+
+public:
+    explicit FindInFilesPanel(QWidget *parent = nullptr);
+
+    void setRootPath(const QString &path);
+    QString rootPath() const;
+    void focusSearch();
+    void notifyFileSaved(const QString &filePath);
+
+signals:
+    void openLocation(const QString &filePath, int line, int column, int length);
+    void filesReplaced(const QStringList &files);
+
+private slots:
+    void startOrStop();
+    void browseForFolder();
+    void addHits(const QVector<FileSearchHit> &hits);
+    void updateProgress(int filesSearched);
+    void searchFinished(int hitCount, int filesSearched, int filesSkipped, bool truncated);
+    void activateItem(QTreeWidgetItem *item);
+    void updateIndex();
+    void startReplace();
+    void previewReplace(const QVector<FileEdit> &edits, int filesSkipped);
+    void replaceCommitted(const QStringList &files, int replacements);
+    void replaceFailed(const QString &message);
+
+private:
+    void setupUi();
+    void setSearching(bool searching);
+
+    FileSearch *fileSearch;
+    ProjectReplace *projectReplace;
+    TrigramIndex *index;
+    QLineEdit *folderEdit;
+    QLineEdit *patternEdit;
+    QLineEdit *replaceEdit;
+    QCheckBox *caseSensitiveCheckBox;
+    QCheckBox *wholeWordsCheckBox;
+    QCheckBox *regexCheckBox;
+    QCheckBox *useIndexCheckBox;
+    QPushButton *searchButton;
+    QPushButton *replaceButton;
+    QLabel *statusLabel;
+    QTreeWidget *resultsTree;
+    QHash<QString, QTreeWidgetItem *> fileItems;
+    int hitsShown;
+    // What produced the results shown, so Replace matches exactly those
+    QString lastPattern;
+    SearchOptions lastOptions;
+    bool lastTruncated;
+};
+
+#endif // FINDINFILESPANEL_H
@@ -0,0 +1,53 @@
+#ifndef GUTTERRENDERER_H
+#define GUTTERRENDERER_H
+
+#include <QtGui/QFont>
+#include <QtGui/QColor>
+#include <QtGui/QPixmap>
+
+class QPainter;
+
+// Draws line numbers, the current-line marker and fold markers from
+// prerendered pixmaps: one strip with the ten digits, a glow sprite and an
+// expanded/collapsed pair of fold boxes. Painting a row is then a few pixmap
+// blits with no text layout, string building, gradient or pen setup.
+// Sprites are rebuilt only when the font, colour or device pixel ratio change.
+class GutterRenderer
+{
+public:
+    GutterRenderer();
+
+    void setStyle(const QFont &font, const QColor &color, qreal devicePixelRatio);
+    void setFoldMarkerStyle(const QColor &color, qreal devicePixelRatio);
+    void invalidate() { valid = false; foldMarkersValid = false; }
+
+    int lineHeight() const { return height; }
+    void drawNumber(QPainter *painter, int number, int right, int top) const;
+    void drawCurrentLineMarker(QPainter *painter, int right, int top) const;
+    // Centres the marker in 'rect'
+    void drawFoldMarker(QPainter *painter, const QRect &rect, bool collapsed) const;
+
+private:
+    void rebuild();
+    void rebuildFoldMarkers();
+
+    QFont font;
+    QColor color;
+    qreal devicePixelRatio;
+    bool valid;
+
+    QPixmap digits;
+    QPixmap glow;
+    QPixmap foldExpanded;
+    QPixmap foldCollapsed;
+    QColor foldMarkerColor;
+    qreal foldMarkerPixelRatio;
+    bool foldMarkersValid;
+    int digitWidth;
+    int height;
+
+    static const int DOT_SIZE = 6;
+    static const int FOLD_MARKER_SIZE = 8;
+};
+
+#endif // GUTTERRENDERER_H
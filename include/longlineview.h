@@ -0,0 +1,77 @@
+#ifndef LONGLINEVIEW_H
+#define LONGLINEVIEW_H
+
+#include <QtWidgets/QAbstractScrollArea>
+#include <QtCore/QVector>
+#include "search/findallengine.h"
+
+// Read-only view for files with lines too long for QPlainTextEdit, such as
+// minified JSON or JavaScript. Text sits on a fixed monospace grid, so a
+// column maps straight to an offset into its line: only the slice of each
+// line inside the horizontal window is ever shaped and painted. The cursor,
+// selection and search all work on plain offsets into the text. Tabs take
+// one cell.
+class LongLineView : public QAbstractScrollArea
+{
+    Q_OBJECT
+
+public:
+    explicit LongLineView(QWidget *parent = nullptr);
+
+    // True when some line is long enough to make the regular editor crawl
+    static bool needsLongLineMode(const QString &text);
+
+    void setText(const QString &text);
+    const QString &text() const { return content; }
+    void clear();
+
+    qsizetype cursorPosition() const { return cursor; }
+    qsizetype positionOf(int line, qsizetype column) const;
+    void select(qsizetype start, qsizetype end);
+    QString selectedText() const;
+    bool find(const QString &pattern, const SearchOptions &options, bool backwards, bool wrapAround);
+
+public slots:
+    void copy();
+    void selectAll();
+
+signals:
+    void cursorPositionChanged(int line, qsizetype column);
+
+protected:
+    void paintEvent(QPaintEvent *event) override;
+    void resizeEvent(QResizeEvent *event) override;
+    void changeEvent(QEvent *event) override;
+    void keyPressEvent(QKeyEvent *event) override;
+    void mousePressEvent(QMouseEvent *event) override;
+    void mouseMoveEvent(QMouseEvent *event) override;
+    void mouseDoubleClickEvent(QMouseEvent *event) override;
+    void scrollContentsBy(int dx, int dy) override;
+
+private:
+    int lineAt(qsizetype position) const;
+    qsizetype lineLength(int line) const;
+    qsizetype positionAt(const QPoint &point) const;
+    void moveCursor(qsizetype position, bool keepAnchor, bool keepColumn = false);
+    qsizetype wordBoundary(qsizetype position, bool forward) const;
+    void updateMetrics();
+    void updateScrollBars();
+    void ensureCursorVisible();
+    int visibleLines() const;
+    int visibleColumns() const;
+
+    QString content;
+    QVector<qsizetype> lineStarts;
+    qsizetype longestLine;
+    qsizetype cursor;
+    qsizetype anchor;
+    qsizetype desiredColumn; // kept across Up/Down through shorter lines
+    QFont renderFont;
+    qreal cellWidth;
+    int lineHeight;
+    int ascent;
+
+    static const qsizetype LONG_LINE_THRESHOLD = 20000; // characters
+};
+
+#endif // LONGLINEVIEW_H
@@ -10,6 +10,14 @@
 #include "dialogs/finddialog.h"
 #include "dialogs/autocorrectdialog.h"
 
+class FindInFilesPanel;
+class LongLineView;
+class QStackedWidget;
+class QTabBar;
+class ProfilerOverlay;
+class SaveScheduler;
+class DocumentHandle;
+
 namespace Ui {
 class MainWindow;
 }
@@ -22,15 +30,28 @@ public:
     explicit MainWindow(QWidget *parent = nullptr);
     ~MainWindow();
 
+    // What the first frame doesn't need: highlighting and folds of the open
+    // document, autocorrect rules and the recovery prompt. Called once the
+    // window has been painted.
+    void completeStartup();
+
+signals:
+    void documentClosed(const QString &filePath);
+
 public slots:
     void newFile();
     void openFile();
+    void openFiles(const QStringList &files);
     bool saveFile();
     bool saveFileAs();
     void about();
     void showFindDialog();
     void findNext();
     void findPrevious();
+    void incrementalFind();
+    void showFindInFiles();
+    void openSearchResult(const QString &filePath, int line, int column, int length);
+    void reloadReplacedFiles(const QStringList &files);
     void showAutoCorrectDialog();
     void toggleAutoCorrect();
     void handleTextChange();
@@ -39,6 +60,10 @@ public slots:
     void checkForRecovery();
     void recoverSession();
     void discardSession();
+    void toggleProfiler(bool enabled);
+    void exportProfilerTrace();
+    void activateDocument(int index);
+    bool closeDocument(int index);
 
 private:
     void createActions();
@@ -49,18 +74,44 @@ private:
     void setCurrentFile(const QString &fileName);
     bool maybeSave();
     void loadFile(const QString &fileName);
+    bool readFile(const QString &fileName, QString *text);
+    int addDocument(const DocumentState &state);
+    int findDocument(const QString &fileName) const;
+    bool isActiveDocumentBlank() const;
+    void restoreDocuments();
+    CodeEditor *createEditor();
+    void attachEditor(CodeEditor *editor);
+    void switchToDocument(int index);
+    void showDocument(int index, const QString &text);
+    void trimLoadedDocuments();
+    void updateCurrentFile();
+    void updateTabTitle(int index);
     bool saveFile(const QString &fileName);
+    void setLongLineMode(bool enabled);
+    bool isLongLineMode() const;
     bool find(const QString &searchString, bool forward = true);
     QString applyAutocorrect(const QString &text);
 
     Ui::MainWindow *ui;
-    CodeEditor *textEdit;
+    CodeEditor *textEdit; // the active document's editor
+    LongLineView *longLineView;
+    QStackedWidget *editorStack;
+    QTabBar *tabBar;
+    QList<DocumentHandle *> documents; // one per tab, in tab order
+    int activeDocument; // -1 while none is shown
+    quint64 showCounter;
+    QList<QMetaObject::Connection> editorConnections; // to the active editor
+    QFont editorFont;
+    ProfilerOverlay *profilerOverlay;
     QLabel *wordCountLabel;
     QLabel *autocorrectLabel;
     FindDialog *findDialog;
+    FindInFilesPanel *findInFilesPanel;
     AutoCorrectDialog *autocorrectDialog;
+    SaveScheduler *saveScheduler;
     SessionManager *sessionManager;
     bool autoCorrectEnabled;
+    bool startupComplete; // editors made before completeStartup() defer their analysis
     QString currentFile;
     QMap<QString, QString> autocorrectRules;
 
@@ -69,11 +120,19 @@ private:
     QAction *actionZoomOut;
     QAction *actionZoomReset;
     QAction *actionToggleLineNumbers;
+    QAction *actionToggleMinimap;
     QAction *actionSettings;
     QAction *actionToggleFolding;
     QAction *actionFoldAll;
     QAction *actionUnfoldAll;
+    QAction *actionShowProfiler;
+    QAction *actionExportTrace;
     QAction *actionAboutQt;
+    QAction *actionFindInFiles;
+    QAction *actionCloseTab;
+
+    static const int MAX_LOADED_DOCUMENTS = 8;
+    static const qsizetype LOADED_TEXT_BUDGET = 64 * 1024 * 1024; // characters in loaded documents
 };
 
 #endif // MAINWINDOW_H 
\ No newline at end of file
@@ -0,0 +1,101 @@
+#ifndef MINIMAP_H
+#define MINIMAP_H
+
+#include <QtWidgets/QWidget>
+#include <QtGui/QImage>
+#include <QtGui/QPixmap>
+#include <QtCore/QVector>
+#include <QtCore/QPair>
+#include <QtCore/QThreadPool>
+#include <QtCore/QTimer>
+#include "syntax/blockdata.h"
+
+class QPlainTextEdit;
+class QTextDocument;
+class SyntaxHighlighter;
+
+// Overview strip beside the editor. Each line is reduced to one row of
+// token-class cells (one per character column) from the highlighter's runs,
+// and the rows are drawn into a downsampled image on a worker thread. Only
+// lines touched by an edit are re-rasterised. The GUI thread just blits the
+// finished pixmap, a cached overlay with search and fold marks, and the
+// visible-range box.
+class Minimap : public QWidget
+{
+    Q_OBJECT
+
+public:
+    Minimap(QPlainTextEdit *editor, SyntaxHighlighter *highlighter);
+    ~Minimap();
+
+    QSize sizeHint() const override;
+    void setSearchMatchLines(const QVector<int> &lines);
+    void setFoldedRegions(const QVector<QPair<int, int>> &regions);
+    void updateColors();
+
+    static const int MINIMAP_WIDTH = 100; // also the number of character columns
+
+protected:
+    void paintEvent(QPaintEvent *event) override;
+    void resizeEvent(QResizeEvent *event) override;
+    void mousePressEvent(QMouseEvent *event) override;
+    void mouseMoveEvent(QMouseEvent *event) override;
+
+private slots:
+    void handleContentsChange(int position, int charsRemoved, int charsAdded);
+    void startRender();
+
+private:
+    struct SourceLine {
+        QString text;
+        QVector<TokenRun> tokens;
+    };
+    struct RenderResult {
+        QVector<QByteArray> cells;
+        QImage image;
+        QImage display;
+        quint64 serial;
+    };
+
+    static QByteArray rasteriseLine(const SourceLine &line);
+    static RenderResult render(QVector<QByteArray> cells, int firstLine,
+                               const QVector<SourceLine> &lines, QImage image, bool full,
+                               const QVector<QRgb> &colors, QSize displaySize, qreal pixelRatio);
+    static int rowCountFor(int lineCount);
+
+    void markDirty(int firstLine, int lastLine);
+    void finishRender(const RenderResult &result, int firstLine, int lastLine);
+    void rebuildOverlay();
+    int displayHeight() const;
+    int lineAtY(int y) const;
+    void scrollToY(int y);
+
+    QPlainTextEdit *editor;
+    QTextDocument *document;
+    SyntaxHighlighter *highlighter;
+
+    QVector<QByteArray> lineCells;
+    int lastBlockCount;
+    int dirtyFirst; // -1 when nothing is waiting
+    int dirtyLast;
+    bool fullRender;
+    quint64 structureSerial; // bumped whenever lines are inserted or removed
+
+    QImage image;   // full-resolution rows, the base for incremental updates
+    QPixmap pixmap; // 'image' scaled to the widget
+    QPixmap overlay;
+    QVector<QRgb> colors;
+    QVector<int> matchLines;
+    QVector<QPair<int, int>> folds;
+
+    QThreadPool renderPool;
+    QTimer *renderTimer;
+    bool rendering;
+
+    static const int LINE_HEIGHT = 2;
+    static const int MAX_ROWS = 4096;
+    static const int MAX_LINES_PER_RENDER = 20000;
+    static const int MAX_SOURCE_CHARS = MINIMAP_WIDTH * 4;
+};
+
+#endif // MINIMAP_H
@@ -0,0 +1,84 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <QtCore/QString>
+#include <QtCore/QVector>
+#include <atomic>
+#include <chrono>
+
+// Code paths timed by PROFILE_SCOPE; the names show up in the overlay and trace
+enum class ProfileSection : quint8 {
+    EditorPaint,
+    GutterPaint,
+    Highlight,
+    EditorTextChange,
+    AutoSave,
+    WindowTextChange,
+    Count
+};
+
+// Rolling statistics for one section, durations in nanoseconds
+struct ProfileStats {
+    const char *name = nullptr;
+    qint64 calls = 0; // since profiling was switched on
+    int samples = 0;  // in the rolling window
+    qint64 median = 0;
+    qint64 p95 = 0;
+    qint64 max = 0;
+    QVector<int> histogram; // power-of-two microsecond buckets
+};
+
+// Built-in profiler. Scopes cost one relaxed atomic load while switched off;
+// when on, each one keeps its duration in a per-section window for the
+// histograms and appends a complete event to a fixed ring for the trace.
+class Profiler
+{
+public:
+    static bool isEnabled() { return enabled.load(std::memory_order_relaxed); }
+    static void setEnabled(bool enable);
+    static void reset();
+
+    static qint64 now()
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+    static void record(ProfileSection section, qint64 start, qint64 end);
+
+    static const char *sectionName(ProfileSection section);
+    static QVector<ProfileStats> statistics();
+
+    // Writes the trace ring in the Chrome trace-event format (chrome://tracing, Perfetto)
+    static bool exportChromeTrace(const QString &filePath, QString *errorMessage = nullptr);
+
+    static const int HISTOGRAM_BUCKETS = 16;
+    static const int WINDOW_SIZE = 512;
+    static const int MAX_TRACE_EVENTS = 65536;
+
+private:
+    static std::atomic<bool> enabled;
+};
+
+class ProfileScope
+{
+public:
+    explicit ProfileScope(ProfileSection section)
+        : section(section), start(Profiler::isEnabled() ? Profiler::now() : -1) {}
+    ~ProfileScope()
+    {
+        if (start >= 0)
+            Profiler::record(section, start, Profiler::now());
+    }
+
+    ProfileScope(const ProfileScope &) = delete;
+    ProfileScope &operator=(const ProfileScope &) = delete;
+
+private:
+    ProfileSection section;
+    qint64 start;
+};
+
+// Times the rest of the enclosing block
+#define PROFILE_SCOPE(section) ProfileScope profileScope(ProfileSection::section)
+
+#endif // PROFILER_H
@@ -0,0 +1,41 @@
+#ifndef PROFILEROVERLAY_H
+#define PROFILEROVERLAY_H
+
+#include <QtWidgets/QWidget>
+#include <QtCore/QTimer>
+#include "profiler.h"
+
+// Translucent panel over the top-right corner of its parent listing every
+// profiled section with its call count, median, p95 and max time and a
+// histogram of the rolling window. Ignores the mouse so editing goes on
+// underneath it.
+class ProfilerOverlay : public QWidget
+{
+    Q_OBJECT
+
+public:
+    explicit ProfilerOverlay(QWidget *parent);
+
+protected:
+    void paintEvent(QPaintEvent *event) override;
+    void showEvent(QShowEvent *event) override;
+    void hideEvent(QHideEvent *event) override;
+    bool eventFilter(QObject *watched, QEvent *event) override;
+
+private slots:
+    void refresh();
+
+private:
+    void reposition();
+    static QString formatDuration(qint64 nanoseconds);
+
+    QTimer *refreshTimer;
+    QVector<ProfileStats> stats;
+
+    static const int ROW_HEIGHT = 18;
+    static const int BAR_WIDTH = 5;
+    static const int MARGIN = 8;
+    static const int FRAME_BUDGET_BUCKET = 14; // 8-16 ms and slower misses a 60 Hz frame
+};
+
+#endif // PROFILEROVERLAY_H
@@ -0,0 +1,57 @@
+#ifndef SAVESCHEDULER_H
+#define SAVESCHEDULER_H
+
+#include <QObject>
+#include <QHash>
+#include <QTimer>
+#include <QElapsedTimer>
+#include <functional>
+
+class AutoSaveService;
+
+// The one place that decides when open documents are saved. Clients mark
+// themselves dirty on every edit; a client's save runs once typing has
+// paused for IDLE_DELAY, or at the latest its maximum latency after the
+// first unsaved edit, so a burst of typing costs one write instead of one
+// per timer tick. The shared AutoSaveService skips writes whose content
+// hashes the same as the last one to that file. Durability between saves
+// comes from the edit journal, not from saving more often.
+class SaveScheduler : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit SaveScheduler(QObject *parent = nullptr);
+
+    // Clients are dropped automatically when destroyed
+    void addClient(QObject *client, int maxLatencyMs, const std::function<void()> &save);
+    void removeClient(QObject *client);
+    void setMaxLatency(QObject *client, int maxLatencyMs);
+    void markDirty(QObject *client);
+    void saveAll();
+
+    AutoSaveService *service() const { return saveService; }
+
+    static const int IDLE_DELAY = 2000; // ms without typing before a save
+
+private slots:
+    void runDue();
+
+private:
+    struct Client {
+        std::function<void()> save;
+        int maxLatency = 0;
+        qint64 firstDirty = -1; // -1 when clean
+        qint64 lastEdit = -1;
+    };
+
+    qint64 dueTime(const Client &client) const;
+    void reschedule();
+
+    QHash<QObject *, Client> clients;
+    QElapsedTimer clock;
+    QTimer *timer;
+    AutoSaveService *saveService;
+};
+
+#endif // SAVESCHEDULER_H
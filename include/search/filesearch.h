@@ -0,0 +1,94 @@
+#ifndef FILESEARCH_H
+#define FILESEARCH_H
+
+#include "search/findallengine.h"
+#include <QtCore/QObject>
+#include <QtCore/QString>
+#include <QtCore/QStringList>
+#include <QtCore/QVector>
+#include <QtCore/QFuture>
+#include <QtCore/QThreadPool>
+#include <QtCore/QSharedPointer>
+#include <QtCore/QRegularExpression>
+#include <functional>
+
+class QFileInfo;
+
+struct FileSearchHit {
+    QString filePath;
+    int line;    // 1-based
+    int column;  // 0-based, in UTF-16 code units
+    int length;
+    QString preview;
+};
+
+// Default exclusions plus the root .gitignore and .toastignore, as name or
+// path wildcards. Negations and nested ignore files are not supported.
+class IgnoreRules
+{
+public:
+    void load(const QString &rootPath);
+    void addPatterns(const QStringList &lines);
+    bool isIgnored(const QString &name, const QString &relativePath) const;
+
+private:
+    QList<QRegularExpression> names;
+    QList<QRegularExpression> paths;
+};
+
+// Searches every text file below a folder with the editor's search kernels.
+// One thread walks the tree (skipping ignored paths and symlinks) and hands
+// batches of files to the global QtConcurrent pool; hits are delivered on
+// the GUI thread batch by batch. At most a few batches are in flight and
+// the total number of hits is capped, so memory stays bounded on huge trees.
+class FileSearch : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit FileSearch(QObject *parent = nullptr);
+    ~FileSearch();
+
+    void start(const QString &rootPath, const QString &pattern, const SearchOptions &options);
+    void startInFiles(const QString &rootPath, const QStringList &files,
+                      const QString &pattern, const SearchOptions &options);
+    void cancel();
+    bool isRunning() const;
+
+    static QStringList defaultIgnorePatterns();
+    // Depth-first walk that skips ignored paths and symlinks
+    static void listFiles(const QString &rootPath, const IgnoreRules &rules,
+                          const std::function<bool()> &isCanceled,
+                          const std::function<void(const QFileInfo &)> &visitFile,
+                          const std::function<void(const QString &)> &visitDirectory = {});
+    static bool looksBinary(const char *data, qint64 size);
+    // Reads a whole file that is valid UTF-8 text; false for binary or other encodings.
+    // A leading byte order mark is dropped from 'text' and reported in 'hasBom'.
+    static bool readTextFile(const QString &filePath, QString *text, bool *hasBom = nullptr);
+
+    // Files are decoded whole, so this times the pool size bounds memory;
+    // larger files are skipped and counted rather than searched
+    static const qint64 MAX_FILE_SIZE = 16LL * 1024 * 1024;
+
+signals:
+    void hitsFound(const QVector<FileSearchHit> &hits);
+    void progress(int filesSearched);
+    void finished(int hitCount, int filesSearched, int filesSkipped, bool truncated);
+
+private:
+    struct State;
+
+    void walk(const QSharedPointer<State> &state);
+    void searchBatch(const QSharedPointer<State> &state, const QStringList &files);
+    static void searchFile(State *state, const QString &filePath, QVector<FileSearchHit> *hits);
+
+    QSharedPointer<State> current;
+    QThreadPool walkerPool;
+    QFuture<void> walker;
+
+    static const int BATCH_SIZE = 64;          // files per task
+    static const int MAX_HITS = 20000;         // per search
+    static const int MAX_PREVIEW = 200;        // characters of context per hit
+};
+
+#endif // FILESEARCH_H
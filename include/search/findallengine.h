@@ -0,0 +1,88 @@
+#ifndef FINDALLENGINE_H
+#define FINDALLENGINE_H
+
+#include <QtCore/QObject>
+#include <QtCore/QString>
+#include <QtCore/QVector>
+#include <QtCore/QPair>
+#include <QtCore/QFutureWatcher>
+
+struct SearchMatch {
+    int position;
+    int length;
+};
+Q_DECLARE_TYPEINFO(SearchMatch, Q_PRIMITIVE_TYPE);
+
+struct SearchOptions {
+    bool caseSensitive = false;
+    bool wholeWords = false;
+    bool regularExpression = false;
+
+    bool operator==(const SearchOptions &other) const {
+        return caseSensitive == other.caseSensitive && wholeWords == other.wholeWords
+            && regularExpression == other.regularExpression;
+    }
+    bool operator!=(const SearchOptions &other) const { return !(*this == other); }
+};
+
+// Counts and collects every match of a pattern in a document snapshot.
+// The snapshot is split into chunks that are searched on the global
+// QtConcurrent pool; chunk results are merged in document order as they
+// arrive so the UI can show a growing count while the search runs.
+// When a query is only extended, refine() filters the previous matches
+// instead of scanning the snapshot again. Regular expressions can match
+// across chunk boundaries, so they run as a single cancellable task.
+class FindAllEngine : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit FindAllEngine(QObject *parent = nullptr);
+    ~FindAllEngine();
+
+    void start(const QString &snapshot, const QString &pattern, const SearchOptions &options);
+    bool refine(const QString &snapshot, const QString &pattern, const SearchOptions &options);
+    void cancel();
+    void clear();
+
+    bool isRunning() const;
+    bool isComplete() const { return complete; }
+    QString pattern() const { return currentPattern; }
+    SearchOptions options() const { return currentOptions; }
+    const QVector<SearchMatch> &matches() const { return merged; }
+    int matchCount() const { return merged.size(); }
+    int indexOfMatchAt(int position) const;
+    int firstMatchFrom(int position) const;
+
+    static QVector<SearchMatch> searchRange(const QString &text, qsizetype begin, qsizetype end,
+                                            const QString &pattern, const SearchOptions &options,
+                                            int maxCount = -1);
+
+signals:
+    void matchesChanged(int count);
+    void finished(int count);
+
+private slots:
+    void handleResultReady(int index);
+    void handleFinished();
+
+private:
+    void watch(const QFuture<QVector<SearchMatch>> &future);
+    void mergeReadyChunks();
+    static bool isSelfOverlapping(const QString &pattern, Qt::CaseSensitivity cs);
+
+    QFutureWatcher<QVector<SearchMatch>> *watcher;
+    QString snapshot;
+    QString currentPattern;
+    SearchOptions currentOptions;
+    QVector<QPair<qsizetype, qsizetype>> chunks;
+    QVector<QVector<SearchMatch>> chunkResults;
+    QVector<bool> chunkReady;
+    int nextChunkToMerge;
+    QVector<SearchMatch> merged;
+    bool complete;
+
+    static constexpr qsizetype MIN_CHUNK_SIZE = 1 << 20; // characters
+};
+
+#endif // FINDALLENGINE_H
@@ -0,0 +1,34 @@
+#ifndef LITERALSEARCH_H
+#define LITERALSEARCH_H
+
+#include <QtCore/QString>
+#include <QtCore/QStringView>
+
+// Literal substring search used by every find path in the editor.
+// Candidates are filtered on the pattern's first and last code unit with
+// SSE2 or AVX2 (picked at runtime) and then verified; case-insensitive
+// searches filter on both cases of the folded pattern ends. Patterns whose
+// ends have no cheap case variants fall back to QStringView.
+class LiteralSearch
+{
+public:
+    enum Kernel {
+        Scalar,
+        Sse2,
+        Avx2
+    };
+
+    static qsizetype indexOf(QStringView haystack, QStringView needle, qsizetype from = 0,
+                             Qt::CaseSensitivity cs = Qt::CaseSensitive);
+    // Finds the last match starting at or before 'from'; negative 'from' finds nothing
+    static qsizetype lastIndexOf(QStringView haystack, QStringView needle, qsizetype from,
+                                 Qt::CaseSensitivity cs = Qt::CaseSensitive);
+    static bool equals(QStringView a, QStringView b, Qt::CaseSensitivity cs = Qt::CaseSensitive);
+    static bool isWholeWordAt(QStringView text, qsizetype position, qsizetype length);
+
+    static Kernel activeKernel();
+    static void setKernel(Kernel kernel);
+    static const char *kernelName(Kernel kernel);
+};
+
+#endif // LITERALSEARCH_H
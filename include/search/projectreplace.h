@@ -0,0 +1,72 @@
+#ifndef PROJECTREPLACE_H
+#define PROJECTREPLACE_H
+
+#include "search/findallengine.h"
+#include "search/replaceengine.h"
+#include <QtCore/QObject>
+#include <QtCore/QString>
+#include <QtCore/QStringList>
+#include <QtCore/QVector>
+#include <QtCore/QFutureWatcher>
+#include <QtCore/QThreadPool>
+
+// The replacements for one file. Only the matches are kept; the text is
+// read again for the preview and when the edit is applied, and size and
+// modification time tell whether it is still the text they were found in.
+struct FileEdit {
+    QString filePath;
+    QVector<ReplaceSpan> spans;
+    int count = 0; // -1 when the file couldn't be read as text
+    bool hasBom = false;
+    qint64 size = 0;
+    qint64 modified = 0;
+};
+
+// Replace-all across many files. compute() finds the replacements in every
+// file on the global pool without touching the disk; commit() then reads
+// each file again, writes its new contents to a temporary file next to it
+// and only renames them into place once every write succeeded. A failed
+// rename puts back the files already swapped from hard-linked backups, so a
+// batch is applied completely or not at all.
+class ProjectReplace : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit ProjectReplace(QObject *parent = nullptr);
+    ~ProjectReplace();
+
+    void compute(const QStringList &files, const QString &pattern, const QString &replacement,
+                 const SearchOptions &options);
+    void commit(const QVector<FileEdit> &edits);
+    void cancel();
+    bool isBusy() const;
+
+    // Unified-style listing of the changed lines of one edit; reads the file
+    static QString previewDiff(const FileEdit &edit);
+
+signals:
+    void editsReady(const QVector<FileEdit> &edits, int filesSkipped);
+    void committed(const QStringList &files, int replacements);
+    void commitFailed(const QString &message);
+
+private slots:
+    void handleComputeFinished();
+
+private:
+    static FileEdit computeEdit(const QString &filePath, const QString &pattern,
+                                const QString &replacement, const SearchOptions &options);
+    static QString commitEdits(const QVector<FileEdit> &edits);
+    static bool applyEdit(const FileEdit &edit, QString *text);
+    static QString writeTemporary(const QString &filePath, const QString &text, bool hasBom);
+    static QString linkBackup(const QString &filePath);
+    static bool replaceFile(const QString &source, const QString &target);
+
+    QFutureWatcher<FileEdit> *computeWatcher;
+    QThreadPool commitPool;
+    bool committing;
+
+    static const int MAX_PREVIEW_HUNKS = 500;
+};
+
+#endif // PROJECTREPLACE_H
@@ -0,0 +1,37 @@
+#ifndef REGEXSEARCH_H
+#define REGEXSEARCH_H
+
+#include "search/findallengine.h"
+#include <QtCore/QString>
+#include <QtCore/QRegularExpression>
+#include <functional>
+
+// Regular-expression search over a whole document snapshot. Patterns are
+// matched against the contiguous text (blocks joined by '\n'), so they can
+// span lines; '^' and '$' anchor at line boundaries. Compiled patterns are
+// JIT-optimised once and kept in a small LRU cache shared by all threads.
+class RegexSearch
+{
+public:
+    // Returns an invalid expression (with errorString()) for bad patterns
+    static QRegularExpression compile(const QString &pattern, bool caseSensitive, bool wholeWords);
+
+    // Non-empty matches starting in [begin, end); stops early when isCanceled() says so
+    static QVector<SearchMatch> searchRange(const QString &text, qsizetype begin, qsizetype end,
+                                            const QRegularExpression &expression, int maxCount = -1,
+                                            const std::function<bool()> &isCanceled = {});
+    // First non-empty match starting at or after 'from'
+    static QRegularExpressionMatch matchFrom(const QRegularExpression &expression,
+                                             const QString &text, qsizetype from);
+    // Last non-empty match starting before 'before'
+    static QRegularExpressionMatch matchBefore(const QRegularExpression &expression,
+                                               const QString &text, qsizetype before);
+    // Non-empty match starting exactly at 'position'
+    static QRegularExpressionMatch matchAt(const QRegularExpression &expression,
+                                           const QString &text, qsizetype position);
+
+    // Expands \N, $N and ${N} (N up to 99) plus \n, \t, \\ and $$
+    static QString expandReplacement(const QString &replacement, const QRegularExpressionMatch &match);
+};
+
+#endif // REGEXSEARCH_H
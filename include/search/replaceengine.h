@@ -0,0 +1,35 @@
+#ifndef REPLACEENGINE_H
+#define REPLACEENGINE_H
+
+#include "search/findallengine.h"
+#include <QtCore/QString>
+
+// The single edit a replace-all boils down to: everything between the
+// first and the last match is rebuilt once and swapped in as one insert.
+struct ReplaceEdit {
+    int start = 0;
+    int end = 0;
+    QString text;
+    int count = 0;
+};
+
+// One match and the text that replaces it
+struct ReplaceSpan {
+    int position;
+    int length;
+    QString text;
+};
+
+// Computes replace-all edits over a document snapshot without touching the
+// document, so the caller can apply the result as one undoable transaction.
+class ReplaceEngine
+{
+public:
+    static ReplaceEdit build(const QString &snapshot, const QString &pattern,
+                             const QString &replacement, const SearchOptions &options);
+    // Every match with its expanded replacement, for previews
+    static QVector<ReplaceSpan> spans(const QString &snapshot, const QString &pattern,
+                                      const QString &replacement, const SearchOptions &options);
+};
+
+#endif // REPLACEENGINE_H
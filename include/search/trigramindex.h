@@ -0,0 +1,101 @@
+#ifndef TRIGRAMINDEX_H
+#define TRIGRAMINDEX_H
+
+#include "search/findallengine.h"
+#include "search/filesearch.h"
+#include <QtCore/QObject>
+#include <QtCore/QFile>
+#include <QtCore/QHash>
+#include <QtCore/QSet>
+#include <QtCore/QStringList>
+#include <QtCore/QThreadPool>
+#include <QtCore/QFuture>
+#include <atomic>
+#include <memory>
+
+class QFileSystemWatcher;
+class QTimer;
+
+// On-disk trigram index of a workspace folder, used to narrow project-wide
+// searches to the files that can contain a match. Every file contributes
+// the byte trigrams of its ASCII-lowercased contents; a query's trigrams
+// are looked up in memory-mapped posting lists and intersected. Files that
+// change after a build are tracked in memory (directory watches, our own
+// saves, a periodic re-check) and stay candidates until the next rebuild.
+class TrigramIndex : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit TrigramIndex(const QString &rootPath, QObject *parent = nullptr);
+    ~TrigramIndex();
+
+    QString rootPath() const { return root; }
+    bool isReady() const { return ready; }
+    bool isBuilding() const;
+
+    // Maps an existing index and re-checks it, or builds a new one
+    void open();
+    void rebuild();
+    void markDirty(const QString &filePath);
+
+    // Files that may match; *narrowed is false when the index cannot help
+    // and every file has to be searched
+    QStringList candidates(const QString &pattern, const SearchOptions &options, bool *narrowed) const;
+    static QVector<quint32> queryTrigrams(const QString &pattern, const SearchOptions &options);
+
+signals:
+    void buildProgress(int filesIndexed);
+    void indexReady(int fileCount);
+
+private slots:
+    void handleDirectoryChanged(const QString &directory);
+    void validate();
+
+private:
+    struct Entry {
+        QString path; // relative to the root
+        qint64 modified;
+        qint64 size;
+        bool indexed;
+    };
+
+    QString indexPath() const;
+    bool mapIndex();
+    void unmapIndex();
+    void watchDirectories(const QStringList &directories);
+    void scanNewDirectories(const QStringList &directories);
+    bool isStale(const QString &relativePath, const QFileInfo &info) const;
+    const quint32 *postingList(quint32 trigram, quint32 *count) const;
+    static bool writeIndex(const QString &path, const QVector<Entry> &files,
+                           const QHash<quint32, QVector<quint32>> &postings);
+
+    QString root;
+    IgnoreRules ignoreRules;
+    QFile indexFile;
+    const uchar *mapped;
+    qint64 mappedSize;
+    QVector<Entry> entries;
+    QHash<QString, int> entryIds;
+    QStringList unindexedFiles; // too large to index, always candidates
+    const uchar *trigramTable;
+    quint32 trigramCount;
+    const quint32 *postingData;
+    QHash<QString, quint64> dirtyFiles; // absolute path -> when it was marked
+    quint64 dirtySerial;
+    QSet<QString> watchedDirectories;
+    QSet<QString> scanningDirectories; // new folders being walked on the builder pool
+    QFileSystemWatcher *watcher;
+    QTimer *validationTimer;
+    QThreadPool builderPool;
+    QFuture<void> builder;
+    std::shared_ptr<std::atomic<bool>> canceled;
+    bool ready;
+
+    static const qint64 MAX_INDEXED_FILE_SIZE = 4 * 1024 * 1024; // larger files are always candidates
+    static const int MAX_WATCHED_DIRECTORIES = 4096;
+    static const int REBUILD_THRESHOLD = 2000;                   // dirty files before a rebuild
+    static const int VALIDATION_INTERVAL = 10 * 60 * 1000;
+};
+
+#endif // TRIGRAMINDEX_H
@@ -2,18 +2,37 @@
 #define SESSIONMANAGER_H
 
 #include <QObject>
-#include <QTimer>
 #include <QString>
 #include <QDateTime>
+#include <QList>
+#include <QPointer>
+#include <QThreadPool>
+#include <functional>
+#include "chunkstore.h"
 
 class CodeEditor;
+class EditJournal;
+class SaveScheduler;
+
+// Everything needed to bring an open document back the way it was left
+struct DocumentState {
+    QString filePath; // empty for untitled documents
+    int cursorPosition = 0;
+    int scrollPosition = 0;
+    QList<int> foldedBlocks;
+    bool modified = false;
+    QString unsavedText; // set while a modified document isn't in the editor
+    QList<QByteArray> contentChunks; // where unsaved text is kept between runs
+};
 
 struct SessionData {
-    QString filePath;
-    QString content;
-    int cursorPosition;
+    QString filePath; // the active document
+    QString journalFilePath; // the document the edit journal follows
+    int cursorPosition = 0;
     QDateTime lastSaved;
-    bool isAutoSaved;
+    bool isAutoSaved = false;
+    QList<DocumentState> documents;
+    int activeDocument = -1;
 };
 
 class SessionManager : public QObject
@@ -21,33 +40,53 @@ class SessionManager : public QObject
     Q_OBJECT
 
 public:
-    explicit SessionManager(CodeEditor *editor, QObject *parent = nullptr);
+    SessionManager(SaveScheduler *scheduler, QObject *parent = nullptr);
     ~SessionManager();
 
+    void setEditor(CodeEditor *editor);
     void startAutoSave();
     void stopAutoSave();
     void setCurrentFile(const QString &filePath);
     bool hasAutoSavedSession() const;
     SessionData getLastSession() const;
+    QString recoverContent() const;
+    // The document recoverContent() belongs to
+    QString recoveredFilePath() const;
     void clearAutoSavedSession();
     void saveSession();
 
+    // Asked for the open documents each time the session is written
+    void setDocumentProvider(const std::function<void(QList<DocumentState> *, int *)> &provider);
+    // False if the stored text is missing or damaged
+    bool loadDocumentContent(const DocumentState &document, QString *text) const;
+
 public slots:
     void autoSave();
     void handleTextChanged();
 
 private:
     QString getAutoSaveFilePath() const;
+    QString getJournalDirectory() const;
+    QString getRecoveryJournalDirectory() const;
     QString getSessionFilePath() const;
+    QString getContentDirectory() const;
     void loadSessionData();
     void saveSessionData();
+    void followEdits(int position, int charsRemoved, const QString &inserted);
 
     CodeEditor *editor;
-    QTimer *autoSaveTimer;
+    QPointer<CodeEditor> journalEditor; // whose text the journal's checkpoint holds
+    QString recoveryJournalFilePath; // the last run's journalFilePath
+    SaveScheduler *scheduler;
+    EditJournal *journal;
+    std::function<void(QList<DocumentState> *, int *)> documentProvider;
+    ChunkStore contentStore; // only touched on ioPool
+    QThreadPool ioPool;
     QString currentFilePath;
     bool documentModified;
     SessionData currentSession;
-    static const int AUTO_SAVE_INTERVAL = 60000; // 1 minute
+    static const int AUTO_SAVE_MAX_LATENCY = 60000; // 1 minute
+    static const qint64 COMPACT_THRESHOLD = 4 * 1024 * 1024; // journal bytes before a new checkpoint
 };
 
 #endif // SESSIONMANAGER_H 
\ No newline at end of file
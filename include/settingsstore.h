@@ -0,0 +1,82 @@
+#ifndef SETTINGSSTORE_H
+#define SETTINGSSTORE_H
+
+#include <QObject>
+#include <QColor>
+#include <QFont>
+#include <QList>
+#include <QPointer>
+#include <QTimer>
+#include <QVariant>
+#include <functional>
+
+// Every editor setting, read from QSettings once and kept in memory.
+// Readers never touch the backend, so opening a tab or split costs a few
+// lookups. Writes update the cache and notify subscribers immediately;
+// the disk write is batched and happens WRITE_DELAY later or at exit.
+// Settings left by older versions under the dialog's own store are
+// migrated on first load. GUI thread only.
+class SettingsStore : public QObject
+{
+    Q_OBJECT
+
+public:
+    enum Key {
+        FontFamily,
+        FontSize,
+        TabSize,
+        AutoIndent,
+        LineWrapping,
+        Theme,
+        EditorBackground,
+        EditorForeground,
+        LineNumberBackground,
+        LineNumberForeground,
+        CurrentLine,
+        AutoSaveEnabled,
+        AutoSaveInterval,
+        KeyCount
+    };
+    Q_ENUM(Key)
+
+    static SettingsStore &instance();
+    ~SettingsStore();
+
+    QVariant value(Key key) const { return values[key]; }
+    int intValue(Key key) const { return values[key].toInt(); }
+    bool boolValue(Key key) const { return values[key].toBool(); }
+    QString stringValue(Key key) const { return values[key].toString(); }
+    QColor colorValue(Key key) const { return values[key].value<QColor>(); }
+    QFont font() const { return QFont(stringValue(FontFamily), intValue(FontSize)); }
+    static QVariant defaultValue(Key key);
+
+    void setValue(Key key, const QVariant &value);
+    // Subscribers hear about the whole batch once
+    void setValues(const QHash<Key, QVariant> &changes);
+
+    // Calls 'changed' after any of 'keys' changes, until 'receiver' is destroyed
+    void subscribe(QObject *receiver, const QList<Key> &keys, const std::function<void()> &changed);
+    void flush();
+
+    static const int WRITE_DELAY = 1000; // ms
+
+signals:
+    void valueChanged(SettingsStore::Key key, const QVariant &value);
+
+private:
+    SettingsStore();
+    void load();
+
+    struct Subscription {
+        QPointer<QObject> receiver;
+        quint32 keys; // bit per Key
+        std::function<void()> changed;
+    };
+
+    QVariant values[KeyCount];
+    quint32 dirtyKeys;
+    QList<Subscription> subscriptions;
+    QTimer *writeTimer;
+};
+
+#endif // SETTINGSSTORE_H
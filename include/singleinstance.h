@@ -0,0 +1,47 @@
+#ifndef SINGLEINSTANCE_H
+#define SINGLEINSTANCE_H
+
+#include <QObject>
+#include <QHash>
+#include <QStringList>
+
+class QLocalServer;
+class QLocalSocket;
+
+// Keeps one editor process per user. The first instance listens on a local
+// socket; later launches hand their files to it through forward() and exit
+// without ever building a QApplication. A client started with --wait stays
+// connected until every file it sent has been closed, which is what $EDITOR
+// callers such as git expect.
+class SingleInstance : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit SingleInstance(QObject *parent = nullptr);
+
+    bool listen();
+    // Returns false when no instance is running
+    static bool forward(const QStringList &files, bool wait);
+
+public slots:
+    void release(const QString &filePath);
+
+signals:
+    void openRequested(const QStringList &files);
+
+private slots:
+    void handleConnection();
+
+private:
+    void readMessage(QLocalSocket *socket);
+    static QString serverName();
+
+    QLocalServer *server;
+    QHash<QLocalSocket *, QStringList> waiting; // --wait clients and the files still open for them
+
+    static const quint32 PROTOCOL_VERSION = 1;
+    static const int CONNECT_TIMEOUT = 500; // ms
+};
+
+#endif // SINGLEINSTANCE_H
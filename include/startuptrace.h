@@ -0,0 +1,37 @@
+#ifndef STARTUPTRACE_H
+#define STARTUPTRACE_H
+
+#include <QtCore/QList>
+#include <QtCore/QElapsedTimer>
+#include <functional>
+
+class QWidget;
+
+// Timestamps of the startup phases, printed to stderr by finish() when
+// --startup-trace is given. A mark is a clock read and an append, so the
+// calls stay in release builds.
+class StartupTrace
+{
+public:
+    static void start();
+    static void setEnabled(bool enable) { enabled = enable; }
+    static bool isEnabled() { return enabled; }
+    // Ends the phase running since the previous mark
+    static void mark(const char *phase);
+    static void finish();
+
+    // Runs 'next' from the event loop once 'window' has painted for the first time
+    static void afterFirstFrame(QWidget *window, const std::function<void()> &next);
+
+private:
+    struct Phase {
+        const char *name;
+        qint64 end; // nanoseconds since start()
+    };
+
+    static QElapsedTimer clock;
+    static QList<Phase> phases;
+    static bool enabled;
+};
+
+#endif // STARTUPTRACE_H
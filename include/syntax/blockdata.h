@@ -0,0 +1,58 @@
+#ifndef BLOCKDATA_H
+#define BLOCKDATA_H
+
+#include <QtGui/QTextBlock>
+#include <QtGui/QTextBlockUserData>
+#include <QtCore/QVector>
+
+// What the highlighter decided a run of characters is
+enum class TokenClass : quint8 {
+    Plain,
+    Keyword,
+    Type,
+    Literal,
+    Builtin,
+    Comment,
+    String,
+    Function,
+    Operator,
+    Number,
+    Count
+};
+
+struct TokenRun {
+    int start;
+    int length;
+    TokenClass tokenClass;
+};
+Q_DECLARE_TYPEINFO(TokenRun, Q_PRIMITIVE_TYPE);
+
+// Per-block data shared by the highlighter and the editor; a block holds
+// only one QTextBlockUserData, so everything cached per block lives here.
+class BlockData : public QTextBlockUserData
+{
+public:
+    static BlockData *of(const QTextBlock &block)
+    {
+        return static_cast<BlockData *>(block.userData());
+    }
+
+    static BlockData *ensure(const QTextBlock &block)
+    {
+        BlockData *data = of(block);
+        if (!data) {
+            data = new BlockData;
+            QTextBlock(block).setUserData(data);
+        }
+        return data;
+    }
+
+    // Token runs in the order they were applied; later runs win
+    QVector<TokenRun> tokens;
+
+    // Fold indent cached by the editor; stale unless generation matches
+    int foldIndent = 0;
+    int foldGeneration = -1;
+};
+
+#endif // BLOCKDATA_H
@@ -8,12 +8,14 @@
 #include <QtCore/QString>
 #include <QtCore/QStringList>
 #include <QtCore/QVector>
+#include "syntax/blockdata.h"
 
 class SyntaxRule
 {
 public:
     QRegularExpression pattern;
     QTextCharFormat format;
+    TokenClass tokenClass = TokenClass::Plain;
     bool multiLine;
     QString startPattern;
     QString endPattern;
@@ -44,11 +46,15 @@ public:
     explicit SyntaxHighlighter(QTextDocument *parent = nullptr);
     void setLanguage(const QString &extension);
     void updateTheme(const QColor &defaultForeground);
+    // Foreground used for a token class; invalid for plain text
+    QColor tokenColor(TokenClass tokenClass) const;
 
 protected:
     void highlightBlock(const QString &text) override;
 
 private:
+    void highlightTokens(const QString &text);
+    void applyFormat(int start, int count, const QTextCharFormat &format, TokenClass tokenClass);
     void loadLanguageDefinition(const QString &language);
     void setupFormats();
     void highlightMultiLineComments(const QString &text);
@@ -73,6 +79,9 @@ private:
     int multiLineCommentLength;
     bool isInMultiLineComment;
     
+    // Runs recorded while the current block is highlighted
+    QVector<TokenRun> pendingTokens;
+
     // Common regular expressions
     QRegularExpression numberRegex;
     QRegularExpression functionRegex;
@@ -0,0 +1,183 @@
+#include "asynclogger.h"
+#include <QtCore/QDateTime>
+#include <QtCore/QDebug>
+#include <QtCore/QDir>
+#include <QtCore/QFileInfo>
+#include <QtCore/QThread>
+#include <chrono>
+
+AsyncLogger &AsyncLogger::instance()
+{
+    static AsyncLogger logger;
+    return logger;
+}
+
+AsyncLogger::AsyncLogger()
+    : ring(new Slot[CAPACITY]), enqueuePos(0), dequeuePos(0), dropped(0), echo(false),
+      running(false), flushRequested(false)
+{
+    // A slot is free for the producer whose position equals its sequence
+    for (int i = 0; i < CAPACITY; ++i)
+        ring[i].sequence.store(quint64(i), std::memory_order_relaxed);
+}
+
+AsyncLogger::~AsyncLogger()
+{
+    stop();
+}
+
+void AsyncLogger::log(LogLevel level, QString message, const char *function, const char *file, int line)
+{
+    quint64 pos = enqueuePos.load(std::memory_order_relaxed);
+    Slot *slot;
+    for (;;) {
+        slot = &ring[pos & (CAPACITY - 1)];
+        const qint64 diff = qint64(slot->sequence.load(std::memory_order_acquire)) - qint64(pos);
+        if (diff == 0) {
+            if (enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                break;
+        } else if (diff < 0) {
+            // The writer is a full lap behind
+            dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        } else {
+            pos = enqueuePos.load(std::memory_order_relaxed);
+        }
+    }
+
+    slot->timestamp = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+    slot->thread = quintptr(QThread::currentThreadId());
+    slot->function = function;
+    slot->file = file;
+    slot->line = line;
+    slot->level = level;
+    slot->message = std::move(message);
+    slot->sequence.store(pos + 1, std::memory_order_release);
+}
+
+void AsyncLogger::start(const QString &filePath)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (running)
+        return;
+
+    QDir().mkpath(QFileInfo(filePath).absolutePath());
+    file.setFileName(filePath);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Append))
+        qWarning() << "Cannot open log file" << filePath << file.errorString();
+
+    running = true;
+    writer = std::thread(&AsyncLogger::run, this);
+}
+
+void AsyncLogger::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!running)
+            return;
+        running = false;
+    }
+    wake.notify_one();
+    writer.join();
+    file.close();
+}
+
+void AsyncLogger::flush()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    if (!running)
+        return;
+    flushRequested = true;
+    wake.notify_one();
+    drained.wait(lock, [this]() { return !flushRequested || !running; });
+}
+
+void AsyncLogger::run()
+{
+    QByteArray batch;
+    std::unique_lock<std::mutex> lock(mutex);
+    for (;;) {
+        wake.wait_for(lock, std::chrono::milliseconds(20),
+                      [this]() { return !running || flushRequested; });
+        const bool stopping = !running;
+        const bool flushing = flushRequested;
+        lock.unlock();
+
+        batch.clear();
+        if (drain(batch) && file.isOpen()) {
+            file.write(batch);
+            file.flush();
+        }
+
+        lock.lock();
+        if (flushing) {
+            flushRequested = false;
+            drained.notify_all();
+        }
+        if (stopping)
+            break;
+    }
+}
+
+bool AsyncLogger::drain(QByteArray &batch)
+{
+    // Records within one second share their formatted date and time
+    qint64 cachedSecond = -1;
+    QByteArray cachedStamp;
+
+    for (;;) {
+        Slot &slot = ring[dequeuePos & (CAPACITY - 1)];
+        if (slot.sequence.load(std::memory_order_acquire) != dequeuePos + 1)
+            break;
+
+        const qint64 timestamp = slot.timestamp;
+        const char *function = slot.function;
+        const char *file = slot.file;
+        const int line = slot.line;
+        const LogLevel level = slot.level;
+        const QString message = std::move(slot.message);
+        slot.message = QString();
+        slot.sequence.store(dequeuePos + CAPACITY, std::memory_order_release);
+        ++dequeuePos;
+
+        const qint64 second = timestamp / 1000000;
+        if (second != cachedSecond) {
+            cachedSecond = second;
+            cachedStamp = QDateTime::fromSecsSinceEpoch(second).toString("yyyy-MM-dd hh:mm:ss").toUtf8();
+        }
+
+        const int start = batch.size();
+        batch += cachedStamp;
+        batch += '.';
+        batch += QByteArray::number((timestamp / 1000) % 1000).rightJustified(3, '0');
+        batch += ' ';
+        if (function && *function) {
+            batch += '[';
+            batch += function;
+            batch += "] ";
+        }
+        if (file && line != -1) {
+            batch += '(';
+            batch += file;
+            batch += ':';
+            batch += QByteArray::number(line);
+            batch += ") ";
+        }
+        if (level == LogLevel::Error)
+            batch += "ERROR: ";
+        else if (level == LogLevel::Warning)
+            batch += "WARNING: ";
+        batch += message.toUtf8();
+        batch += '\n';
+
+        if (echo.load(std::memory_order_relaxed))
+            qDebug().noquote() << QString::fromUtf8(batch.constData() + start, batch.size() - start - 1);
+    }
+
+    const quint64 lost = dropped.exchange(0, std::memory_order_relaxed);
+    if (lost > 0)
+        batch += "WARNING: " + QByteArray::number(lost) + " log records dropped, the queue was full\n";
+    return !batch.isEmpty();
+}
@@ -0,0 +1,86 @@
+#include "autosaveservice.h"
+#include <QSaveFile>
+#include <QStringEncoder>
+
+AutoSaveService::AutoSaveService(QObject *parent)
+    : QObject(parent)
+{
+    pool.setMaxThreadCount(1);
+}
+
+AutoSaveService::~AutoSaveService()
+{
+    pool.waitForDone();
+    // A snapshot queued behind the last write would be started from finish(),
+    // which needs the event loop; at exit it is written here instead
+    for (auto it = jobs.constBegin(); it != jobs.constEnd(); ++it) {
+        if (it->hasPending)
+            writeSnapshot(it.key(), it->pendingSnapshot);
+    }
+}
+
+void AutoSaveService::save(const QString &filePath, const QString &snapshot, quint64 revision)
+{
+    auto it = jobs.find(filePath);
+    if (it != jobs.end()) {
+        // Back-pressure: keep only the newest snapshot behind the running write
+        it->hasPending = true;
+        it->pendingSnapshot = snapshot;
+        it->pendingRevision = revision;
+        return;
+    }
+    jobs.insert(filePath, Job());
+    start(filePath, snapshot, revision);
+}
+
+void AutoSaveService::start(const QString &filePath, const QString &snapshot, quint64 revision)
+{
+    const bool known = writtenHashes.contains(filePath);
+    const size_t lastHash = writtenHashes.value(filePath);
+    pool.start([this, filePath, snapshot, revision, known, lastHash]() {
+        // Hashing is far cheaper than encoding and writing, so it goes first
+        const size_t hash = qHash(snapshot);
+        const QString error = known && hash == lastHash ? QString() : writeSnapshot(filePath, snapshot);
+        QMetaObject::invokeMethod(this, [this, filePath, revision, error, hash]() {
+            finish(filePath, revision, error, hash);
+        }, Qt::QueuedConnection);
+    });
+}
+
+void AutoSaveService::finish(const QString &filePath, quint64 revision, const QString &error, size_t hash)
+{
+    if (error.isEmpty())
+        writtenHashes.insert(filePath, hash);
+
+    auto it = jobs.find(filePath);
+    if (it != jobs.end() && it->hasPending) {
+        const QString snapshot = it->pendingSnapshot;
+        const quint64 pendingRevision = it->pendingRevision;
+        *it = Job();
+        start(filePath, snapshot, pendingRevision);
+    } else {
+        jobs.remove(filePath);
+    }
+
+    if (error.isEmpty())
+        emit saved(filePath, revision);
+    else
+        emit saveFailed(filePath, error);
+}
+
+QString AutoSaveService::writeSnapshot(const QString &filePath, const QString &snapshot)
+{
+    QSaveFile file(filePath);
+    if (!file.open(QIODevice::WriteOnly))
+        return file.errorString();
+
+    QStringEncoder encoder(QStringEncoder::Utf8);
+    const QByteArray bytes = encoder.encode(snapshot);
+    if (file.write(bytes) != bytes.size()) {
+        file.cancelWriting();
+        return file.errorString();
+    }
+    if (!file.commit())
+        return file.errorString();
+    return QString();
+}
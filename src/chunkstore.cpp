@@ -0,0 +1,142 @@
+#include "chunkstore.h"
+#include <QCryptographicHash>
+#include <QDir>
+#include <QDirIterator>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <array>
+
+namespace {
+
+// Boundary when the top 13 bits of the rolling hash are zero: 8 KB chunks on average
+const quint64 BOUNDARY_MASK = 0xfff8000000000000ULL;
+
+// Fixed pseudo-random table for the gear hash; it must never change, or
+// stored chunks would stop matching new cuts
+const std::array<quint64, 256> &gearTable()
+{
+    static const std::array<quint64, 256> table = [] {
+        std::array<quint64, 256> values{};
+        quint64 state = 0x546f617374434443ULL; // "ToastCDC"
+        for (quint64 &value : values) {
+            // splitmix64
+            quint64 z = (state += 0x9e3779b97f4a7c15ULL);
+            z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+            z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+            value = z ^ (z >> 31);
+        }
+        return values;
+    }();
+    return table;
+}
+
+} // namespace
+
+ChunkStore::ChunkStore(const QString &directory)
+    : directory(directory)
+{
+}
+
+QList<qsizetype> ChunkStore::chunkBoundaries(const QByteArray &data)
+{
+    // End offsets of each chunk. The hash shifts left once per byte, so its
+    // top bits only depend on the last 64 bytes and cuts resynchronise
+    // shortly after an edit.
+    const std::array<quint64, 256> &gear = gearTable();
+    const uchar *bytes = reinterpret_cast<const uchar *>(data.constData());
+    const qsizetype size = data.size();
+
+    QList<qsizetype> boundaries;
+    boundaries.reserve(size / (8 * 1024) + 1);
+    qsizetype start = 0;
+    while (start < size) {
+        const qsizetype end = qMin(size, start + qsizetype(MAX_CHUNK));
+        qsizetype cut = end;
+        quint64 hash = 0;
+        for (qsizetype i = start + MIN_CHUNK; i < end; ++i) {
+            hash = (hash << 1) + gear[bytes[i]];
+            if (!(hash & BOUNDARY_MASK)) {
+                cut = i + 1;
+                break;
+            }
+        }
+        boundaries.append(cut);
+        start = cut;
+    }
+    return boundaries;
+}
+
+QList<QByteArray> ChunkStore::store(const QByteArray &data)
+{
+    QList<QByteArray> ids;
+    qsizetype start = 0;
+    for (qsizetype end : chunkBoundaries(data)) {
+        const QByteArrayView chunk(data.constData() + start, end - start);
+        start = end;
+        const QByteArray id = QCryptographicHash::hash(chunk, QCryptographicHash::Sha256);
+        ids.append(id);
+        if (known.contains(id))
+            continue;
+
+        const QString path = chunkPath(directory, id);
+        if (!QFile::exists(path)) {
+            QDir().mkpath(QFileInfo(path).path());
+            QSaveFile file(path);
+            if (!file.open(QIODevice::WriteOnly))
+                return QList<QByteArray>();
+            file.write(qCompress(reinterpret_cast<const uchar *>(chunk.data()), int(chunk.size()), COMPRESSION_LEVEL));
+            if (!file.commit())
+                return QList<QByteArray>();
+        }
+        known.insert(id);
+    }
+    return ids;
+}
+
+void ChunkStore::retain(const QSet<QByteArray> &live)
+{
+    for (auto it = known.begin(); it != known.end();) {
+        if (live.contains(*it)) {
+            ++it;
+        } else {
+            QFile::remove(chunkPath(directory, *it));
+            it = known.erase(it);
+        }
+    }
+}
+
+void ChunkStore::scan()
+{
+    QDirIterator it(directory, QDir::Files, QDirIterator::Subdirectories);
+    while (it.hasNext()) {
+        it.next();
+        const QByteArray id = QByteArray::fromHex(it.fileName().toLatin1());
+        if (id.size() == ID_SIZE)
+            known.insert(id);
+    }
+}
+
+bool ChunkStore::load(const QString &directory, const QList<QByteArray> &ids, QByteArray *data)
+{
+    QByteArray result;
+    for (const QByteArray &id : ids) {
+        QFile file(chunkPath(directory, id));
+        if (!file.open(QIODevice::ReadOnly))
+            return false;
+        const QByteArray chunk = qUncompress(file.readAll());
+        // A damaged chunk must not silently become part of the document
+        if (chunk.isEmpty() || QCryptographicHash::hash(chunk, QCryptographicHash::Sha256) != id)
+            return false;
+        result.append(chunk);
+    }
+    *data = result;
+    return true;
+}
+
+QString ChunkStore::chunkPath(const QString &directory, const QByteArray &id)
+{
+    // Fan out by the first byte so no single directory grows huge
+    const QByteArray hex = id.toHex();
+    return QDir(directory).filePath(QString::fromLatin1(hex.left(2)) + '/' + QString::fromLatin1(hex));
+}
@@ -0,0 +1,206 @@
+#include "columnselection.h"
+#include <QtGui/QTextLayout>
+#include <QtGui/QTextDocument>
+#include <QtCore/QtMath>
+
+ColumnSelection::ColumnSelection()
+    : active(false), anchorBlock(0), headBlock(0), anchorX(0), headX(0),
+      metrics(QFont()), tabStop(0), margin(0), spaceAdvance(1)
+{
+}
+
+void ColumnSelection::setMetrics(const QFont &font, qreal tabStopDistance, qreal documentMargin)
+{
+    metrics = QFontMetricsF(font);
+    spaceAdvance = qMax<qreal>(1.0, metrics.horizontalAdvance(QLatin1Char(' ')));
+    tabStop = tabStopDistance > 0 ? tabStopDistance : spaceAdvance * 4;
+    margin = documentMargin;
+    rowCache.clear();
+}
+
+void ColumnSelection::begin(const QTextBlock &block, qreal x)
+{
+    active = true;
+    anchorBlock = headBlock = block.blockNumber();
+    anchorX = headX = snappedX(block, qMax(margin, x));
+    rowCache.clear();
+}
+
+void ColumnSelection::extendTo(const QTextBlock &block, qreal x)
+{
+    if (!active || !block.isValid())
+        return;
+
+    // Snap to the row under the mouse so sub-glyph jitter keeps the cache
+    x = snappedX(block, qMax(margin, x));
+    const int blockNumber = block.blockNumber();
+
+    if (x != headX) {
+        // Every row snaps differently, so spans are recomputed on demand
+        rowCache.clear();
+    } else if (blockNumber != headBlock) {
+        // Only the rows leaving the box need to be dropped
+        const int newFirst = qMin(anchorBlock, blockNumber);
+        const int newLast = qMax(anchorBlock, blockNumber);
+        const int leaving = qMax(0, newFirst - firstBlock()) + qMax(0, lastBlock() - newLast);
+
+        if (leaving > rowCache.size()) {
+            for (auto it = rowCache.begin(); it != rowCache.end(); ) {
+                if (it.key() < newFirst || it.key() > newLast)
+                    it = rowCache.erase(it);
+                else
+                    ++it;
+            }
+        } else {
+            for (int b = firstBlock(); b < newFirst; ++b)
+                rowCache.remove(b);
+            for (int b = newLast + 1; b <= lastBlock(); ++b)
+                rowCache.remove(b);
+        }
+    }
+
+    headBlock = blockNumber;
+    headX = x;
+}
+
+void ColumnSelection::moveCaretTo(qreal x)
+{
+    anchorX = headX = qMax(margin, x);
+    rowCache.clear();
+}
+
+void ColumnSelection::clear()
+{
+    active = false;
+    anchorBlock = headBlock = 0;
+    anchorX = headX = 0;
+    rowCache.clear();
+}
+
+bool ColumnSelection::isEmpty() const
+{
+    return qAbs(anchorX - headX) < spaceAdvance / 2;
+}
+
+bool ColumnSelection::containsBlock(int blockNumber) const
+{
+    return active && blockNumber >= firstBlock() && blockNumber <= lastBlock();
+}
+
+ColumnSpan ColumnSelection::span(const QTextBlock &block) const
+{
+    const int blockNumber = block.blockNumber();
+    auto it = rowCache.constFind(blockNumber);
+    if (it != rowCache.constEnd())
+        return it.value();
+
+    ColumnSpan row;
+    row.startPosition = positionForX(block, leftX(), &row.startVirtual);
+    row.endPosition = positionForX(block, rightX(), &row.endVirtual);
+    rowCache.insert(blockNumber, row);
+    return row;
+}
+
+qreal ColumnSelection::xForPosition(const QTextBlock &block, int position, int virtualColumns) const
+{
+    const int offset = qBound(0, position - block.position(), block.length() - 1);
+    qreal x;
+
+    QTextLayout *layout = block.layout();
+    if (layout && layout->lineCount() > 0) {
+        x = layout->lineAt(0).cursorToX(offset);
+    } else {
+        x = margin + advanceTo(block.text(), offset);
+    }
+    return x + virtualColumns * spaceAdvance;
+}
+
+int ColumnSelection::positionForX(const QTextBlock &block, qreal x, int *virtualColumns) const
+{
+    *virtualColumns = 0;
+
+    const qreal endX = lineEndX(block);
+    if (x >= endX) {
+        *virtualColumns = qMax(0, qRound((x - endX) / spaceAdvance));
+        return block.position() + block.length() - 1;
+    }
+
+    QTextLayout *layout = block.layout();
+    if (layout && layout->lineCount() > 0) {
+        return block.position() + layout->lineAt(0).xToCursor(x, QTextLine::CursorBetweenCharacters);
+    }
+
+    // Block has not been laid out yet, so walk the advances ourselves
+    const QString text = block.text();
+    const qreal target = x - margin;
+    qreal left = 0;
+    for (int i = 0; i < text.length(); ) {
+        int next = i;
+        qreal right = stepAdvance(text, &next, left);
+        if (target < (left + right) / 2)
+            return block.position() + i;
+        left = right;
+        i = next;
+    }
+    return block.position() + text.length();
+}
+
+qreal ColumnSelection::snappedX(const QTextBlock &block, qreal x) const
+{
+    int virtualColumns = 0;
+    int position = positionForX(block, x, &virtualColumns);
+    return xForPosition(block, position, virtualColumns);
+}
+
+qreal ColumnSelection::stepX(const QTextBlock &block, qreal x, int direction) const
+{
+    int virtualColumns = 0;
+    int position = positionForX(block, x, &virtualColumns);
+    const QString text = block.text();
+    const int offset = position - block.position();
+
+    if (direction < 0) {
+        if (virtualColumns > 0)
+            --virtualColumns;
+        else if (offset > 0)
+            position -= offset > 1 && text.at(offset - 1).isLowSurrogate() ? 2 : 1;
+    } else if (offset < text.length()) {
+        position += text.at(offset).isHighSurrogate() && offset + 1 < text.length() ? 2 : 1;
+    } else {
+        ++virtualColumns;
+    }
+    return xForPosition(block, position, virtualColumns);
+}
+
+qreal ColumnSelection::lineEndX(const QTextBlock &block) const
+{
+    QTextLayout *layout = block.layout();
+    if (layout && layout->lineCount() > 0) {
+        return layout->lineAt(0).cursorToX(block.length() - 1);
+    }
+    return margin + advanceTo(block.text(), block.length() - 1);
+}
+
+qreal ColumnSelection::advanceTo(const QString &text, int length) const
+{
+    qreal x = 0;
+    const int end = qMin(length, int(text.length()));
+    for (int i = 0; i < end; )
+        x = stepAdvance(text, &i, x);
+    return x;
+}
+
+qreal ColumnSelection::stepAdvance(const QString &text, int *index, qreal x) const
+{
+    const QChar c = text.at(*index);
+    if (c == QLatin1Char('\t')) {
+        ++*index;
+        return (qFloor(x / tabStop + 1e-6) + 1) * tabStop;
+    }
+    if (c.isHighSurrogate() && *index + 1 < text.length()) {
+        *index += 2;
+        return x + metrics.horizontalAdvance(text.mid(*index - 2, 2));
+    }
+    ++*index;
+    return x + metrics.horizontalAdvance(c);
+}
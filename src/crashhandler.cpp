@@ -1,15 +1,108 @@
 #include "crashhandler.h"
 #include <QDateTime>
 #include <QStandardPaths>
-#include <QProcess>
+#include <QStringDecoder>
+#include <QFileInfo>
+#include <atomic>
+#include <cerrno>
 #include <csignal>
-#include <cstdlib>
+#include <cstring>
+#include <ctime>
 #include <execinfo.h>
+#include <fcntl.h>
+#include <unistd.h>
 
 QString CrashHandler::s_logFilePath;
 bool CrashHandler::s_debugMode = false;
 
+namespace {
+
+// Everything the signal handler touches is set up in initialize() and
+// initializeReporting(), so the handler itself only reads these and calls
+// async-signal-safe functions
+int crashLogFd = -1;
+QByteArray recoveryPath;
+QByteArray crashReportHeader;
+std::atomic<const QString *> registeredDocument(nullptr);
+volatile sig_atomic_t handlingCrash = 0;
+alignas(16) char alternateStack[128 * 1024];
+
+const int CRASH_SIGNALS[] = { SIGSEGV, SIGBUS, SIGABRT, SIGFPE, SIGILL };
+const int MAX_FRAMES = 64;
+
+void writeAll(int fd, const char *data, size_t size)
+{
+    while (size > 0) {
+        const ssize_t written = ::write(fd, data, size);
+        if (written < 0) {
+            if (errno == EINTR)
+                continue;
+            return;
+        }
+        data += written;
+        size -= size_t(written);
+    }
+}
+
+void writeString(int fd, const char *text)
+{
+    writeAll(fd, text, strlen(text));
+}
+
+void writeNumber(int fd, long long value)
+{
+    char digits[24];
+    int i = sizeof(digits);
+    const bool negative = value < 0;
+    unsigned long long magnitude = negative ? 0ULL - (unsigned long long)value : (unsigned long long)value;
+    do {
+        digits[--i] = char('0' + magnitude % 10);
+        magnitude /= 10;
+    } while (magnitude > 0);
+    if (negative)
+        digits[--i] = '-';
+    writeAll(fd, digits + i, sizeof(digits) - i);
+}
+
+// Raw UTF-16 with a byte order mark: no conversion, so the dump costs one write()
+bool dumpDocument(const QString *text)
+{
+    const int fd = ::open(recoveryPath.constData(), O_WRONLY | O_CREAT | O_TRUNC, 0600);
+    if (fd < 0)
+        return false;
+    const char16_t bom = 0xFEFF;
+    writeAll(fd, reinterpret_cast<const char *>(&bom), sizeof(bom));
+    writeAll(fd, reinterpret_cast<const char *>(text->constData()), size_t(text->size()) * sizeof(QChar));
+    ::close(fd);
+    return true;
+}
+
+} // namespace
+
 void CrashHandler::initialize()
+{
+    // backtrace() loads libgcc on first use, which allocates, so call it once now
+    void *frames[MAX_FRAMES];
+    backtrace(frames, MAX_FRAMES);
+
+    // A stack overflow leaves no stack to run the handler on
+    stack_t stack;
+    stack.ss_sp = alternateStack;
+    stack.ss_size = sizeof(alternateStack);
+    stack.ss_flags = 0;
+    sigaltstack(&stack, nullptr);
+
+    // Install signal handlers; SA_RESETHAND makes a second fault fall through to the default
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = handleCrash;
+    action.sa_flags = SA_ONSTACK | SA_RESETHAND;
+    sigemptyset(&action.sa_mask);
+    for (int sig : CRASH_SIGNALS)
+        sigaction(sig, &action, nullptr);
+}
+
+void CrashHandler::initializeReporting()
 {
     // Set up log file path
     QString appDataPath = QStandardPaths::writableLocation(QStandardPaths::AppDataLocation);
@@ -19,11 +112,15 @@ void CrashHandler::initialize()
                                 .arg(QDateTime::currentDateTime()
                                 .toString("yyyy-MM-dd_hh-mm-ss")));
 
-    // Install signal handlers
-    signal(SIGSEGV, handleCrash);
-    signal(SIGABRT, handleCrash);
-    signal(SIGFPE, handleCrash);
-    signal(SIGILL, handleCrash);
+    // Everything logged so far is still queued and goes out once the writer runs
+    AsyncLogger::instance().start(s_logFilePath);
+
+    // Preallocate what the crash path needs: its own descriptor on the log,
+    // the recovery path and the report header
+    crashLogFd = ::open(QFile::encodeName(s_logFilePath).constData(),
+                        O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0644);
+    recoveryPath = QFile::encodeName(recoveryFilePath());
+    crashReportHeader = ("System info:\n" + getSystemInfo()).toUtf8();
 
     LOG_DEBUG("Crash handler initialized");
     LOG_DEBUG("Log file: " + s_logFilePath);
@@ -32,93 +129,86 @@ void CrashHandler::initialize()
 
 void CrashHandler::handleCrash(int signal)
 {
-    QString crashMessage = QString("\n=== CRASH DETECTED ===\n")
-                          + "Signal: " + QString::number(signal) + "\n"
-                          + "Time: " + QDateTime::currentDateTime().toString() + "\n"
-                          + "Stack trace:\n" + getStackTrace() + "\n"
-                          + "System info:\n" + getSystemInfo() + "\n"
-                          + "==================\n";
-
-    writeToLog(crashMessage);
-    
-    // Ensure the log is written before exiting
-    QFile logFile(s_logFilePath);
-    logFile.flush();
-    
-    // In debug mode, we'll abort to get a core dump
-    if (s_debugMode) {
-        abort();
-    } else {
-        exit(signal);
+    // A fault inside the handler: give up and let the default action run
+    if (handlingCrash) {
+        ::signal(signal, SIG_DFL);
+        raise(signal);
+        return;
     }
+    handlingCrash = 1;
+
+    const int fd = crashLogFd >= 0 ? crashLogFd : STDERR_FILENO;
+    writeString(fd, "\n=== CRASH DETECTED ===\nSignal: ");
+    writeNumber(fd, signal);
+    writeString(fd, "\nTime: ");
+    writeNumber(fd, (long long)time(nullptr));
+    writeString(fd, " (seconds since the epoch)\nStack trace:\n");
+    void *frames[MAX_FRAMES];
+    const int count = backtrace(frames, MAX_FRAMES);
+    backtrace_symbols_fd(frames, count, fd);
+    writeAll(fd, crashReportHeader.constData(), size_t(crashReportHeader.size()));
+
+    // The trace is out first in case the document itself is what's corrupted
+    if (const QString *text = registeredDocument.load(std::memory_order_acquire)) {
+        const bool dumped = dumpDocument(text);
+        writeString(fd, dumped ? "Unsaved document written to " : "Could not write the unsaved document to ");
+        writeString(fd, recoveryPath.constData());
+        writeString(fd, "\n");
+    }
+    writeString(fd, "==================\n");
+
+    // Re-raise with the default action so the exit status and core dump are the real ones
+    ::signal(signal, SIG_DFL);
+    raise(signal);
 }
 
-void CrashHandler::logMessage(const QString& message, const QString& function,
-                            const QString& file, int line)
+void CrashHandler::shutdown()
 {
-    QString logMessage = QDateTime::currentDateTime().toString("yyyy-MM-dd hh:mm:ss.zzz ");
-    
-    if (!function.isEmpty()) {
-        logMessage += "[" + function + "] ";
-    }
-    if (!file.isEmpty() && line != -1) {
-        logMessage += QString("(%1:%2) ").arg(file).arg(line);
-    }
-    
-    logMessage += message + "\n";
-    writeToLog(logMessage);
+    registeredDocument.store(nullptr, std::memory_order_release);
+    AsyncLogger::instance().stop();
 }
 
-QString CrashHandler::getLogFilePath()
+void CrashHandler::registerDocument(const QString *text)
 {
-    return s_logFilePath;
+    registeredDocument.store(text, std::memory_order_release);
 }
 
-void CrashHandler::enableDebugMode(bool enable)
+QString CrashHandler::recoveryFilePath()
 {
-    s_debugMode = enable;
-    LOG_DEBUG(QString("Debug mode %1").arg(enable ? "enabled" : "disabled"));
+    QString basePath = QStandardPaths::writableLocation(QStandardPaths::AppDataLocation);
+    QDir().mkpath(basePath);
+    return basePath + "/crash-recovery.utf16";
 }
 
-void CrashHandler::ensureLogDirectoryExists()
+bool CrashHandler::hasRecoveryDump()
 {
-    QFileInfo fileInfo(s_logFilePath);
-    QDir dir = fileInfo.dir();
-    if (!dir.exists()) {
-        dir.mkpath(".");
-    }
+    return QFileInfo(recoveryFilePath()).size() > 0;
 }
 
-void CrashHandler::writeToLog(const QString& message)
+QString CrashHandler::readRecoveryDump()
 {
-    ensureLogDirectoryExists();
-    
-    QFile logFile(s_logFilePath);
-    if (logFile.open(QIODevice::WriteOnly | QIODevice::Append | QIODevice::Text)) {
-        QTextStream stream(&logFile);
-        stream << message;
-        stream.flush();
-        logFile.close();
-    }
-    
-    if (s_debugMode) {
-        qDebug().noquote() << message.trimmed();
-    }
+    QFile file(recoveryFilePath());
+    if (!file.open(QIODevice::ReadOnly))
+        return QString();
+    QStringDecoder decoder(QStringDecoder::Utf16);
+    return decoder.decode(file.readAll());
 }
 
-QString CrashHandler::getStackTrace()
+void CrashHandler::clearRecoveryDump()
 {
-    QString stackTrace;
-    void* array[50];
-    int size = backtrace(array, 50);
-    char** messages = backtrace_symbols(array, size);
+    QFile::remove(recoveryFilePath());
+}
 
-    for (int i = 0; i < size && messages != nullptr; ++i) {
-        stackTrace += QString("%1: %2\n").arg(i).arg(messages[i]);
-    }
+QString CrashHandler::getLogFilePath()
+{
+    return s_logFilePath;
+}
 
-    free(messages);
-    return stackTrace;
+void CrashHandler::enableDebugMode(bool enable)
+{
+    s_debugMode = enable;
+    AsyncLogger::instance().setEcho(enable);
+    LOG_DEBUG(QString("Debug mode %1").arg(enable ? "enabled" : "disabled"));
 }
 
 QString CrashHandler::getSystemInfo()
@@ -131,6 +221,6 @@ QString CrashHandler::getSystemInfo()
     info += "CPU Architecture: " + QSysInfo::currentCpuArchitecture() + "\n";
     info += "Kernel Type: " + QSysInfo::kernelType() + "\n";
     info += "Kernel Version: " + QSysInfo::kernelVersion() + "\n";
-    
+
     return info;
-} 
\ No newline at end of file
+}
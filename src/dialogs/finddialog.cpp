@@ -6,6 +6,7 @@
 
 FindDialog::FindDialog(QWidget *parent)
     : QDialog(parent)
+    , replaceAllowed(true)
 {
     setWindowTitle(tr("Find and Replace"));
     setModal(false);
@@ -15,6 +16,8 @@ FindDialog::FindDialog(QWidget *parent)
     replaceLineEdit = new QLineEdit;
     caseSensitiveCheckBox = new QCheckBox(tr("&Case sensitive"));
     wholeWordsCheckBox = new QCheckBox(tr("&Whole words only"));
+    regexCheckBox = new QCheckBox(tr("Regular e&xpression"));
+    regexCheckBox->setToolTip(tr("Patterns may span lines; use \\1 or $1 in the replacement"));
     searchBackwardsCheckBox = new QCheckBox(tr("Search &backwards"));
     wrapAroundCheckBox = new QCheckBox(tr("&Wrap around"));
     
@@ -25,9 +28,16 @@ FindDialog::FindDialog(QWidget *parent)
     closeButton = new QPushButton(tr("Close"));
     
     messageLabel = new QLabel;
-    messageLabel->setStyleSheet("QLabel { color: red }");
     messageLabel->hide();
 
+    matchCountLabel = new QLabel;
+    matchCountLabel->setAlignment(Qt::AlignRight | Qt::AlignVCenter);
+
+    // Coalesce keystrokes so a burst of typing starts only one search
+    searchDebounceTimer = new QTimer(this);
+    searchDebounceTimer->setSingleShot(true);
+    searchDebounceTimer->setInterval(SEARCH_DEBOUNCE_MS);
+
     // Set default states
     findNextButton->setDefault(true);
     findNextButton->setEnabled(false);
@@ -43,6 +53,7 @@ FindDialog::FindDialog(QWidget *parent)
     // Add widgets to layouts
     topLayout->addWidget(new QLabel(tr("Find what:")), 0, 0);
     topLayout->addWidget(searchLineEdit, 0, 1);
+    topLayout->addWidget(matchCountLabel, 0, 2);
     topLayout->addWidget(new QLabel(tr("Replace with:")), 1, 0);
     topLayout->addWidget(replaceLineEdit, 1, 1);
 
@@ -51,6 +62,7 @@ FindDialog::FindDialog(QWidget *parent)
     QVBoxLayout *optionsLayout = new QVBoxLayout;
     optionsLayout->addWidget(caseSensitiveCheckBox);
     optionsLayout->addWidget(wholeWordsCheckBox);
+    optionsLayout->addWidget(regexCheckBox);
     optionsLayout->addWidget(searchBackwardsCheckBox);
     optionsLayout->addWidget(wrapAroundCheckBox);
     optionsGroup->setLayout(optionsLayout);
@@ -73,6 +85,16 @@ FindDialog::FindDialog(QWidget *parent)
     // Connect signals and slots
     connect(searchLineEdit, &QLineEdit::textChanged,
             this, &FindDialog::enableFindButton);
+    connect(searchLineEdit, &QLineEdit::textChanged,
+            this, &FindDialog::scheduleIncrementalSearch);
+    connect(caseSensitiveCheckBox, &QCheckBox::toggled,
+            this, &FindDialog::scheduleIncrementalSearch);
+    connect(wholeWordsCheckBox, &QCheckBox::toggled,
+            this, &FindDialog::scheduleIncrementalSearch);
+    connect(regexCheckBox, &QCheckBox::toggled,
+            this, &FindDialog::scheduleIncrementalSearch);
+    connect(searchDebounceTimer, &QTimer::timeout,
+            this, &FindDialog::searchTextEdited);
     connect(findNextButton, &QPushButton::clicked,
             this, &FindDialog::findNext);
     connect(findPreviousButton, &QPushButton::clicked,
@@ -90,9 +112,10 @@ void FindDialog::enableFindButton(const QString &text)
     bool enable = !text.isEmpty();
     findNextButton->setEnabled(enable);
     findPreviousButton->setEnabled(enable);
-    replaceButton->setEnabled(enable);
-    replaceAllButton->setEnabled(enable);
+    replaceButton->setEnabled(enable && replaceAllowed);
+    replaceAllButton->setEnabled(enable && replaceAllowed);
     messageLabel->hide();
+    matchCountLabel->clear();
 }
 
 QString FindDialog::searchText() const
@@ -115,6 +138,11 @@ bool FindDialog::wholeWords() const
     return wholeWordsCheckBox->isChecked();
 }
 
+bool FindDialog::regularExpression() const
+{
+    return regexCheckBox->isChecked();
+}
+
 bool FindDialog::searchBackwards() const
 {
     return searchBackwardsCheckBox->isChecked();
@@ -127,10 +155,43 @@ bool FindDialog::wrapAround() const
 
 void FindDialog::showMessage(const QString &message)
 {
+    messageLabel->setStyleSheet("QLabel { color: red }");
     messageLabel->setText(message);
     messageLabel->show();
 }
 
+void FindDialog::showReplaceSummary(int count, qint64 elapsedMs)
+{
+    messageLabel->setStyleSheet(QString());
+    if (count == 0) {
+        messageLabel->setText(tr("Nothing to replace"));
+    } else {
+        messageLabel->setText(tr("Replaced %n occurrence(s) in %1 ms", nullptr, count).arg(elapsedMs));
+    }
+    messageLabel->show();
+}
+
+void FindDialog::setReplaceEnabled(bool enabled)
+{
+    replaceAllowed = enabled;
+    const bool enable = enabled && !searchLineEdit->text().isEmpty();
+    replaceButton->setEnabled(enable);
+    replaceAllButton->setEnabled(enable);
+}
+
+void FindDialog::setMatchCount(int current, int total)
+{
+    if (searchLineEdit->text().isEmpty()) {
+        matchCountLabel->clear();
+    } else if (total == 0) {
+        matchCountLabel->setText(tr("No matches"));
+    } else if (current > 0) {
+        matchCountLabel->setText(tr("%1 of %2").arg(current).arg(total));
+    } else {
+        matchCountLabel->setText(tr("%n match(es)", nullptr, total));
+    }
+}
+
 void FindDialog::replace()
 {
     emit replaceRequested();
@@ -139,4 +200,10 @@ void FindDialog::replace()
 void FindDialog::replaceAll()
 {
     emit replaceAllRequested();
-} 
\ No newline at end of file
+} 
+
+void FindDialog::scheduleIncrementalSearch()
+{
+    messageLabel->hide();
+    searchDebounceTimer->start();
+}
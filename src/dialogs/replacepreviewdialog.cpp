@@ -0,0 +1,119 @@
+#include "dialogs/replacepreviewdialog.h"
+#include <QLabel>
+#include <QPushButton>
+#include <QTreeWidget>
+#include <QHeaderView>
+#include <QPlainTextEdit>
+#include <QSplitter>
+#include <QVBoxLayout>
+#include <QHBoxLayout>
+#include <QFontDatabase>
+#include <QDir>
+
+ReplacePreviewDialog::ReplacePreviewDialog(const QVector<FileEdit> &edits, const QString &rootPath,
+                                           QWidget *parent)
+    : QDialog(parent), edits(edits)
+{
+    setupUi();
+
+    const QDir root(rootPath);
+    fileTree->setUpdatesEnabled(false);
+    for (int i = 0; i < edits.size(); ++i) {
+        QTreeWidgetItem *item = new QTreeWidgetItem(fileTree);
+        item->setText(0, QDir::toNativeSeparators(root.relativeFilePath(edits.at(i).filePath)));
+        item->setText(1, QString::number(edits.at(i).count));
+        item->setCheckState(0, Qt::Checked);
+        item->setData(0, Qt::UserRole, i);
+    }
+    fileTree->setUpdatesEnabled(true);
+
+    createConnections();
+    updateSummary();
+    if (fileTree->topLevelItemCount() > 0)
+        fileTree->setCurrentItem(fileTree->topLevelItem(0));
+}
+
+void ReplacePreviewDialog::setupUi()
+{
+    summaryLabel = new QLabel;
+
+    fileTree = new QTreeWidget;
+    fileTree->setHeaderLabels({tr("File"), tr("Replacements")});
+    fileTree->setRootIsDecorated(false);
+    fileTree->setUniformRowHeights(true);
+    fileTree->header()->setSectionResizeMode(0, QHeaderView::Stretch);
+    fileTree->header()->setSectionResizeMode(1, QHeaderView::ResizeToContents);
+
+    diffView = new QPlainTextEdit;
+    diffView->setReadOnly(true);
+    diffView->setLineWrapMode(QPlainTextEdit::NoWrap);
+    diffView->setFont(QFontDatabase::systemFont(QFontDatabase::FixedFont));
+
+    QSplitter *splitter = new QSplitter(Qt::Vertical);
+    splitter->addWidget(fileTree);
+    splitter->addWidget(diffView);
+    splitter->setStretchFactor(1, 2);
+
+    applyButton = new QPushButton(tr("&Replace"));
+    cancelButton = new QPushButton(tr("Cancel"));
+    applyButton->setDefault(true);
+
+    QHBoxLayout *buttonLayout = new QHBoxLayout;
+    buttonLayout->addStretch();
+    buttonLayout->addWidget(applyButton);
+    buttonLayout->addWidget(cancelButton);
+
+    QVBoxLayout *mainLayout = new QVBoxLayout;
+    mainLayout->addWidget(summaryLabel);
+    mainLayout->addWidget(splitter);
+    mainLayout->addLayout(buttonLayout);
+
+    setLayout(mainLayout);
+    setWindowTitle(tr("Replace in Files"));
+    resize(800, 600);
+}
+
+void ReplacePreviewDialog::createConnections()
+{
+    connect(fileTree, &QTreeWidget::currentItemChanged, this, &ReplacePreviewDialog::showDiff);
+    connect(fileTree, &QTreeWidget::itemChanged, this, &ReplacePreviewDialog::updateSummary);
+    connect(applyButton, &QPushButton::clicked, this, &QDialog::accept);
+    connect(cancelButton, &QPushButton::clicked, this, &QDialog::reject);
+}
+
+void ReplacePreviewDialog::showDiff(QTreeWidgetItem *item)
+{
+    if (!item) {
+        diffView->clear();
+        return;
+    }
+    // Diffs are built on demand; most files are never looked at
+    const FileEdit &edit = edits.at(item->data(0, Qt::UserRole).toInt());
+    diffView->setPlainText(ProjectReplace::previewDiff(edit));
+}
+
+void ReplacePreviewDialog::updateSummary()
+{
+    int files = 0;
+    int replacements = 0;
+    for (int i = 0; i < fileTree->topLevelItemCount(); ++i) {
+        QTreeWidgetItem *item = fileTree->topLevelItem(i);
+        if (item->checkState(0) == Qt::Checked) {
+            ++files;
+            replacements += edits.at(item->data(0, Qt::UserRole).toInt()).count;
+        }
+    }
+    summaryLabel->setText(tr("%n replacement(s) in %1 file(s)", nullptr, replacements).arg(files));
+    applyButton->setEnabled(files > 0);
+}
+
+QVector<FileEdit> ReplacePreviewDialog::selectedEdits() const
+{
+    QVector<FileEdit> selected;
+    for (int i = 0; i < fileTree->topLevelItemCount(); ++i) {
+        QTreeWidgetItem *item = fileTree->topLevelItem(i);
+        if (item->checkState(0) == Qt::Checked)
+            selected.append(edits.at(item->data(0, Qt::UserRole).toInt()));
+    }
+    return selected;
+}
@@ -1,4 +1,5 @@
 #include "dialogs/settingsdialog.h"
+#include "settingsstore.h"
 #include <QTabWidget>
 #include <QVBoxLayout>
 #include <QHBoxLayout>
@@ -14,7 +15,7 @@
 #include <QStyleFactory>
 
 SettingsDialog::SettingsDialog(QWidget *parent)
-    : QDialog(parent), settings("TextEditor", "Settings")
+    : QDialog(parent)
 {
     setWindowTitle(tr("Settings"));
     setModal(true);
@@ -203,80 +204,74 @@ void SettingsDialog::setupConnections()
 
 void SettingsDialog::loadSettings()
 {
+    const SettingsStore &store = SettingsStore::instance();
+
     // Load font settings
-    QString fontFamily = settings.value("font/family", "Consolas").toString();
-    int fontSize = settings.value("font/size", 11).toInt();
-    fontComboBox->setCurrentFont(QFont(fontFamily));
-    fontSizeSpinBox->setValue(fontSize);
+    fontComboBox->setCurrentFont(QFont(store.stringValue(SettingsStore::FontFamily)));
+    fontSizeSpinBox->setValue(store.intValue(SettingsStore::FontSize));
 
     // Load editor settings
-    tabSizeSpinBox->setValue(settings.value("editor/tabSize", 4).toInt());
-    autoIndentCheckBox->setChecked(settings.value("editor/autoIndent", true).toBool());
-    lineWrappingCheckBox->setChecked(settings.value("editor/lineWrapping", true).toBool());
+    tabSizeSpinBox->setValue(store.intValue(SettingsStore::TabSize));
+    autoIndentCheckBox->setChecked(store.boolValue(SettingsStore::AutoIndent));
+    lineWrappingCheckBox->setChecked(store.boolValue(SettingsStore::LineWrapping));
 
     // Load theme settings
-    themeComboBox->setCurrentText(settings.value("theme/name", "Light").toString());
-    editorBackgroundColor = settings.value("theme/editorBackground", QColor(Qt::white)).value<QColor>();
-    editorForegroundColor = settings.value("theme/editorForeground", QColor(Qt::black)).value<QColor>();
-    lineNumberBackgroundColor = settings.value("theme/lineNumberBackground", QColor(Qt::lightGray)).value<QColor>();
-    lineNumberForegroundColor = settings.value("theme/lineNumberForeground", QColor(Qt::black)).value<QColor>();
-    currentLineColor = settings.value("theme/currentLine", QColor(Qt::yellow).lighter(160)).value<QColor>();
+    themeComboBox->setCurrentText(store.stringValue(SettingsStore::Theme));
+    editorBackgroundColor = store.colorValue(SettingsStore::EditorBackground);
+    editorForegroundColor = store.colorValue(SettingsStore::EditorForeground);
+    lineNumberBackgroundColor = store.colorValue(SettingsStore::LineNumberBackground);
+    lineNumberForegroundColor = store.colorValue(SettingsStore::LineNumberForeground);
+    currentLineColor = store.colorValue(SettingsStore::CurrentLine);
 
     // Load auto-save settings
-    autoSaveCheckBox->setChecked(settings.value("autoSave/enabled", false).toBool());
-    autoSaveIntervalSpinBox->setValue(settings.value("autoSave/interval", 5).toInt());
+    autoSaveCheckBox->setChecked(store.boolValue(SettingsStore::AutoSaveEnabled));
+    autoSaveIntervalSpinBox->setValue(store.intValue(SettingsStore::AutoSaveInterval));
 
     updatePreview();
 }
 
+// One batch, so each editor reapplies a changed group once
 void SettingsDialog::saveSettings()
 {
-    // Save font settings
-    settings.setValue("font/family", fontComboBox->currentFont().family());
-    settings.setValue("font/size", fontSizeSpinBox->value());
-
-    // Save editor settings
-    settings.setValue("editor/tabSize", tabSizeSpinBox->value());
-    settings.setValue("editor/autoIndent", autoIndentCheckBox->isChecked());
-    settings.setValue("editor/lineWrapping", lineWrappingCheckBox->isChecked());
-
-    // Save theme settings
-    settings.setValue("theme/name", themeComboBox->currentText());
-    settings.setValue("theme/editorBackground", editorBackgroundColor);
-    settings.setValue("theme/editorForeground", editorForegroundColor);
-    settings.setValue("theme/lineNumberBackground", lineNumberBackgroundColor);
-    settings.setValue("theme/lineNumberForeground", lineNumberForegroundColor);
-    settings.setValue("theme/currentLine", currentLineColor);
-
-    // Save auto-save settings
-    settings.setValue("autoSave/enabled", autoSaveCheckBox->isChecked());
-    settings.setValue("autoSave/interval", autoSaveIntervalSpinBox->value());
-
-    settings.sync();
+    SettingsStore::instance().setValues({
+        {SettingsStore::FontFamily, fontComboBox->currentFont().family()},
+        {SettingsStore::FontSize, fontSizeSpinBox->value()},
+        {SettingsStore::TabSize, tabSizeSpinBox->value()},
+        {SettingsStore::AutoIndent, autoIndentCheckBox->isChecked()},
+        {SettingsStore::LineWrapping, lineWrappingCheckBox->isChecked()},
+        {SettingsStore::Theme, themeComboBox->currentText()},
+        {SettingsStore::EditorBackground, editorBackgroundColor},
+        {SettingsStore::EditorForeground, editorForegroundColor},
+        {SettingsStore::LineNumberBackground, lineNumberBackgroundColor},
+        {SettingsStore::LineNumberForeground, lineNumberForegroundColor},
+        {SettingsStore::CurrentLine, currentLineColor},
+        {SettingsStore::AutoSaveEnabled, autoSaveCheckBox->isChecked()},
+        {SettingsStore::AutoSaveInterval, autoSaveIntervalSpinBox->value()},
+    });
 }
 
 void SettingsDialog::resetToDefaults()
 {
     // Reset font settings
-    fontComboBox->setCurrentFont(QFont("Consolas"));
-    fontSizeSpinBox->setValue(11);
+    fontComboBox->setCurrentFont(QFont(SettingsStore::defaultValue(SettingsStore::FontFamily).toString()));
+    fontSizeSpinBox->setValue(SettingsStore::defaultValue(SettingsStore::FontSize).toInt());
 
     // Reset editor settings
-    tabSizeSpinBox->setValue(4);
-    autoIndentCheckBox->setChecked(true);
-    lineWrappingCheckBox->setChecked(true);
+    tabSizeSpinBox->setValue(SettingsStore::defaultValue(SettingsStore::TabSize).toInt());
+    autoIndentCheckBox->setChecked(SettingsStore::defaultValue(SettingsStore::AutoIndent).toBool());
+    lineWrappingCheckBox->setChecked(SettingsStore::defaultValue(SettingsStore::LineWrapping).toBool());
 
     // Reset theme settings
-    themeComboBox->setCurrentText("Light");
-    editorBackgroundColor = Qt::white;
-    editorForegroundColor = Qt::black;
-    lineNumberBackgroundColor = Qt::lightGray;
-    lineNumberForegroundColor = Qt::black;
-    currentLineColor = QColor(Qt::yellow).lighter(160);
+    themeComboBox->setCurrentText(SettingsStore::defaultValue(SettingsStore::Theme).toString());
+    editorBackgroundColor = SettingsStore::defaultValue(SettingsStore::EditorBackground).value<QColor>();
+    editorForegroundColor = SettingsStore::defaultValue(SettingsStore::EditorForeground).value<QColor>();
+    lineNumberBackgroundColor = SettingsStore::defaultValue(SettingsStore::LineNumberBackground).value<QColor>();
+    lineNumberForegroundColor = SettingsStore::defaultValue(SettingsStore::LineNumberForeground).value<QColor>();
+    currentLineColor = SettingsStore::defaultValue(SettingsStore::CurrentLine).value<QColor>();
 
     // Reset auto-save settings
-    autoSaveCheckBox->setChecked(false);
-    autoSaveIntervalSpinBox->setValue(5);
+    autoSaveCheckBox->setChecked(SettingsStore::defaultValue(SettingsStore::AutoSaveEnabled).toBool());
+    autoSaveIntervalSpinBox->setValue(SettingsStore::defaultValue(SettingsStore::AutoSaveInterval).toInt());
 
     updatePreview();
 }
@@ -0,0 +1,60 @@
+#include "documenthandle.h"
+#include "editor.h"
+#include <QScrollBar>
+
+DocumentHandle::DocumentHandle(const DocumentState &state)
+    : lastShown(0), documentState(state)
+{
+}
+
+DocumentHandle::~DocumentHandle()
+{
+    delete codeEditor;
+}
+
+void DocumentHandle::attach(CodeEditor *editor)
+{
+    delete codeEditor;
+    codeEditor = editor;
+}
+
+void DocumentHandle::unload()
+{
+    if (!codeEditor)
+        return;
+    storeState();
+    delete codeEditor;
+}
+
+DocumentState DocumentHandle::state() const
+{
+    if (!codeEditor)
+        return documentState;
+
+    DocumentState state = documentState;
+    state.cursorPosition = codeEditor->textCursor().position();
+    state.scrollPosition = codeEditor->verticalScrollBar()->value();
+    state.foldedBlocks = codeEditor->collapsedFolds();
+    state.modified = codeEditor->document()->isModified();
+    // Shares the editor's snapshot; encoding happens on the session's worker
+    state.unsavedText = state.modified ? codeEditor->documentSnapshot() : QString();
+    state.contentChunks.clear();
+    return state;
+}
+
+// Once the editor holds the text, the stored copy is only a second one
+void DocumentHandle::releaseSavedText()
+{
+    documentState.unsavedText = QString();
+    documentState.contentChunks.clear();
+}
+
+bool DocumentHandle::isModified() const
+{
+    return codeEditor ? codeEditor->document()->isModified() : documentState.modified;
+}
+
+qsizetype DocumentHandle::loadedSize() const
+{
+    return codeEditor ? codeEditor->document()->characterCount() : 0;
+}
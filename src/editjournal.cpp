@@ -0,0 +1,304 @@
+#include "editjournal.h"
+#include <QDir>
+#include <QSaveFile>
+#include <QFileInfo>
+#include <QtEndian>
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+const int FILE_HEADER_SIZE = 8;   // magic, version
+const int RECORD_HEADER_SIZE = 8; // payload size, checksum, reserved
+const int PAYLOAD_FIXED_SIZE = 12; // position, removed, inserted length
+
+void appendInt(QByteArray &buffer, quint32 value)
+{
+    const quint32 le = qToLittleEndian(value);
+    buffer.append(reinterpret_cast<const char *>(&le), sizeof(le));
+}
+
+quint32 readInt(const char *data)
+{
+    quint32 value;
+    memcpy(&value, data, sizeof(value));
+    return qFromLittleEndian(value);
+}
+
+// Generation numbers of the files in 'directory' matching prefix-<n>.suffix, ascending
+QList<int> generations(const QString &directory, const QString &prefix, const QString &suffix)
+{
+    QList<int> result;
+    const QStringList names = QDir(directory).entryList({prefix + "-*." + suffix}, QDir::Files);
+    for (const QString &name : names) {
+        bool ok = false;
+        const int generation = name.mid(prefix.size() + 1, name.size() - prefix.size() - suffix.size() - 2).toInt(&ok);
+        if (ok && generation > 0)
+            result.append(generation);
+    }
+    std::sort(result.begin(), result.end());
+    return result;
+}
+
+} // namespace
+
+EditJournal::EditJournal(const QString &directory, QObject *parent)
+    : QObject(parent), directory(directory), chunks(chunkDirectory(directory)), generation(1), journalBytes(0)
+{
+    // All file access runs on this one thread, in order, so the GUI never waits on the disk
+    ioPool.setMaxThreadCount(1);
+
+    flushTimer = new QTimer(this);
+    flushTimer->setSingleShot(true);
+    flushTimer->setInterval(FLUSH_DELAY);
+    connect(flushTimer, &QTimer::timeout, this, &EditJournal::flush);
+
+    // Generation 1 starts from an empty document, so it needs no checkpoint
+    ioPool.start([this]() {
+        discard(this->directory);
+        QDir().mkpath(this->directory);
+        openJournal(1);
+    });
+}
+
+EditJournal::~EditJournal()
+{
+    flush();
+    ioPool.waitForDone();
+    journal.close();
+}
+
+bool EditJournal::append(int position, int charsRemoved, const QString &inserted)
+{
+    if (inserted.size() > MAX_RECORD_CHARS)
+        return false;
+    const quint32 payloadSize = PAYLOAD_FIXED_SIZE + quint32(inserted.size()) * sizeof(char16_t);
+    const int start = pending.size();
+    pending.reserve(start + RECORD_HEADER_SIZE + int(payloadSize));
+    appendInt(pending, payloadSize);
+    appendInt(pending, 0); // checksum, filled in below
+    appendInt(pending, quint32(position));
+    appendInt(pending, quint32(charsRemoved));
+    appendInt(pending, quint32(inserted.size()));
+    if constexpr (Q_BYTE_ORDER == Q_LITTLE_ENDIAN) {
+        pending.append(reinterpret_cast<const char *>(inserted.constData()), inserted.size() * sizeof(char16_t));
+    } else {
+        for (QChar c : inserted) {
+            const quint16 unit = qToLittleEndian(c.unicode());
+            pending.append(reinterpret_cast<const char *>(&unit), sizeof(unit));
+        }
+    }
+
+    const quint16 checksum = qChecksum(QByteArrayView(pending).mid(start + RECORD_HEADER_SIZE));
+    const quint16 le = qToLittleEndian(checksum);
+    memcpy(pending.data() + start + 4, &le, sizeof(le));
+
+    journalBytes += RECORD_HEADER_SIZE + payloadSize;
+    if (!flushTimer->isActive())
+        flushTimer->start();
+    return true;
+}
+
+void EditJournal::flush()
+{
+    flushTimer->stop();
+    if (pending.isEmpty())
+        return;
+    QByteArray records;
+    records.swap(pending);
+    ioPool.start([this, records]() {
+        if (journal.isOpen()) {
+            journal.write(records);
+            journal.flush();
+        }
+    });
+}
+
+void EditJournal::checkpoint(const QString &text)
+{
+    // Edits from here on go to the next generation while the base is written
+    flush();
+    const int base = ++generation;
+    journalBytes = 0;
+    ioPool.start([this, base, text]() {
+        if (openJournal(base) && writeCheckpoint(base, text))
+            removeGenerationsBefore(directory, base);
+    });
+}
+
+bool EditJournal::openJournal(int newGeneration)
+{
+    journal.close();
+    journal.setFileName(journalPath(directory, newGeneration));
+    if (!journal.open(QIODevice::WriteOnly | QIODevice::Truncate))
+        return false;
+
+    QByteArray header;
+    appendInt(header, MAGIC);
+    appendInt(header, VERSION);
+    journal.write(header);
+    journal.flush();
+    return true;
+}
+
+bool EditJournal::writeCheckpoint(int generation, const QString &text)
+{
+    const QByteArray data = text.toUtf8();
+    const QList<QByteArray> ids = chunks.store(data);
+    if (ids.isEmpty() && !data.isEmpty())
+        return false;
+
+    QByteArray manifest;
+    manifest.reserve(12 + ids.size() * ChunkStore::ID_SIZE);
+    appendInt(manifest, CHECKPOINT_MAGIC);
+    appendInt(manifest, CHECKPOINT_VERSION);
+    appendInt(manifest, quint32(ids.size()));
+    for (const QByteArray &id : ids)
+        manifest.append(id);
+
+    // QSaveFile only renames into place after a complete write, so an existing
+    // checkpoint is always whole, and its chunks were committed before it
+    QSaveFile file(checkpointPath(directory, generation));
+    if (!file.open(QIODevice::WriteOnly))
+        return false;
+    file.write(manifest);
+    if (!file.commit())
+        return false;
+
+    // Only this checkpoint survives, so chunks it doesn't use are garbage
+    chunks.retain(QSet<QByteArray>(ids.cbegin(), ids.cend()));
+    return true;
+}
+
+void EditJournal::removeGenerationsBefore(const QString &directory, int generation)
+{
+    for (int old : generations(directory, "journal", "log")) {
+        if (old < generation)
+            QFile::remove(journalPath(directory, old));
+    }
+    for (int old : generations(directory, "checkpoint", "manifest")) {
+        if (old < generation)
+            QFile::remove(checkpointPath(directory, old));
+    }
+}
+
+bool EditJournal::hasData(const QString &directory)
+{
+    if (!generations(directory, "checkpoint", "manifest").isEmpty())
+        return true;
+    for (int generation : generations(directory, "journal", "log")) {
+        if (QFileInfo(journalPath(directory, generation)).size() > FILE_HEADER_SIZE)
+            return true;
+    }
+    return false;
+}
+
+bool EditJournal::recover(const QString &directory, QString *text)
+{
+    const QList<int> checkpoints = generations(directory, "checkpoint", "manifest");
+    int base = 1;
+    QString result;
+    if (!checkpoints.isEmpty()) {
+        base = checkpoints.last();
+        QFile file(checkpointPath(directory, base));
+        if (!file.open(QIODevice::ReadOnly))
+            return false;
+        const QByteArray manifest = file.readAll();
+        if (manifest.size() < 12 || readInt(manifest.constData()) != CHECKPOINT_MAGIC
+            || readInt(manifest.constData() + 4) != CHECKPOINT_VERSION)
+            return false;
+        const quint32 count = readInt(manifest.constData() + 8);
+        if (manifest.size() != 12 + qsizetype(count) * ChunkStore::ID_SIZE)
+            return false;
+
+        QList<QByteArray> ids;
+        ids.reserve(count);
+        for (quint32 i = 0; i < count; ++i)
+            ids.append(manifest.mid(12 + qsizetype(i) * ChunkStore::ID_SIZE, ChunkStore::ID_SIZE));
+        QByteArray data;
+        if (!ChunkStore::load(chunkDirectory(directory), ids, &data))
+            return false;
+        result = QString::fromUtf8(data);
+    }
+
+    // A torn record can only be at the end of the newest journal; stop there
+    bool found = !checkpoints.isEmpty();
+    for (int generation : generations(directory, "journal", "log")) {
+        if (generation < base)
+            continue;
+        found = true;
+        if (!replayJournal(journalPath(directory, generation), &result))
+            break;
+    }
+
+    if (found)
+        *text = result;
+    return found;
+}
+
+bool EditJournal::replayJournal(const QString &filePath, QString *text)
+{
+    QFile file(filePath);
+    if (!file.open(QIODevice::ReadOnly))
+        return false;
+    const QByteArray data = file.readAll();
+    if (data.size() < FILE_HEADER_SIZE || readInt(data.constData()) != MAGIC
+        || readInt(data.constData() + 4) != VERSION)
+        return false;
+
+    qsizetype offset = FILE_HEADER_SIZE;
+    while (offset < data.size()) {
+        if (data.size() - offset < RECORD_HEADER_SIZE)
+            return false;
+        const quint32 payloadSize = readInt(data.constData() + offset);
+        const quint16 checksum = quint16(readInt(data.constData() + offset + 4) & 0xffff);
+        offset += RECORD_HEADER_SIZE;
+        if (payloadSize < quint32(PAYLOAD_FIXED_SIZE) || data.size() - offset < qsizetype(payloadSize))
+            return false;
+        const QByteArrayView payload(data.constData() + offset, payloadSize);
+        if (qChecksum(payload) != checksum)
+            return false;
+
+        const qint32 position = qint32(readInt(payload.data()));
+        const qint32 removed = qint32(readInt(payload.data() + 4));
+        const quint32 length = readInt(payload.data() + 8);
+        if (position < 0 || removed < 0 || position + qsizetype(removed) > text->size()
+            || PAYLOAD_FIXED_SIZE + qsizetype(length) * 2 != qsizetype(payloadSize))
+            return false;
+
+        QString inserted(qsizetype(length), Qt::Uninitialized);
+        const char *units = payload.data() + PAYLOAD_FIXED_SIZE;
+        if constexpr (Q_BYTE_ORDER == Q_LITTLE_ENDIAN) {
+            memcpy(inserted.data(), units, size_t(length) * sizeof(char16_t));
+        } else {
+            for (quint32 i = 0; i < length; ++i) {
+                quint16 unit;
+                memcpy(&unit, units + i * 2, sizeof(unit));
+                inserted[i] = QChar(qFromLittleEndian(unit));
+            }
+        }
+        text->replace(position, removed, inserted);
+        offset += payloadSize;
+    }
+    return true;
+}
+
+void EditJournal::discard(const QString &directory)
+{
+    QDir(directory).removeRecursively();
+}
+
+QString EditJournal::journalPath(const QString &directory, int generation)
+{
+    return QDir(directory).filePath(QString("journal-%1.log").arg(generation));
+}
+
+QString EditJournal::checkpointPath(const QString &directory, int generation)
+{
+    return QDir(directory).filePath(QString("checkpoint-%1.manifest").arg(generation));
+}
+
+QString EditJournal::chunkDirectory(const QString &directory)
+{
+    return QDir(directory).filePath("chunks");
+}
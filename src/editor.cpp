@@ -5,8 +5,19 @@
 #include "dialogs/finddialog.h"
 #include "dialogs/settingsdialog.h"
 #include "syntax/syntaxhighlighter.h"
+#include "syntax/blockdata.h"
+#include "minimap.h"
+#include "profiler.h"
+#include "autosaveservice.h"
+#include "savescheduler.h"
+#include "settingsstore.h"
+#include "search/findallengine.h"
+#include "search/literalsearch.h"
+#include "search/regexsearch.h"
+#include "search/replaceengine.h"
 #include <QTextBlock>
 #include <QPainter>
+#include <QtMath>
 #include <QTextCursor>
 #include <QStack>
 #include <QDebug>
@@ -23,14 +34,13 @@
 #include <QResizeEvent>
 #include <QFileInfo>
 #include <QRegularExpression>
-#include <QSettings>
 #include <QtWidgets>
 #include <QtGui>
 #include <QtCore>
 
 TextEditCommand::TextEditCommand(CodeEditor* editor, const QString& oldText, const QString& newText,
                                int position, int charsRemoved, int charsAdded)
-    : editor(editor), oldText(oldText), newText(newText),
+    : editor(editor), applied(true), oldText(oldText), newText(newText),
       position(position), charsRemoved(charsRemoved), charsAdded(charsAdded)
 {
 }
@@ -45,6 +55,12 @@ void TextEditCommand::undo()
 
 void TextEditCommand::redo()
 {
+    // QUndoStack::push() calls redo(); the edit is already in the document
+    if (applied) {
+        applied = false;
+        return;
+    }
+
     QTextCursor cursor = editor->textCursor();
     cursor.setPosition(position);
     cursor.movePosition(QTextCursor::NextCharacter, QTextCursor::KeepAnchor, charsRemoved);
@@ -52,14 +68,23 @@ void TextEditCommand::redo()
 }
 
 CodeEditor::CodeEditor(QWidget *parent)
-    : QPlainTextEdit(parent), m_isUndoRedoOperation(false),
-      isColumnSelectionMode(false), splitViewContainer(nullptr)
+    : QPlainTextEdit(parent), gutterCurrentBlock(-1), editRevision(0), m_isUndoRedoOperation(false),
+      foldCacheGeneration(0),
+      isColumnSelectionMode(false), splitViewContainer(nullptr),
+      lastCaseSensitive(false), lastWholeWords(false), lastRegularExpression(false),
+      searchResultsStale(false),
+      incrementalAnchor(-1), incrementalBackwards(false), incrementalWrap(true)
 {
     lineNumberArea = new LineNumberArea(this);
     highlighter = new SyntaxHighlighter(document());
+    minimap = new Minimap(this, static_cast<SyntaxHighlighter *>(highlighter));
     m_undoStack = new QUndoStack(this);
     settingsDialog = nullptr;
-    autoSaveTimer = new QTimer(this);
+    saveScheduler = nullptr;
+    findAllEngine = new FindAllEngine(this);
+    searchRefreshTimer = new QTimer(this);
+    searchRefreshTimer->setSingleShot(true);
+    searchRefreshTimer->setInterval(250);
 
     connect(this, &CodeEditor::blockCountChanged,
             this, &CodeEditor::updateLineNumberAreaWidth);
@@ -71,14 +96,29 @@ CodeEditor::CodeEditor(QWidget *parent)
     // Connect text change signals for undo/redo
     connect(document(), &QTextDocument::contentsChange,
             this, &CodeEditor::handleTextChanged);
+
+    // Find-all results feed the match overlay and the "k of N" counter
+    connect(findAllEngine, &FindAllEngine::matchesChanged, this, [this]() {
+        selectIncrementalMatch(false);
+        viewport()->update();
+        reportSearchPosition();
+    });
+    connect(findAllEngine, &FindAllEngine::finished, this, [this]() {
+        searchResultsStale = false;
+        selectIncrementalMatch(true);
+        updateMinimapMarks();
+        viewport()->update();
+        reportSearchPosition();
+    });
+    connect(searchRefreshTimer, &QTimer::timeout, this, &CodeEditor::refreshSearchResults);
     
     foldingMarginWidth = 20;
     isFoldingEnabled = true;
+    analysisDeferred = false;
     foldingMarkerColor = QColor(Qt::darkGray);
     
     setupEditor();
     setupUndoRedo();
-    setupAutoSave();
     setupFolding();
     setupMultipleCursors();
     setupSplitView();
@@ -96,23 +136,33 @@ CodeEditor::~CodeEditor()
 
 void CodeEditor::paintEvent(QPaintEvent *event)
 {
-    QPainter painter(viewport());
-    
-    // Paint the base text editor
+    PROFILE_SCOPE(EditorPaint);
+
+    // The base class opens its own painter on the viewport, so ours comes after it
     QPlainTextEdit::paintEvent(event);
-    
-    // Paint folding markers
+
+    const QRect exposed = event->rect();
+    QPainter painter(viewport());
+    painter.setClipRect(exposed);
+    gutter.setFoldMarkerStyle(foldingMarkerColor, viewport()->devicePixelRatioF());
+    const int markerLeft = lineNumberAreaWidth();
+
+    // Paint column selection and folding markers
     QTextBlock block = firstVisibleBlock();
     int blockNumber = block.blockNumber();
     int top = qRound(blockBoundingGeometry(block).translated(contentOffset()).top());
     int bottom = top + qRound(blockBoundingRect(block).height());
     
-    while (block.isValid() && top <= event->rect().bottom()) {
-        if (block.isVisible() && bottom >= event->rect().top()) {
+    while (block.isValid() && top <= exposed.bottom()) {
+        if (block.isVisible() && bottom >= exposed.top()) {
+            if (columnSelection.containsBlock(blockNumber)) {
+                paintColumnSelection(&painter, block, top, bottom);
+            }
             if (isFoldableBlock(block)) {
-                bool isCollapsed = foldedRegions.contains(blockNumber);
-                QRect rect = getFoldingMarkerRect(block);
-                drawFoldingMarker(&painter, rect, isCollapsed);
+                auto region = foldedRegions.constFind(blockNumber);
+                const bool isCollapsed = region != foldedRegions.constEnd() && region->isCollapsed;
+                drawFoldingMarker(&painter, QRect(markerLeft, top, foldingMarginWidth, bottom - top),
+                                  isCollapsed);
             }
         }
         
@@ -122,8 +172,11 @@ void CodeEditor::paintEvent(QPaintEvent *event)
         ++blockNumber;
     }
     
+    // Paint find-all matches
+    paintSearchMatches(&painter, exposed);
+
     // Paint multiple cursors
-    paintCursors(&painter);
+    paintCursors(&painter, exposed);
 }
 
 void CodeEditor::mousePressEvent(QMouseEvent *event)
@@ -141,8 +194,13 @@ void CodeEditor::mousePressEvent(QMouseEvent *event)
         }
         
         if (event->modifiers() & Qt::AltModifier) {
-            startColumnSelection();
+            clearAdditionalCursors();
+            isColumnSelectionMode = true;
             columnSelectionOrigin = event->pos();
+            updateColumnSelectionMetrics();
+            columnSelection.begin(cursorForPosition(event->pos()).block(),
+                                  event->pos().x() - contentOffset().x());
+            viewport()->update();
         } else if (event->modifiers() & Qt::ControlModifier) {
             addCursorAtMousePosition(event->pos());
         } else {
@@ -168,15 +226,18 @@ int CodeEditor::lineNumberAreaWidth() const
 }
 
 bool CodeEditor::findNext(const QString &searchText, bool caseSensitive,
-                         bool wholeWords, bool wrapAround)
+                         bool wholeWords, bool regularExpression, bool wrapAround)
 {
-    QTextDocument::FindFlags flags = getSearchFlags(caseSensitive, wholeWords, false);
-    QTextCursor cursor = textCursor();
-    QTextCursor found = document()->find(searchText, cursor, flags);
+    if (regularExpression) {
+        deferRegexStep(searchText, caseSensitive, wholeWords, textCursor().selectionEnd(), false, wrapAround);
+        return true;
+    }
+
+    QTextCursor found = findMatch(searchText, textCursor().selectionEnd(),
+                                  caseSensitive, wholeWords, regularExpression, false);
 
     if (found.isNull() && wrapAround) {
-        cursor.movePosition(QTextCursor::Start);
-        found = document()->find(searchText, cursor, flags);
+        found = findMatch(searchText, 0, caseSensitive, wholeWords, regularExpression, false);
     }
 
     if (!found.isNull()) {
@@ -188,15 +249,19 @@ bool CodeEditor::findNext(const QString &searchText, bool caseSensitive,
 }
 
 bool CodeEditor::findPrevious(const QString &searchText, bool caseSensitive,
-                            bool wholeWords, bool wrapAround)
+                            bool wholeWords, bool regularExpression, bool wrapAround)
 {
-    QTextDocument::FindFlags flags = getSearchFlags(caseSensitive, wholeWords, true);
-    QTextCursor cursor = textCursor();
-    QTextCursor found = document()->find(searchText, cursor, flags);
+    if (regularExpression) {
+        deferRegexStep(searchText, caseSensitive, wholeWords, textCursor().selectionStart(), true, wrapAround);
+        return true;
+    }
+
+    QTextCursor found = findMatch(searchText, textCursor().selectionStart(),
+                                  caseSensitive, wholeWords, regularExpression, true);
 
     if (found.isNull() && wrapAround) {
-        cursor.movePosition(QTextCursor::End);
-        found = document()->find(searchText, cursor, flags);
+        found = findMatch(searchText, documentSnapshot().size(), caseSensitive, wholeWords,
+                          regularExpression, true);
     }
 
     if (!found.isNull()) {
@@ -207,6 +272,120 @@ bool CodeEditor::findPrevious(const QString &searchText, bool caseSensitive,
     return false;
 }
 
+QTextCursor CodeEditor::findMatch(const QString &text, int from, bool caseSensitive,
+                                  bool wholeWords, bool regularExpression, bool backwards) const
+{
+    const QString &snapshot = documentSnapshot();
+    const Qt::CaseSensitivity cs = getCaseSensitivity(caseSensitive);
+    if (text.isEmpty())
+        return QTextCursor();
+
+    SearchOptions options;
+    options.caseSensitive = caseSensitive;
+    options.wholeWords = wholeWords;
+    options.regularExpression = regularExpression;
+
+    qsizetype index = -1;
+    qsizetype length = text.size();
+    if (hasSearchResults(text, options)) {
+        // Find-all already knows every match, so stepping is a lookup
+        const QVector<SearchMatch> &matches = findAllEngine->matches();
+        const int i = findAllEngine->firstMatchFrom(from) - (backwards ? 1 : 0);
+        if (i >= 0 && i < matches.size()) {
+            index = matches.at(i).position;
+            length = matches.at(i).length;
+        }
+    } else if (regularExpression) {
+        // Only find-all matches a regex; see deferRegexStep()
+        return QTextCursor();
+    } else if (backwards) {
+        // Matches must start before 'from'
+        index = from - 1;
+        while (index >= 0) {
+            index = LiteralSearch::lastIndexOf(snapshot, text, index, cs);
+            if (index < 0 || !wholeWords || LiteralSearch::isWholeWordAt(snapshot, index, text.size()))
+                break;
+            --index;
+        }
+    } else {
+        index = from;
+        while ((index = LiteralSearch::indexOf(snapshot, text, index, cs)) >= 0) {
+            if (!wholeWords || LiteralSearch::isWholeWordAt(snapshot, index, text.size()))
+                break;
+            ++index;
+        }
+    }
+
+    if (index < 0)
+        return QTextCursor();
+
+    QTextCursor found(document());
+    found.setPosition(int(index));
+    found.setPosition(int(index + length), QTextCursor::KeepAnchor);
+    return found;
+}
+
+bool CodeEditor::hasSearchResults(const QString &text, const SearchOptions &options) const
+{
+    return findAllEngine->isComplete() && !searchResultsStale
+        && findAllEngine->pattern() == text && findAllEngine->options() == options;
+}
+
+// A regex can backtrack for as long as it likes, so steps never match on the
+// GUI thread: the match is picked from find-all's results, whose worker is
+// canceled by the next query or edit
+void CodeEditor::deferRegexStep(const QString &text, bool caseSensitive, bool wholeWords,
+                                int from, bool backwards, bool wrapAround)
+{
+    SearchOptions options;
+    options.caseSensitive = caseSensitive;
+    options.wholeWords = wholeWords;
+    options.regularExpression = true;
+
+    incrementalAnchor = from;
+    incrementalBackwards = backwards;
+    incrementalWrap = wrapAround;
+    if (hasSearchResults(text, options)) {
+        selectIncrementalMatch(true);
+        return;
+    }
+    if (findAllEngine->isRunning() && findAllEngine->pattern() == text && findAllEngine->options() == options)
+        return;
+
+    searchRefreshTimer->stop();
+    searchResultsStale = true;
+    findAllEngine->start(documentSnapshot(), text, options);
+}
+
+bool CodeEditor::checkSearchPattern(const QString &text, bool regularExpression)
+{
+    if (!regularExpression || text.isEmpty())
+        return true;
+
+    const QRegularExpression expression = RegexSearch::compile(text, true, false);
+    if (expression.isValid())
+        return true;
+
+    clearSearchHighlights();
+    emit searchPatternError(tr("Invalid regular expression: %1").arg(expression.errorString()));
+    return false;
+}
+
+QString CodeEditor::documentText(int position, int length) const
+{
+    QTextCursor cursor(document());
+    cursor.setPosition(qBound(0, position, document()->characterCount() - 1));
+    cursor.setPosition(qBound(0, position + length, document()->characterCount() - 1),
+                       QTextCursor::KeepAnchor);
+
+    // Same separators toPlainText() produces
+    QString text = cursor.selectedText();
+    text.replace(QChar::ParagraphSeparator, QLatin1Char('\n'));
+    text.replace(QChar::LineSeparator, QLatin1Char('\n'));
+    text.replace(QChar::Nbsp, QLatin1Char(' '));
+    return text;
+}
+
 QTextBlock CodeEditor::blockAtPosition(const QPoint &pos) const
 {
     QTextCursor cursor = cursorForPosition(pos);
@@ -278,40 +457,23 @@ void CodeEditor::showReplaceDialog()
 
 void CodeEditor::lineNumberAreaPaintEvent(QPaintEvent *event)
 {
+    PROFILE_SCOPE(GutterPaint);
     QPainter painter(lineNumberArea);
     painter.fillRect(event->rect(), lineNumberBackgroundColor);
+    gutter.setStyle(font(), lineNumberForegroundColor, lineNumberArea->devicePixelRatioF());
 
     QTextBlock block = firstVisibleBlock();
     int blockNumber = block.blockNumber();
     int top = qRound(blockBoundingGeometry(block).translated(contentOffset()).top());
     int bottom = top + qRound(blockBoundingRect(block).height());
-    int currentLine = textCursor().blockNumber();
+    const int currentLine = textCursor().blockNumber();
+    const int numberRight = lineNumberArea->width() - 10;
 
     while (block.isValid() && top <= event->rect().bottom()) {
         if (block.isVisible() && bottom >= event->rect().top()) {
-            QString number = QString::number(blockNumber + 1);
-            painter.setPen(lineNumberForegroundColor);
-            painter.drawText(0, top, lineNumberArea->width() - 10, fontMetrics().height(),
-                           Qt::AlignRight, number);
-            
-            // Draw blue glow dot for current line
-            if (blockNumber == currentLine) {
-                int dotSize = 6;
-                int dotX = lineNumberArea->width() - dotSize - 2;
-                int dotY = top + (fontMetrics().height() - dotSize) / 2;
-                
-                // Draw glow effect
-                painter.setPen(Qt::NoPen);
-                QRadialGradient gradient(dotX + dotSize/2, dotY + dotSize/2, dotSize * 1.5);
-                gradient.setColorAt(0, QColor(0, 120, 255, 120));
-                gradient.setColorAt(1, QColor(0, 120, 255, 0));
-                painter.setBrush(gradient);
-                painter.drawEllipse(dotX - dotSize/2, dotY - dotSize/2, dotSize * 2, dotSize * 2);
-                
-                // Draw dot
-                painter.setBrush(QColor(0, 120, 255));
-                painter.drawEllipse(dotX, dotY, dotSize, dotSize);
-            }
+            gutter.drawNumber(&painter, blockNumber + 1, numberRight, top);
+            if (blockNumber == currentLine)
+                gutter.drawCurrentLineMarker(&painter, lineNumberArea->width(), top);
         }
 
         block = block.next();
@@ -319,11 +481,12 @@ void CodeEditor::lineNumberAreaPaintEvent(QPaintEvent *event)
         bottom = top + qRound(blockBoundingRect(block).height());
         ++blockNumber;
     }
+    gutterCurrentBlock = currentLine;
 }
 
 void CodeEditor::updateLineNumberAreaWidth(int newBlockCount)
 {
-    setViewportMargins(lineNumberAreaWidth() + foldingMarginWidth, 0, 0, 0);
+    updateViewportMargins();
 }
 
 void CodeEditor::updateLineNumberArea(const QRect &rect, int dy)
@@ -340,26 +503,70 @@ void CodeEditor::updateLineNumberArea(const QRect &rect, int dy)
 void CodeEditor::highlightCurrentLine()
 {
     // Remove the yellow highlight since we're using the blue dot
-    QList<QTextEdit::ExtraSelection> extraSelections;
-    setExtraSelections(extraSelections);
-    
-    // Update the line number area to show the blue dot
-    lineNumberArea->update();
+    if (!extraSelections().isEmpty())
+        setExtraSelections(QList<QTextEdit::ExtraSelection>());
+
+    // Only the rows losing and gaining the blue dot need repainting
+    const int currentLine = textCursor().blockNumber();
+    if (currentLine == gutterCurrentBlock)
+        return;
+    updateGutterRow(gutterCurrentBlock);
+    updateGutterRow(currentLine);
+    gutterCurrentBlock = currentLine;
+}
+
+void CodeEditor::updateGutterRow(int blockNumber)
+{
+    const QTextBlock block = document()->findBlockByNumber(blockNumber);
+    if (!block.isValid() || !block.isVisible())
+        return;
+    const QRectF row = blockBoundingGeometry(block).translated(contentOffset());
+    if (row.bottom() < 0 || row.top() > lineNumberArea->height())
+        return;
+    lineNumberArea->update(0, qFloor(row.top()), lineNumberArea->width(), qCeil(row.height()) + 1);
 }
 
 void CodeEditor::handleTextChanged(int position, int charsRemoved, int charsAdded)
 {
+    PROFILE_SCOPE(EditorTextChange);
+    const QString newText = documentText(position, charsAdded);
+
+    // Highlighter passes report their blocks as changed without touching text
+    if (charsRemoved == charsAdded && QStringView(m_lastText).mid(position, charsRemoved) == newText)
+        return;
+
     // Only handle undo/redo operations
     if (!m_isUndoRedoOperation) {
         QString oldText = m_lastText.mid(position, charsRemoved);
-        QString newText = document()->toPlainText().mid(position, charsAdded);
         
         // Avoid creating undo commands for single character inputs (handled by keyPressEvent)
         if (charsAdded > 1 || charsRemoved > 0) {
             m_undoStack->push(new TextEditCommand(this, oldText, newText, position, charsRemoved, charsAdded));
         }
     }
-    m_lastText = document()->toPlainText();
+
+    // Patch the snapshot in place; Qt over-reports the range when the whole
+    // document is replaced, so fall back to a full copy if the sizes disagree
+    ++editRevision;
+    if (saveScheduler && autoSaveEnabled)
+        saveScheduler->markDirty(this);
+    m_lastText.replace(position, charsRemoved, newText);
+    if (m_lastText.size() != document()->characterCount() - 1) {
+        m_lastText = document()->toPlainText();
+        emit documentReset(m_lastText);
+    } else {
+        emit textEdited(position, charsRemoved, newText);
+    }
+    columnSelection.invalidate();
+    invalidateFoldCache(position, charsAdded);
+
+    // Match positions are stale now; recount once typing settles
+    if (!findAllEngine->pattern().isEmpty()) {
+        searchResultsStale = true;
+        incrementalAnchor = -1;
+        findAllEngine->cancel();
+        searchRefreshTimer->start();
+    }
 }
 
 void CodeEditor::setupEditor()
@@ -369,15 +576,58 @@ void CodeEditor::setupEditor()
     setMouseTracking(true);
 }
 
+// Swaps in another document's text. That isn't an edit, so it leaves no
+// undo step behind, and fold regions of the old text are dropped.
+void CodeEditor::setDocumentText(const QString &text)
+{
+    m_isUndoRedoOperation = true;
+    setPlainText(text);
+    m_isUndoRedoOperation = false;
+    m_undoStack->clear();
+    foldedRegions.clear();
+    if (!analysisDeferred)
+        updateFoldingRegions();
+}
+
+void CodeEditor::setAnalysisDeferred(bool deferred)
+{
+    if (deferred == analysisDeferred)
+        return;
+    analysisDeferred = deferred;
+    // A detached highlighter costs nothing as text goes in
+    highlighter->setDocument(deferred ? nullptr : document());
+    if (!deferred) {
+        highlighter->rehighlight();
+        const QList<int> folds = deferredFolds;
+        deferredFolds.clear();
+        restoreFolds(folds);
+    }
+}
+
 void CodeEditor::setupUndoRedo()
 {
     m_undoStack->setUndoLimit(1000);
 }
 
-void CodeEditor::setupAutoSave()
+void CodeEditor::setSaveScheduler(SaveScheduler *scheduler)
 {
-    connect(autoSaveTimer, &QTimer::timeout, this, &CodeEditor::checkAutoSave);
-    autoSaveTimer->start(autoSaveInterval * 1000);
+    saveScheduler = scheduler;
+    scheduler->addClient(this, autoSaveInterval * 60000, [this]() { checkAutoSave(); });
+
+    // A finished write only clears the modified flag if nothing was typed meanwhile
+    connect(scheduler->service(), &AutoSaveService::saved, this, [this](const QString &path, quint64 revision) {
+        if (path == currentFilePath && revision == editRevision)
+            document()->setModified(false);
+    });
+}
+
+void CodeEditor::loadAutoSaveSettings()
+{
+    const SettingsStore &store = SettingsStore::instance();
+    autoSaveEnabled = store.boolValue(SettingsStore::AutoSaveEnabled);
+    autoSaveInterval = qMax(1, store.intValue(SettingsStore::AutoSaveInterval));
+    if (saveScheduler)
+        saveScheduler->setMaxLatency(this, autoSaveInterval * 60000);
 }
 
 void CodeEditor::setupFolding()
@@ -469,7 +719,11 @@ void CodeEditor::addCursorToWordOccurrences()
 void CodeEditor::startColumnSelection()
 {
     isColumnSelectionMode = true;
-    columnSelectionOrigin = mapFromGlobal(QCursor::pos());
+    columnSelectionOrigin = viewport()->mapFromGlobal(QCursor::pos());
+    updateColumnSelectionMetrics();
+    columnSelection.begin(cursorForPosition(columnSelectionOrigin).block(),
+                          columnSelectionOrigin.x() - contentOffset().x());
+    viewport()->update();
 }
 
 void CodeEditor::clearAdditionalCursors()
@@ -477,7 +731,8 @@ void CodeEditor::clearAdditionalCursors()
     cursors.clear();
     selections.clear();
     isColumnSelectionMode = false;
-    update();
+    columnSelection.clear();
+    viewport()->update();
 }
 
 void CodeEditor::addCursorAtMousePosition(const QPoint &pos)
@@ -495,15 +750,16 @@ void CodeEditor::updateCursors()
 void CodeEditor::handleSelectionChanged()
 {
     if (isColumnSelectionMode) {
-        updateColumnSelection(mapFromGlobal(QCursor::pos()));
+        updateColumnSelection(viewport()->mapFromGlobal(QCursor::pos()));
     }
 }
 
-void CodeEditor::paintCursors(QPainter *painter)
+void CodeEditor::paintCursors(QPainter *painter, const QRect &exposed)
 {
     for (const Cursor &cursor : cursors) {
         QRect rect = cursorRect(cursor.cursor);
-        painter->fillRect(rect, Qt::black);
+        if (rect.intersects(exposed))
+            painter->fillRect(rect, Qt::black);
     }
 }
 
@@ -533,8 +789,13 @@ QTextCursor CodeEditor::shrinkSelectionToBoundary(const QTextCursor& cursor)
 
 void CodeEditor::addCursorAtWordOccurrence(const QString &word)
 {
-    QTextCursor cursor = document()->find(word);
-    while (!cursor.isNull()) {
+    const QString &snapshot = documentSnapshot();
+    qsizetype index = 0;
+    while ((index = LiteralSearch::indexOf(snapshot, word, index, Qt::CaseInsensitive)) >= 0) {
+        QTextCursor cursor(document());
+        cursor.setPosition(int(index));
+        cursor.setPosition(int(index + word.size()), QTextCursor::KeepAnchor);
+
         bool overlap = false;
         for (const Cursor &existing : cursors) {
             if (areCursorsOverlapping(cursor, existing.cursor)) {
@@ -547,7 +808,7 @@ void CodeEditor::addCursorAtWordOccurrence(const QString &word)
             cursors.append({cursor, false, false});
         }
         
-        cursor = document()->find(word, cursor);
+        index += word.size();
     }
     updateCursors();
 }
@@ -564,33 +825,204 @@ bool CodeEditor::areCursorsOverlapping(const QTextCursor &c1, const QTextCursor
 
 void CodeEditor::updateColumnSelection(const QPoint &pos)
 {
-    int startBlock = cursorForPosition(columnSelectionOrigin).blockNumber();
-    int endBlock = cursorForPosition(pos).blockNumber();
-    int startColumn = columnSelectionOrigin.x();
-    int endColumn = pos.x();
-    
-    cursors.clear();
-    
-    int minBlock = qMin(startBlock, endBlock);
-    int maxBlock = qMax(startBlock, endBlock);
-    
-    for (int block = minBlock; block <= maxBlock; ++block) {
-        cursors.append({createCursorForColumn(block, startColumn), false, true});
-        QTextCursor &cursor = cursors.last().cursor;
-        cursor.movePosition(QTextCursor::Right, QTextCursor::KeepAnchor,
-                          (endColumn - startColumn) / fontMetrics().horizontalAdvance(' '));
+    QTextBlock block = cursorForPosition(pos).block();
+    int oldFirst = columnSelection.firstBlock();
+    int oldLast = columnSelection.lastBlock();
+
+    columnSelection.extendTo(block, pos.x() - contentOffset().x());
+
+    // Repaint only the rows whose span can have changed
+    QTextBlock first = document()->findBlockByNumber(qMin(oldFirst, columnSelection.firstBlock()));
+    QTextBlock last = document()->findBlockByNumber(qMax(oldLast, columnSelection.lastBlock()));
+    QRectF top = blockBoundingGeometry(first).translated(contentOffset());
+    QRectF bottom = blockBoundingGeometry(last).translated(contentOffset());
+    QRect dirty = QRect(0, qFloor(top.top()), viewport()->width(),
+                        qCeil(bottom.bottom() - top.top()) + 1) & viewport()->rect();
+    if (!dirty.isEmpty()) {
+        viewport()->update(dirty);
     }
-    
-    update();
 }
 
-QTextCursor CodeEditor::createCursorForColumn(int blockNumber, int column)
+void CodeEditor::updateColumnSelectionMetrics()
+{
+    columnSelection.setMetrics(font(), tabStopDistance(), document()->documentMargin());
+}
+
+void CodeEditor::paintColumnSelection(QPainter *painter, const QTextBlock &block, int top, int bottom)
+{
+    const ColumnSpan span = columnSelection.span(block);
+    const qreal offset = contentOffset().x();
+    const qreal left = columnSelection.xForPosition(block, span.startPosition, span.startVirtual) + offset;
+    const qreal right = columnSelection.xForPosition(block, span.endPosition, span.endVirtual) + offset;
+
+    if (right > left) {
+        QColor color = palette().highlight().color();
+        color.setAlpha(90);
+        painter->fillRect(QRectF(left, top, right - left, bottom - top), color);
+    }
+
+    const qreal caret = columnSelection.caretX() >= columnSelection.rightX() ? right : left;
+    painter->fillRect(QRectF(caret, top, 1, bottom - top), palette().text().color());
+}
+
+bool CodeEditor::handleColumnSelectionKeyPress(QKeyEvent *event)
 {
-    QTextBlock block = document()->findBlockByNumber(blockNumber);
-    QTextCursor cursor(block);
-    int spaces = column / fontMetrics().horizontalAdvance(' ');
-    cursor.movePosition(QTextCursor::Right, QTextCursor::MoveAnchor, spaces);
-    return cursor;
+    if (event->key() == Qt::Key_Escape) {
+        clearAdditionalCursors();
+        return true;
+    }
+    if (event->matches(QKeySequence::Copy)) {
+        QApplication::clipboard()->setText(columnSelectionText());
+        return true;
+    }
+    if (event->matches(QKeySequence::Cut)) {
+        QApplication::clipboard()->setText(columnSelectionText());
+        insertTextAtColumnSelection(QString());
+        return true;
+    }
+    if (event->matches(QKeySequence::Paste)) {
+        return false;
+    }
+
+    switch (event->key()) {
+    case Qt::Key_Shift:
+    case Qt::Key_Control:
+    case Qt::Key_Alt:
+    case Qt::Key_Meta:
+        return true;
+    case Qt::Key_Backspace:
+        deleteAtColumnSelection(true);
+        return true;
+    case Qt::Key_Delete:
+        deleteAtColumnSelection(false);
+        return true;
+    case Qt::Key_Tab:
+        insertTextAtColumnSelection(QString(tabSize, QLatin1Char(' ')));
+        return true;
+    case Qt::Key_Left:
+    case Qt::Key_Right: {
+        // One character at a time, tabs included, then one column at a time past the end
+        QTextBlock head = document()->findBlockByNumber(columnSelection.headBlockNumber());
+        columnSelection.moveCaretTo(columnSelection.stepX(head, columnSelection.caretX(),
+                                                          event->key() == Qt::Key_Left ? -1 : 1));
+        viewport()->update();
+        return true;
+    }
+    default:
+        break;
+    }
+
+    if (!event->text().isEmpty() && !(event->modifiers() & Qt::ControlModifier)
+        && event->text().at(0).isPrint()) {
+        insertTextAtColumnSelection(event->text());
+        return true;
+    }
+
+    clearAdditionalCursors();
+    return false;
+}
+
+void CodeEditor::insertTextAtColumnSelection(const QString &text)
+{
+    const QStringList lines = text.split(QLatin1Char('\n'));
+    const bool distribute = lines.size() > 1 && lines.size() == columnSelection.rowCount();
+    const int first = columnSelection.firstBlock();
+    const int headBlock = columnSelection.headBlockNumber();
+    int caretOffset = 0; // in the head row, after the edit
+    int caretVirtual = 0;
+
+    // Edit bottom-up so the positions of rows still to be edited stay valid
+    QTextCursor edit(document());
+    edit.beginEditBlock();
+    for (QTextBlock block = document()->findBlockByNumber(columnSelection.lastBlock());
+         block.isValid() && block.blockNumber() >= first; block = block.previous()) {
+        const ColumnSpan span = columnSelection.span(block);
+        const QString insert = distribute ? lines.at(block.blockNumber() - first) : text;
+
+        edit.setPosition(span.startPosition);
+        edit.setPosition(span.endPosition, QTextCursor::KeepAnchor);
+        if (insert.isEmpty()) {
+            edit.removeSelectedText();
+        } else {
+            edit.insertText(QString(span.startVirtual, QLatin1Char(' ')) + insert);
+        }
+        if (block.blockNumber() == headBlock) {
+            caretOffset = span.startPosition - block.position();
+            if (insert.isEmpty())
+                caretVirtual = span.startVirtual;
+            else
+                caretOffset += span.startVirtual + insert.size();
+        }
+    }
+    edit.endEditBlock();
+
+    // Laid out from the edited row, so tabs and proportional glyphs land on a column
+    const QTextBlock head = document()->findBlockByNumber(headBlock);
+    columnSelection.moveCaretTo(columnSelection.xForPosition(head, head.position() + caretOffset,
+                                                             caretVirtual));
+    viewport()->update();
+}
+
+void CodeEditor::deleteAtColumnSelection(bool isBackspace)
+{
+    if (!columnSelection.isEmpty()) {
+        insertTextAtColumnSelection(QString());
+        return;
+    }
+
+    const int first = columnSelection.firstBlock();
+    const int headBlock = columnSelection.headBlockNumber();
+    int caretOffset = 0; // in the head row, after the edit
+    int caretVirtual = 0;
+
+    QTextCursor edit(document());
+    edit.beginEditBlock();
+    for (QTextBlock block = document()->findBlockByNumber(columnSelection.lastBlock());
+         block.isValid() && block.blockNumber() >= first; block = block.previous()) {
+        const ColumnSpan span = columnSelection.span(block);
+        if (block.blockNumber() == headBlock) {
+            caretOffset = span.startPosition - block.position();
+            caretVirtual = span.startVirtual;
+            if (isBackspace) {
+                // Virtual space only moves the caret back a column
+                if (caretVirtual > 0)
+                    --caretVirtual;
+                else if (caretOffset > 0)
+                    caretOffset -= caretOffset > 1 && block.text().at(caretOffset - 1).isLowSurrogate() ? 2 : 1;
+            }
+        }
+        if (span.startVirtual > 0) {
+            continue;   // Nothing to delete in virtual space
+        }
+        edit.setPosition(span.startPosition);
+        if (isBackspace && span.startPosition > block.position()) {
+            edit.deletePreviousChar();
+        } else if (!isBackspace && span.startPosition < block.position() + block.length() - 1) {
+            edit.deleteChar();
+        }
+    }
+    edit.endEditBlock();
+
+    if (isBackspace) {
+        const QTextBlock head = document()->findBlockByNumber(headBlock);
+        columnSelection.moveCaretTo(columnSelection.xForPosition(head, head.position() + caretOffset,
+                                                                 caretVirtual));
+    }
+    viewport()->update();
+}
+
+QString CodeEditor::columnSelectionText() const
+{
+    QStringList rows;
+    rows.reserve(columnSelection.rowCount());
+    const int last = columnSelection.lastBlock();
+    for (QTextBlock block = document()->findBlockByNumber(columnSelection.firstBlock());
+         block.isValid() && block.blockNumber() <= last; block = block.next()) {
+        const ColumnSpan span = columnSelection.span(block);
+        rows.append(block.text().mid(span.startPosition - block.position(),
+                                     span.endPosition - span.startPosition));
+    }
+    return rows.join(QLatin1Char('\n'));
 }
 
 void CodeEditor::ensureVisibleCursors()
@@ -612,6 +1044,12 @@ QRect CodeEditor::cursorRect(const QTextCursor &cursor) const
 
 void CodeEditor::keyPressEvent(QKeyEvent *event)
 {
+    // Box selection takes every key it understands
+    if (columnSelection.isActive() && handleColumnSelectionKeyPress(event)) {
+        event->accept();
+        return;
+    }
+
     // Handle special keys first
     if (event->key() == Qt::Key_Tab || event->key() == Qt::Key_Backtab) {
         if (event->modifiers() & Qt::ShiftModifier) {
@@ -755,121 +1193,325 @@ void CodeEditor::resizeEvent(QResizeEvent *event)
 
 void CodeEditor::insertFromMimeData(const QMimeData *source)
 {
-    if (source->hasText()) {
+    if (source->hasText() && columnSelection.isActive()) {
+        insertTextAtColumnSelection(source->text());
+    } else if (source->hasText()) {
         insertTextAtAllCursors(source->text());
     } else {
         QPlainTextEdit::insertFromMimeData(source);
     }
 }
 
-void CodeEditor::find(const QString &text, bool caseSensitive, bool wholeWords,
-                     bool searchBackwards, bool wrapAround)
+bool CodeEditor::find(const QString &text, bool caseSensitive, bool wholeWords,
+                     bool searchBackwards, bool wrapAround, bool regularExpression)
 {
+    if (!checkSearchPattern(text, regularExpression))
+        return false;
+
+    bool found;
     if (searchBackwards) {
-        findPrevious(text, caseSensitive, wholeWords, wrapAround);
+        found = findPrevious(text, caseSensitive, wholeWords, regularExpression, wrapAround);
     } else {
-        findNext(text, caseSensitive, wholeWords, wrapAround);
+        found = findNext(text, caseSensitive, wholeWords, regularExpression, wrapAround);
     }
     lastSearchText = text;
     lastCaseSensitive = caseSensitive;
     lastWholeWords = wholeWords;
+    lastRegularExpression = regularExpression;
+    updateSearchHighlights();
+    return found;
+}
+
+void CodeEditor::clearSearchHighlights()
+{
+    searchRefreshTimer->stop();
+    incrementalAnchor = -1;
+    findAllEngine->clear();
+    searchResultsStale = false;
+    updateMinimapMarks();
+    viewport()->update();
+    emit searchResultsChanged(0, 0);
+}
+
+void CodeEditor::updateSearchHighlights()
+{
+    SearchOptions options;
+    options.caseSensitive = lastCaseSensitive;
+    options.wholeWords = lastWholeWords;
+    options.regularExpression = lastRegularExpression;
+
+    if (lastSearchText.isEmpty()) {
+        clearSearchHighlights();
+        return;
+    }
+
+    // Same query over an unchanged document: only the position moved. Edits
+    // cancel the engine, so a run still going is over the current text
+    if ((!searchResultsStale || findAllEngine->isRunning()) && findAllEngine->pattern() == lastSearchText
+        && findAllEngine->options() == options) {
+        reportSearchPosition();
+        return;
+    }
+
+    searchRefreshTimer->stop();
+    searchResultsStale = true;
+    findAllEngine->start(documentSnapshot(), lastSearchText, options);
+}
+
+void CodeEditor::incrementalFind(const QString &text, bool caseSensitive, bool wholeWords,
+                                 bool regularExpression)
+{
+    lastSearchText = text;
+    lastCaseSensitive = caseSensitive;
+    lastWholeWords = wholeWords;
+    lastRegularExpression = regularExpression;
+
+    if (text.isEmpty()) {
+        clearSearchHighlights();
+        return;
+    }
+    if (!checkSearchPattern(text, regularExpression))
+        return;
+
+    SearchOptions options;
+    options.caseSensitive = caseSensitive;
+    options.wholeWords = wholeWords;
+    options.regularExpression = regularExpression;
+
+    // The first match at or after the current selection is picked once the
+    // engine reports it, so nothing here scans the document on the GUI thread
+    incrementalAnchor = textCursor().selectionStart();
+    incrementalBackwards = false;
+    incrementalWrap = true;
+    searchRefreshTimer->stop();
+    searchResultsStale = true;
+    if (!findAllEngine->refine(documentSnapshot(), text, options))
+        findAllEngine->start(documentSnapshot(), text, options);
+}
+
+void CodeEditor::selectIncrementalMatch(bool searchFinished)
+{
+    if (incrementalAnchor < 0)
+        return;
+
+    // Results arrive in document order, so wait until they reach the anchor;
+    // the last match before it is only known once the search is done
+    const QVector<SearchMatch> &matches = findAllEngine->matches();
+    int index = findAllEngine->firstMatchFrom(incrementalAnchor);
+    if (incrementalBackwards) {
+        if (!searchFinished)
+            return;
+        --index;
+        if (index < 0 && incrementalWrap)
+            index = int(matches.size()) - 1;
+    } else if (index >= matches.size()) {
+        if (!searchFinished)
+            return;
+        index = incrementalWrap ? 0 : -1;
+    }
+    incrementalAnchor = -1;
+    if (index < 0 || index >= matches.size())
+        return;
+
+    QTextCursor cursor(document());
+    cursor.setPosition(matches.at(index).position);
+    cursor.setPosition(matches.at(index).position + matches.at(index).length, QTextCursor::KeepAnchor);
+    setTextCursor(cursor);
+}
+
+void CodeEditor::refreshSearchResults()
+{
+    if (findAllEngine->pattern().isEmpty())
+        return;
+    findAllEngine->start(documentSnapshot(), findAllEngine->pattern(), findAllEngine->options());
+}
+
+void CodeEditor::reportSearchPosition()
+{
+    const int total = findAllEngine->matchCount();
+    int current = 0;
+    QTextCursor cursor = textCursor();
+    if (cursor.hasSelection() && !searchResultsStale) {
+        current = findAllEngine->indexOfMatchAt(cursor.selectionStart()) + 1;
+    }
+    emit searchResultsChanged(current, total);
+}
+
+void CodeEditor::paintSearchMatches(QPainter *painter, const QRect &rect)
+{
+    const QVector<SearchMatch> &matches = findAllEngine->matches();
+    if (matches.isEmpty() || searchResultsStale)
+        return;
+
+    QTextBlock firstBlock = firstVisibleBlock();
+    QTextBlock lastBlock = cursorForPosition(viewport()->rect().bottomRight()).block();
+    const int endPosition = lastBlock.position() + lastBlock.length();
+    const QColor color(255, 200, 0, 110);
+
+    QTextCursor probe(document());
+    for (int i = findAllEngine->firstMatchFrom(firstBlock.position());
+         i < matches.size() && matches.at(i).position < endPosition; ++i) {
+        const SearchMatch &match = matches.at(i);
+        probe.setPosition(match.position);
+        const QRect start = QPlainTextEdit::cursorRect(probe);
+        probe.setPosition(match.position + match.length);
+        const QRect end = QPlainTextEdit::cursorRect(probe);
+
+        if (start.top() == end.top()) {
+            QRect area(start.left(), start.top(), qMax(2, end.left() - start.left()), start.height());
+            if (area.intersects(rect)) {
+                painter->fillRect(area, color);
+            }
+        } else {
+            // Match wraps onto the next visual line
+            painter->fillRect(QRect(start.left(), start.top(), viewport()->width() - start.left(),
+                                    start.height()) & rect, color);
+            painter->fillRect(QRect(0, end.top(), end.left(), end.height()) & rect, color);
+        }
+    }
 }
 
 void CodeEditor::replace(const QString &searchText, const QString &replaceText,
-                        bool caseSensitive, bool wholeWords)
+                        bool caseSensitive, bool wholeWords, bool regularExpression)
 {
+    if (!checkSearchPattern(searchText, regularExpression))
+        return;
+
     QTextCursor cursor = textCursor();
-    if (cursor.hasSelection() && cursor.selectedText() == searchText) {
+    if (cursor.hasSelection() && regularExpression) {
+        // Only replace a selection the pattern matches exactly, so the
+        // capture groups refer to what the user is looking at
+        const QRegularExpressionMatch match = RegexSearch::matchAt(
+            RegexSearch::compile(searchText, caseSensitive, wholeWords),
+            documentSnapshot(), cursor.selectionStart());
+        if (match.hasMatch() && match.capturedEnd() == cursor.selectionEnd())
+            cursor.insertText(RegexSearch::expandReplacement(replaceText, match));
+    } else if (cursor.hasSelection()
+        && LiteralSearch::equals(cursor.selectedText(), searchText, getCaseSensitivity(caseSensitive))) {
         cursor.insertText(replaceText);
     }
-    findNext(searchText, caseSensitive, wholeWords, true);
+    findNext(searchText, caseSensitive, wholeWords, regularExpression, true);
 }
 
 void CodeEditor::replaceAll(const QString &searchText, const QString &replaceText,
-                          bool caseSensitive, bool wholeWords)
+                          bool caseSensitive, bool wholeWords, bool regularExpression)
 {
-    QTextCursor cursor = textCursor();
-    cursor.movePosition(QTextCursor::Start);
-    setTextCursor(cursor);
-    
-    QTextDocument::FindFlags flags = getSearchFlags(caseSensitive, wholeWords, false);
-    int count = 0;
-    
-    while (!cursor.isNull() && !cursor.atEnd()) {
-        cursor = document()->find(searchText, cursor, flags);
-        if (!cursor.isNull()) {
-            cursor.insertText(replaceText);
-            ++count;
-        }
+    if (!checkSearchPattern(searchText, regularExpression))
+        return;
+
+    QElapsedTimer timer;
+    timer.start();
+
+    SearchOptions options;
+    options.caseSensitive = caseSensitive;
+    options.wholeWords = wholeWords;
+    options.regularExpression = regularExpression;
+    const ReplaceEdit edit = ReplaceEngine::build(documentSnapshot(), searchText, replaceText, options);
+
+    // One insert means one contentsChange and one undo step, however many
+    // matches there were
+    if (edit.count > 0) {
+        QTextCursor cursor(document());
+        cursor.beginEditBlock();
+        cursor.setPosition(edit.start);
+        cursor.setPosition(edit.end, QTextCursor::KeepAnchor);
+        cursor.insertText(edit.text);
+        cursor.endEditBlock();
     }
+
+    emit replaceAllFinished(edit.count, timer.elapsed());
 }
 
 void CodeEditor::showFindDialog()
 {
     FindDialog *dialog = new FindDialog(this);
+    connect(this, &CodeEditor::searchResultsChanged, dialog, &FindDialog::setMatchCount);
+    connect(this, &CodeEditor::searchPatternError, dialog, &FindDialog::showMessage);
+    connect(this, &CodeEditor::replaceAllFinished, dialog, &FindDialog::showReplaceSummary);
+    connect(dialog, &FindDialog::searchTextEdited, this, [this, dialog]() {
+        incrementalFind(dialog->searchText(), dialog->caseSensitive(), dialog->wholeWords(),
+                        dialog->regularExpression());
+    });
     connect(dialog, &FindDialog::findNext, this, [this, dialog]() {
         find(dialog->searchText(), dialog->caseSensitive(),
-             dialog->wholeWords(), false, true);
+             dialog->wholeWords(), false, true, dialog->regularExpression());
     });
     connect(dialog, &FindDialog::findPrevious, this, [this, dialog]() {
         find(dialog->searchText(), dialog->caseSensitive(),
-             dialog->wholeWords(), true, true);
+             dialog->wholeWords(), true, true, dialog->regularExpression());
     });
     connect(dialog, &FindDialog::replaceRequested, this, [this, dialog]() {
         replace(dialog->searchText(), dialog->replaceText(),
-               dialog->caseSensitive(), dialog->wholeWords());
+               dialog->caseSensitive(), dialog->wholeWords(), dialog->regularExpression());
     });
     connect(dialog, &FindDialog::replaceAllRequested, this, [this, dialog]() {
         replaceAll(dialog->searchText(), dialog->replaceText(),
-                  dialog->caseSensitive(), dialog->wholeWords());
+                  dialog->caseSensitive(), dialog->wholeWords(), dialog->regularExpression());
     });
     dialog->show();
 }
 
 void CodeEditor::showSettingsDialog()
 {
-    if (!settingsDialog) {
+    if (!settingsDialog)
         settingsDialog = new SettingsDialog(this);
-    }
     settingsDialog->show();
 }
 
+// Settings come from the in-memory store, so new editors and splits never read the disk
 void CodeEditor::applySettings()
 {
-    QSettings settings;
-    
-    // Font settings
-    QString fontFamily = settings.value("editor/font/family", "Monospace").toString();
-    int fontSize = settings.value("editor/font/size", 12).toInt();
-    editorFont = QFont(fontFamily, fontSize);
-    setFont(editorFont);
-    
-    // Editor settings
-    tabSize = settings.value("editor/tabSize", 4).toInt();
-    autoIndent = settings.value("editor/autoIndent", true).toBool();
-    lineWrapping = settings.value("editor/lineWrapping", false).toBool();
-    setLineWrapMode(lineWrapping ? QPlainTextEdit::WidgetWidth : QPlainTextEdit::NoWrap);
-    
-    // Theme settings
-    themeName = settings.value("editor/theme", "light").toString();
-    editorBackgroundColor = settings.value("editor/colors/background", QColor(Qt::white)).value<QColor>();
-    editorForegroundColor = settings.value("editor/colors/foreground", QColor(Qt::black)).value<QColor>();
-    lineNumberBackgroundColor = settings.value("editor/colors/lineNumberBackground", QColor(Qt::lightGray)).value<QColor>();
-    lineNumberForegroundColor = settings.value("editor/colors/lineNumberForeground", QColor(Qt::black)).value<QColor>();
-    currentLineColor = settings.value("editor/colors/currentLine", QColor(Qt::yellow).lighter(160)).value<QColor>();
-    
-    // Auto-save settings
-    autoSaveEnabled = settings.value("editor/autoSave/enabled", true).toBool();
-    autoSaveInterval = settings.value("editor/autoSave/interval", 60).toInt();
-    
-    updateEditorColors();
-    updateEditorFont();
-    updateEditorSettings();
+    loadEditorSettings();
+    loadFontSettings(); // tab stops depend on both
+    loadColorSettings();
+    loadAutoSaveSettings();
 }
 
 void CodeEditor::loadSettings()
 {
     applySettings();
+
+    // Each group is reapplied only when one of its own keys changes
+    SettingsStore &store = SettingsStore::instance();
+    store.subscribe(this, {SettingsStore::FontFamily, SettingsStore::FontSize},
+                    [this]() { loadFontSettings(); });
+    store.subscribe(this, {SettingsStore::TabSize, SettingsStore::AutoIndent, SettingsStore::LineWrapping},
+                    [this]() { loadEditorSettings(); });
+    store.subscribe(this, {SettingsStore::Theme, SettingsStore::EditorBackground, SettingsStore::EditorForeground,
+                           SettingsStore::LineNumberBackground, SettingsStore::LineNumberForeground,
+                           SettingsStore::CurrentLine},
+                    [this]() { loadColorSettings(); });
+    store.subscribe(this, {SettingsStore::AutoSaveEnabled, SettingsStore::AutoSaveInterval},
+                    [this]() { loadAutoSaveSettings(); });
+}
+
+void CodeEditor::loadFontSettings()
+{
+    editorFont = SettingsStore::instance().font();
+    updateEditorFont();
+    updateEditorSettings();
+}
+
+void CodeEditor::loadEditorSettings()
+{
+    const SettingsStore &store = SettingsStore::instance();
+    tabSize = store.intValue(SettingsStore::TabSize);
+    autoIndent = store.boolValue(SettingsStore::AutoIndent);
+    lineWrapping = store.boolValue(SettingsStore::LineWrapping);
+    setLineWrapMode(lineWrapping ? QPlainTextEdit::WidgetWidth : QPlainTextEdit::NoWrap);
+    updateEditorSettings();
+}
+
+void CodeEditor::loadColorSettings()
+{
+    const SettingsStore &store = SettingsStore::instance();
+    themeName = store.stringValue(SettingsStore::Theme);
+    editorBackgroundColor = store.colorValue(SettingsStore::EditorBackground);
+    editorForegroundColor = store.colorValue(SettingsStore::EditorForeground);
+    lineNumberBackgroundColor = store.colorValue(SettingsStore::LineNumberBackground);
+    lineNumberForegroundColor = store.colorValue(SettingsStore::LineNumberForeground);
+    currentLineColor = store.colorValue(SettingsStore::CurrentLine);
+    updateEditorColors();
 }
 
 void CodeEditor::checkAutoSave()
@@ -909,6 +1551,34 @@ void CodeEditor::unfoldAll()
     }
 }
 
+// Block numbers of the collapsed regions, in document order
+QList<int> CodeEditor::collapsedFolds() const
+{
+    if (analysisDeferred)
+        return deferredFolds;
+    QList<int> blocks;
+    for (auto it = foldedRegions.constBegin(); it != foldedRegions.constEnd(); ++it) {
+        if (it->isCollapsed)
+            blocks.append(it.key());
+    }
+    std::sort(blocks.begin(), blocks.end());
+    return blocks;
+}
+
+void CodeEditor::restoreFolds(const QList<int> &blocks)
+{
+    if (analysisDeferred) {
+        deferredFolds = blocks;
+        return;
+    }
+    updateFoldingRegions();
+    for (int blockNumber : blocks) {
+        auto region = foldedRegions.constFind(blockNumber);
+        if (region != foldedRegions.constEnd() && !region->isCollapsed)
+            toggleFoldAt(document()->findBlockByNumber(blockNumber));
+    }
+}
+
 void CodeEditor::updateFoldingRegions()
 {
     QTextBlock block = document()->firstBlock();
@@ -945,6 +1615,7 @@ void CodeEditor::toggleFoldAt(const QTextBlock &block)
             b = b.next();
         }
         
+        updateMinimapMarks();
         updateViewportMargins();
         update();
     }
@@ -963,6 +1634,11 @@ void CodeEditor::setBlockVisible(const QTextBlock &block, bool visible)
     }
 }
 
+Qt::CaseSensitivity CodeEditor::getCaseSensitivity(bool caseSensitive) const
+{
+    return caseSensitive ? Qt::CaseSensitive : Qt::CaseInsensitive;
+}
+
 QTextDocument::FindFlags CodeEditor::getSearchFlags(bool caseSensitive, bool wholeWords,
                                                   bool searchBackwards) const
 {
@@ -983,6 +1659,9 @@ void CodeEditor::updateEditorColors()
     p.setColor(QPalette::Text, editorForegroundColor);
     setPalette(p);
     
+    gutter.invalidate();
+    lineNumberArea->update();
+    minimap->updateColors();
     highlightCurrentLine();
     update();
 }
@@ -991,22 +1670,23 @@ void CodeEditor::updateEditorFont()
 {
     setFont(editorFont);
     updateLineNumberAreaWidth(0);
+    updateColumnSelectionMetrics();
 }
 
 void CodeEditor::updateEditorSettings()
 {
+    // Fold indents count tabs as tabSize columns
+    ++foldCacheGeneration;
     setTabStopDistance(fontMetrics().horizontalAdvance(' ') * tabSize);
+    updateColumnSelectionMetrics();
 }
 
 void CodeEditor::saveFile()
 {
-    if (!currentFilePath.isEmpty()) {
-        QFile file(currentFilePath);
-        if (file.open(QIODevice::WriteOnly | QIODevice::Text)) {
-            QTextStream out(&file);
-            out << toPlainText();
-            document()->setModified(false);
-        }
+    // The snapshot shares the buffer of m_lastText, so taking it is free;
+    // encoding and the write run on the service's worker
+    if (saveScheduler && !currentFilePath.isEmpty()) {
+        saveScheduler->service()->save(currentFilePath, m_lastText, editRevision);
     }
 }
 
@@ -1019,8 +1699,13 @@ int CodeEditor::getFoldingIndentLevel(const QTextBlock &block) const
 {
     if (!block.isValid())
         return 0;
+
+    // Indents are cached on the block; edits reset the blocks they touch
+    BlockData *data = BlockData::of(block);
+    if (data && data->foldGeneration == foldCacheGeneration)
+        return data->foldIndent;
     
-    QString text = block.text();
+    const QString text = block.text();
     int indent = 0;
     for (QChar c : text) {
         if (c == ' ')
@@ -1030,30 +1715,33 @@ int CodeEditor::getFoldingIndentLevel(const QTextBlock &block) const
         else
             break;
     }
+
+    if (!data)
+        data = BlockData::ensure(block);
+    data->foldIndent = indent;
+    data->foldGeneration = foldCacheGeneration;
     return indent;
 }
 
-void CodeEditor::drawFoldingMarker(QPainter *painter, const QRect &rect, bool collapsed)
+void CodeEditor::invalidateFoldCache(int position, int length)
 {
-    painter->save();
-    painter->setPen(foldingMarkerColor);
-    
-    int size = 8;
-    int x = rect.center().x() - size/2;
-    int y = rect.center().y() - size/2;
-    
-    painter->drawRect(x, y, size, size);
-    painter->drawLine(x + 2, y + size/2, x + size - 2, y + size/2);
-    if (collapsed) {
-        painter->drawLine(x + size/2, y + 2, x + size/2, y + size - 2);
+    const QTextBlock last = document()->findBlock(position + length);
+    for (QTextBlock block = document()->findBlock(position); block.isValid(); block = block.next()) {
+        if (BlockData *data = BlockData::of(block))
+            data->foldGeneration = -1;
+        if (block == last)
+            break;
     }
-    
-    painter->restore();
+}
+
+void CodeEditor::drawFoldingMarker(QPainter *painter, const QRect &rect, bool collapsed)
+{
+    gutter.drawFoldMarker(painter, rect, collapsed);
 }
 
 QRect CodeEditor::getFoldingMarkerRect(const QTextBlock &block) const
 {
-    QRect rect = blockBoundingGeometry(block).toRect();
+    QRect rect = blockBoundingGeometry(block).translated(contentOffset()).toRect();
     rect.setLeft(lineNumberAreaWidth());
     rect.setWidth(foldingMarginWidth);
     return rect;
@@ -1068,7 +1756,12 @@ QString CodeEditor::createPlaceholderText(const QTextBlock &startBlock,
 void CodeEditor::updateViewportMargins()
 {
     int leftMargin = lineNumberArea->isVisible() ? lineNumberAreaWidth() + foldingMarginWidth : foldingMarginWidth;
-    setViewportMargins(leftMargin, 0, 0, 0);
+    int rightMargin = minimap->isVisibleTo(this) ? Minimap::MINIMAP_WIDTH : 0;
+    setViewportMargins(leftMargin, 0, rightMargin, 0);
+
+    // The minimap sits between the text and the vertical scroll bar
+    QRect vr = viewport()->geometry();
+    minimap->setGeometry(vr.right() + 1, vr.top(), rightMargin, vr.height());
 }
 
 void CodeEditor::ensureBlockIsVisible(const QTextBlock &block)
@@ -1136,9 +1829,9 @@ bool CodeEditor::findText(const QString &searchText, bool caseSensitive, bool wh
                          bool searchBackwards, bool wrapAround)
 {
     if (searchBackwards) {
-        return findPrevious(searchText, caseSensitive, wholeWords, wrapAround);
+        return findPrevious(searchText, caseSensitive, wholeWords, false, wrapAround);
     } else {
-        return findNext(searchText, caseSensitive, wholeWords, wrapAround);
+        return findNext(searchText, caseSensitive, wholeWords, false, wrapAround);
     }
 }
 
@@ -1186,4 +1879,36 @@ void CodeEditor::setLineNumbersVisible(bool visible)
     updateViewportMargins();
 }
 
+void CodeEditor::setMinimapVisible(bool visible)
+{
+    minimap->setVisible(visible);
+    updateViewportMargins();
+}
+
+// Search matches and collapsed regions as minimap marks, by line
+void CodeEditor::updateMinimapMarks()
+{
+    static const int MAX_MARKED_MATCHES = 10000;
+
+    QVector<int> lines;
+    const QVector<SearchMatch> &matches = findAllEngine->matches();
+    int count = qMin(int(matches.size()), MAX_MARKED_MATCHES);
+    int lastLine = -1;
+    for (int i = 0; i < count; ++i) {
+        int line = document()->findBlock(matches[i].position).blockNumber();
+        if (line != lastLine) {
+            lines.append(line);
+            lastLine = line;
+        }
+    }
+    minimap->setSearchMatchLines(lines);
+
+    QVector<QPair<int, int>> regions;
+    for (auto it = foldedRegions.constBegin(); it != foldedRegions.constEnd(); ++it) {
+        if (it.value().isCollapsed)
+            regions.append(qMakePair(it.key(), it.value().endBlock));
+    }
+    minimap->setFoldedRegions(regions);
+}
+
 // ... existing code ... 
\ No newline at end of file
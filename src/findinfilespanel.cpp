@@ -0,0 +1,332 @@
+#include "findinfilespanel.h"
+#include "search/regexsearch.h"
+#include "search/trigramindex.h"
+#include "dialogs/replacepreviewdialog.h"
+#include <QVBoxLayout>
+#include <QHBoxLayout>
+#include <QLineEdit>
+#include <QCheckBox>
+#include <QPushButton>
+#include <QToolButton>
+#include <QLabel>
+#include <QTreeWidget>
+#include <QHeaderView>
+#include <QFileDialog>
+#include <QMessageBox>
+#include <QDir>
+
+namespace {
+
+enum ItemRole {
+    FilePathRole = Qt::UserRole,
+    LineRole,
+    ColumnRole,
+    LengthRole
+};
+
+}
+
+FindInFilesPanel::FindInFilesPanel(QWidget *parent)
+    : QDockWidget(tr("Find in Files"), parent)
+    , fileSearch(new FileSearch(this))
+    , projectReplace(new ProjectReplace(this))
+    , index(nullptr)
+    , hitsShown(0)
+    , lastTruncated(false)
+{
+    setObjectName("FindInFilesPanel");
+    setupUi();
+
+    connect(fileSearch, &FileSearch::hitsFound, this, &FindInFilesPanel::addHits);
+    connect(fileSearch, &FileSearch::progress, this, &FindInFilesPanel::updateProgress);
+    connect(fileSearch, &FileSearch::finished, this, &FindInFilesPanel::searchFinished);
+    connect(projectReplace, &ProjectReplace::editsReady, this, &FindInFilesPanel::previewReplace);
+    connect(projectReplace, &ProjectReplace::committed, this, &FindInFilesPanel::replaceCommitted);
+    connect(projectReplace, &ProjectReplace::commitFailed, this, &FindInFilesPanel::replaceFailed);
+}
+
+void FindInFilesPanel::setupUi()
+{
+    QWidget *container = new QWidget(this);
+
+    folderEdit = new QLineEdit(QDir::currentPath());
+    QToolButton *browseButton = new QToolButton;
+    browseButton->setText(tr("..."));
+    patternEdit = new QLineEdit;
+    patternEdit->setPlaceholderText(tr("Search for"));
+    caseSensitiveCheckBox = new QCheckBox(tr("Case"));
+    wholeWordsCheckBox = new QCheckBox(tr("Words"));
+    regexCheckBox = new QCheckBox(tr("Regex"));
+    useIndexCheckBox = new QCheckBox(tr("Index"));
+    useIndexCheckBox->setToolTip(tr("Keep a trigram index of this folder so repeated searches "
+                                    "only read files that can match"));
+    searchButton = new QPushButton(tr("Search"));
+    replaceEdit = new QLineEdit;
+    replaceEdit->setPlaceholderText(tr("Replace with"));
+    replaceButton = new QPushButton(tr("Replace..."));
+    replaceButton->setEnabled(false);
+    statusLabel = new QLabel;
+
+    resultsTree = new QTreeWidget;
+    resultsTree->setHeaderHidden(true);
+    resultsTree->setUniformRowHeights(true);
+    resultsTree->header()->setSectionResizeMode(QHeaderView::ResizeToContents);
+
+    QHBoxLayout *folderLayout = new QHBoxLayout;
+    folderLayout->addWidget(new QLabel(tr("Folder:")));
+    folderLayout->addWidget(folderEdit);
+    folderLayout->addWidget(browseButton);
+
+    QHBoxLayout *queryLayout = new QHBoxLayout;
+    queryLayout->addWidget(patternEdit);
+    queryLayout->addWidget(caseSensitiveCheckBox);
+    queryLayout->addWidget(wholeWordsCheckBox);
+    queryLayout->addWidget(regexCheckBox);
+    queryLayout->addWidget(useIndexCheckBox);
+    queryLayout->addWidget(searchButton);
+
+    QHBoxLayout *replaceLayout = new QHBoxLayout;
+    replaceLayout->addWidget(replaceEdit);
+    replaceLayout->addWidget(replaceButton);
+
+    QVBoxLayout *mainLayout = new QVBoxLayout(container);
+    mainLayout->addLayout(folderLayout);
+    mainLayout->addLayout(queryLayout);
+    mainLayout->addLayout(replaceLayout);
+    mainLayout->addWidget(statusLabel);
+    mainLayout->addWidget(resultsTree);
+    setWidget(container);
+
+    connect(browseButton, &QToolButton::clicked, this, &FindInFilesPanel::browseForFolder);
+    connect(searchButton, &QPushButton::clicked, this, &FindInFilesPanel::startOrStop);
+    connect(replaceButton, &QPushButton::clicked, this, &FindInFilesPanel::startReplace);
+    connect(patternEdit, &QLineEdit::returnPressed, this, &FindInFilesPanel::startOrStop);
+    connect(resultsTree, &QTreeWidget::itemActivated, this, &FindInFilesPanel::activateItem);
+    connect(useIndexCheckBox, &QCheckBox::toggled, this, &FindInFilesPanel::updateIndex);
+    connect(folderEdit, &QLineEdit::editingFinished, this, &FindInFilesPanel::updateIndex);
+}
+
+void FindInFilesPanel::setRootPath(const QString &path)
+{
+    folderEdit->setText(QDir::toNativeSeparators(path));
+    updateIndex();
+}
+
+void FindInFilesPanel::updateIndex()
+{
+    const QString root = QDir(rootPath()).absolutePath();
+    if (!useIndexCheckBox->isChecked() || !QDir(root).exists()) {
+        delete index;
+        index = nullptr;
+        return;
+    }
+    if (index && index->rootPath() == root)
+        return;
+
+    delete index;
+    index = new TrigramIndex(root, this);
+    connect(index, &TrigramIndex::buildProgress, this, [this](int filesIndexed) {
+        if (!fileSearch->isRunning())
+            statusLabel->setText(tr("Indexing... %1 files").arg(filesIndexed));
+    });
+    connect(index, &TrigramIndex::indexReady, this, [this](int fileCount) {
+        if (!fileSearch->isRunning())
+            statusLabel->setText(tr("Index ready (%1 files)").arg(fileCount));
+    });
+    index->open();
+}
+
+void FindInFilesPanel::notifyFileSaved(const QString &filePath)
+{
+    if (index)
+        index->markDirty(filePath);
+}
+
+QString FindInFilesPanel::rootPath() const
+{
+    return QDir::fromNativeSeparators(folderEdit->text());
+}
+
+void FindInFilesPanel::focusSearch()
+{
+    patternEdit->setFocus();
+    patternEdit->selectAll();
+}
+
+void FindInFilesPanel::browseForFolder()
+{
+    const QString folder = QFileDialog::getExistingDirectory(this, tr("Search Folder"), rootPath());
+    if (!folder.isEmpty())
+        setRootPath(folder);
+}
+
+void FindInFilesPanel::startOrStop()
+{
+    if (fileSearch->isRunning()) {
+        fileSearch->cancel();
+        setSearching(false);
+        statusLabel->setText(tr("Search stopped"));
+        return;
+    }
+
+    const QString pattern = patternEdit->text();
+    if (pattern.isEmpty() || !QDir(rootPath()).exists())
+        return;
+
+    SearchOptions options;
+    options.caseSensitive = caseSensitiveCheckBox->isChecked();
+    options.wholeWords = wholeWordsCheckBox->isChecked();
+    options.regularExpression = regexCheckBox->isChecked();
+    if (options.regularExpression) {
+        const QRegularExpression expression = RegexSearch::compile(pattern, true, false);
+        if (!expression.isValid()) {
+            statusLabel->setText(tr("Invalid regular expression: %1").arg(expression.errorString()));
+            return;
+        }
+    }
+
+    projectReplace->cancel();
+    resultsTree->clear();
+    fileItems.clear();
+    hitsShown = 0;
+    lastPattern = pattern;
+    lastOptions = options;
+    lastTruncated = false;
+    setSearching(true);
+
+    // Let the index rule out files first when it covers this folder
+    bool narrowed = false;
+    QStringList files;
+    if (index && index->isReady() && index->rootPath() == QDir(rootPath()).absolutePath())
+        files = index->candidates(pattern, options, &narrowed);
+
+    if (narrowed) {
+        statusLabel->setText(tr("Searching %n candidate file(s)...", nullptr, files.size()));
+        fileSearch->startInFiles(rootPath(), files, pattern, options);
+    } else {
+        statusLabel->setText(tr("Searching..."));
+        fileSearch->start(rootPath(), pattern, options);
+    }
+}
+
+void FindInFilesPanel::setSearching(bool searching)
+{
+    searchButton->setText(searching ? tr("Stop") : tr("Search"));
+    replaceButton->setEnabled(!searching && !fileItems.isEmpty() && !projectReplace->isBusy());
+}
+
+void FindInFilesPanel::addHits(const QVector<FileSearchHit> &hits)
+{
+    const QDir root(rootPath());
+    resultsTree->setUpdatesEnabled(false);
+    for (const FileSearchHit &hit : hits) {
+        QTreeWidgetItem *fileItem = fileItems.value(hit.filePath);
+        if (!fileItem) {
+            fileItem = new QTreeWidgetItem(resultsTree);
+            fileItem->setText(0, QDir::toNativeSeparators(root.relativeFilePath(hit.filePath)));
+            fileItem->setData(0, FilePathRole, hit.filePath);
+            fileItem->setData(0, LineRole, 0);
+            fileItems.insert(hit.filePath, fileItem);
+        }
+
+        QTreeWidgetItem *item = new QTreeWidgetItem(fileItem);
+        item->setText(0, tr("%1: %2").arg(hit.line).arg(hit.preview.trimmed()));
+        item->setData(0, FilePathRole, hit.filePath);
+        item->setData(0, LineRole, hit.line);
+        item->setData(0, ColumnRole, hit.column);
+        item->setData(0, LengthRole, hit.length);
+    }
+    hitsShown += hits.size();
+    resultsTree->setUpdatesEnabled(true);
+}
+
+void FindInFilesPanel::updateProgress(int filesSearched)
+{
+    statusLabel->setText(tr("Searching... %1 matches in %2 files so far")
+                         .arg(hitsShown).arg(filesSearched));
+}
+
+void FindInFilesPanel::searchFinished(int hitCount, int filesSearched, int filesSkipped, bool truncated)
+{
+    lastTruncated = truncated;
+    setSearching(false);
+    QString text = tr("%n match(es) in %1 file(s), %2 files searched", nullptr, hitCount)
+                   .arg(fileItems.size()).arg(filesSearched);
+    if (filesSkipped > 0)
+        text += tr(", %n file(s) over %1 MB skipped", nullptr, filesSkipped)
+                .arg(FileSearch::MAX_FILE_SIZE / (1024 * 1024));
+    if (truncated)
+        text += tr(" (stopped at the result limit)");
+    statusLabel->setText(text);
+}
+
+void FindInFilesPanel::activateItem(QTreeWidgetItem *item)
+{
+    const int line = item->data(0, LineRole).toInt();
+    if (line <= 0)
+        return;
+    emit openLocation(item->data(0, FilePathRole).toString(), line,
+                      item->data(0, ColumnRole).toInt(), item->data(0, LengthRole).toInt());
+}
+
+void FindInFilesPanel::startReplace()
+{
+    if (fileSearch->isRunning() || projectReplace->isBusy() || fileItems.isEmpty())
+        return;
+    if (lastTruncated) {
+        statusLabel->setText(tr("Too many matches to replace at once; narrow the search first"));
+        return;
+    }
+
+    replaceButton->setEnabled(false);
+    statusLabel->setText(tr("Preparing replacements in %n file(s)...", nullptr, fileItems.size()));
+    projectReplace->compute(fileItems.keys(), lastPattern, replaceEdit->text(), lastOptions);
+}
+
+void FindInFilesPanel::previewReplace(const QVector<FileEdit> &edits, int filesSkipped)
+{
+    setSearching(false);
+    QString skippedNote;
+    if (filesSkipped > 0)
+        skippedNote = tr(" (%n file(s) skipped: not UTF-8 text or over %1 MB)", nullptr, filesSkipped)
+                      .arg(FileSearch::MAX_FILE_SIZE / (1024 * 1024));
+    if (edits.isEmpty()) {
+        statusLabel->setText(tr("Nothing to replace") + skippedNote);
+        return;
+    }
+
+    ReplacePreviewDialog dialog(edits, rootPath(), this);
+    if (dialog.exec() != QDialog::Accepted) {
+        statusLabel->setText(tr("Replace canceled"));
+        return;
+    }
+    const QVector<FileEdit> selected = dialog.selectedEdits();
+    if (selected.isEmpty())
+        return;
+
+    statusLabel->setText(tr("Replacing in %n file(s)...", nullptr, selected.size()) + skippedNote);
+    projectReplace->commit(selected);
+    replaceButton->setEnabled(false);
+}
+
+void FindInFilesPanel::replaceCommitted(const QStringList &files, int replacements)
+{
+    for (const QString &filePath : files)
+        notifyFileSaved(filePath);
+
+    // The hits no longer describe the files, so drop them
+    resultsTree->clear();
+    fileItems.clear();
+    hitsShown = 0;
+    setSearching(false);
+    statusLabel->setText(tr("Replaced %n occurrence(s) in %1 file(s)", nullptr, replacements)
+                         .arg(files.size()));
+    emit filesReplaced(files);
+}
+
+void FindInFilesPanel::replaceFailed(const QString &message)
+{
+    setSearching(false);
+    statusLabel->setText(tr("Replace failed"));
+    QMessageBox::warning(this, tr("Replace in Files"), message);
+}
@@ -0,0 +1,122 @@
+#include "gutterrenderer.h"
+#include <QtGui/QPainter>
+#include <QtGui/QFontMetrics>
+#include <QtGui/QRadialGradient>
+
+GutterRenderer::GutterRenderer()
+    : devicePixelRatio(1), valid(false), foldMarkerPixelRatio(1), foldMarkersValid(false),
+      digitWidth(1), height(1)
+{
+}
+
+void GutterRenderer::setStyle(const QFont &newFont, const QColor &newColor, qreal newDevicePixelRatio)
+{
+    if (valid && newFont == font && newColor == color && newDevicePixelRatio == devicePixelRatio)
+        return;
+
+    font = newFont;
+    color = newColor;
+    devicePixelRatio = newDevicePixelRatio;
+    rebuild();
+}
+
+void GutterRenderer::rebuild()
+{
+    const QFontMetrics metrics(font);
+    height = metrics.height();
+    digitWidth = 1;
+    for (char c = '0'; c <= '9'; ++c)
+        digitWidth = qMax(digitWidth, metrics.horizontalAdvance(QLatin1Char(c)));
+
+    // Each digit is right-aligned in a fixed cell, like the right-aligned text it replaces
+    digits = QPixmap(QSize(digitWidth * 10, height) * devicePixelRatio);
+    digits.setDevicePixelRatio(devicePixelRatio);
+    digits.fill(Qt::transparent);
+    {
+        QPainter painter(&digits);
+        painter.setFont(font);
+        painter.setPen(color);
+        for (int d = 0; d < 10; ++d) {
+            const QChar digit(QLatin1Char(char('0' + d)));
+            painter.drawText(d * digitWidth + digitWidth - metrics.horizontalAdvance(digit),
+                             metrics.ascent(), QString(digit));
+        }
+    }
+
+    // The glow is twice the dot's size with the dot in the middle
+    const int size = DOT_SIZE * 2;
+    glow = QPixmap(QSize(size, size) * devicePixelRatio);
+    glow.setDevicePixelRatio(devicePixelRatio);
+    glow.fill(Qt::transparent);
+    {
+        QPainter painter(&glow);
+        painter.setRenderHint(QPainter::Antialiasing);
+        painter.setPen(Qt::NoPen);
+        QRadialGradient gradient(size / 2.0, size / 2.0, DOT_SIZE * 1.5);
+        gradient.setColorAt(0, QColor(0, 120, 255, 120));
+        gradient.setColorAt(1, QColor(0, 120, 255, 0));
+        painter.setBrush(gradient);
+        painter.drawEllipse(0, 0, size, size);
+        painter.setBrush(QColor(0, 120, 255));
+        painter.drawEllipse(DOT_SIZE / 2, DOT_SIZE / 2, DOT_SIZE, DOT_SIZE);
+    }
+
+    valid = true;
+}
+
+void GutterRenderer::setFoldMarkerStyle(const QColor &color, qreal devicePixelRatio)
+{
+    if (foldMarkersValid && color == foldMarkerColor && devicePixelRatio == foldMarkerPixelRatio)
+        return;
+
+    foldMarkerColor = color;
+    foldMarkerPixelRatio = devicePixelRatio;
+    rebuildFoldMarkers();
+}
+
+void GutterRenderer::rebuildFoldMarkers()
+{
+    // The outline is drawn on pixel edges, so the box needs one extra pixel
+    const int size = FOLD_MARKER_SIZE;
+    for (int collapsed = 0; collapsed < 2; ++collapsed) {
+        QPixmap sprite(QSize(size + 1, size + 1) * foldMarkerPixelRatio);
+        sprite.setDevicePixelRatio(foldMarkerPixelRatio);
+        sprite.fill(Qt::transparent);
+        QPainter painter(&sprite);
+        painter.setPen(foldMarkerColor);
+        painter.drawRect(0, 0, size, size);
+        painter.drawLine(2, size / 2, size - 2, size / 2);
+        if (collapsed)
+            painter.drawLine(size / 2, 2, size / 2, size - 2);
+        painter.end();
+        (collapsed ? foldCollapsed : foldExpanded) = sprite;
+    }
+    foldMarkersValid = true;
+}
+
+void GutterRenderer::drawFoldMarker(QPainter *painter, const QRect &rect, bool collapsed) const
+{
+    painter->drawPixmap(rect.center().x() - FOLD_MARKER_SIZE / 2,
+                        rect.center().y() - FOLD_MARKER_SIZE / 2,
+                        collapsed ? foldCollapsed : foldExpanded);
+}
+
+void GutterRenderer::drawNumber(QPainter *painter, int number, int right, int top) const
+{
+    const qreal cellWidth = digitWidth * devicePixelRatio;
+    const qreal cellHeight = height * devicePixelRatio;
+    int x = right;
+    do {
+        x -= digitWidth;
+        painter->drawPixmap(QPointF(x, top), digits,
+                            QRectF((number % 10) * cellWidth, 0, cellWidth, cellHeight));
+        number /= 10;
+    } while (number > 0);
+}
+
+void GutterRenderer::drawCurrentLineMarker(QPainter *painter, int right, int top) const
+{
+    const int dotX = right - DOT_SIZE - 2;
+    const int dotY = top + (height - DOT_SIZE) / 2;
+    painter->drawPixmap(dotX - DOT_SIZE / 2, dotY - DOT_SIZE / 2, glow);
+}
@@ -0,0 +1,406 @@
+#include "longlineview.h"
+#include "search/literalsearch.h"
+#include "search/regexsearch.h"
+#include <QPainter>
+#include <QScrollBar>
+#include <QKeyEvent>
+#include <QMouseEvent>
+#include <QApplication>
+#include <QClipboard>
+#include <QFontDatabase>
+#include <QFontInfo>
+#include <QtMath>
+#include <algorithm>
+
+namespace {
+
+bool isWordCharacter(QChar c)
+{
+    return c.isLetterOrNumber() || c == QLatin1Char('_');
+}
+
+}
+
+LongLineView::LongLineView(QWidget *parent)
+    : QAbstractScrollArea(parent), longestLine(0), cursor(0), anchor(0), desiredColumn(0),
+      cellWidth(1), lineHeight(1), ascent(0)
+{
+    setFocusPolicy(Qt::StrongFocus);
+    viewport()->setCursor(Qt::IBeamCursor);
+    lineStarts.append(0);
+    updateMetrics();
+}
+
+bool LongLineView::needsLongLineMode(const QString &text)
+{
+    const QStringView view(text);
+    qsizetype start = 0;
+    while (start <= view.size()) {
+        qsizetype end = view.indexOf(QLatin1Char('\n'), start);
+        if (end < 0)
+            end = view.size();
+        if (end - start > LONG_LINE_THRESHOLD)
+            return true;
+        start = end + 1;
+    }
+    return false;
+}
+
+void LongLineView::setText(const QString &text)
+{
+    content = text;
+    lineStarts.clear();
+    lineStarts.append(0);
+    longestLine = 0;
+    for (qsizetype i = content.indexOf(QLatin1Char('\n')); i >= 0;
+         i = content.indexOf(QLatin1Char('\n'), i + 1)) {
+        longestLine = qMax(longestLine, i - lineStarts.last());
+        lineStarts.append(i + 1);
+    }
+    longestLine = qMax(longestLine, content.size() - lineStarts.last());
+
+    cursor = anchor = desiredColumn = 0;
+    horizontalScrollBar()->setValue(0);
+    verticalScrollBar()->setValue(0);
+    updateScrollBars();
+    viewport()->update();
+    emit cursorPositionChanged(0, 0);
+}
+
+void LongLineView::clear()
+{
+    setText(QString());
+}
+
+int LongLineView::lineAt(qsizetype position) const
+{
+    auto it = std::upper_bound(lineStarts.constBegin(), lineStarts.constEnd(), position);
+    return int(it - lineStarts.constBegin()) - 1;
+}
+
+qsizetype LongLineView::lineLength(int line) const
+{
+    const qsizetype start = lineStarts.at(line);
+    qsizetype end = line + 1 < lineStarts.size() ? lineStarts.at(line + 1) - 1 : content.size();
+    if (end > start && content.at(end - 1) == QLatin1Char('\r'))
+        --end;
+    return end - start;
+}
+
+qsizetype LongLineView::positionOf(int line, qsizetype column) const
+{
+    line = qBound(0, line, int(lineStarts.size()) - 1);
+    return lineStarts.at(line) + qBound<qsizetype>(0, column, lineLength(line));
+}
+
+void LongLineView::select(qsizetype start, qsizetype end)
+{
+    anchor = qBound<qsizetype>(0, start, content.size());
+    moveCursor(end, true);
+}
+
+QString LongLineView::selectedText() const
+{
+    const qsizetype start = qMin(cursor, anchor);
+    return content.mid(start, qMax(cursor, anchor) - start);
+}
+
+void LongLineView::copy()
+{
+    if (cursor != anchor)
+        QApplication::clipboard()->setText(selectedText());
+}
+
+void LongLineView::selectAll()
+{
+    select(0, content.size());
+}
+
+bool LongLineView::find(const QString &pattern, const SearchOptions &options, bool backwards,
+                        bool wrapAround)
+{
+    if (pattern.isEmpty())
+        return false;
+    const qsizetype selectionStart = qMin(cursor, anchor);
+    const qsizetype selectionEnd = qMax(cursor, anchor);
+
+    if (options.regularExpression) {
+        const QRegularExpression expression = RegexSearch::compile(pattern, options.caseSensitive,
+                                                                   options.wholeWords);
+        if (!expression.isValid())
+            return false;
+        QRegularExpressionMatch match = backwards
+            ? RegexSearch::matchBefore(expression, content, selectionStart)
+            : RegexSearch::matchFrom(expression, content, selectionEnd);
+        if (!match.hasMatch() && wrapAround) {
+            match = backwards ? RegexSearch::matchBefore(expression, content, content.size())
+                              : RegexSearch::matchFrom(expression, content, 0);
+        }
+        if (!match.hasMatch())
+            return false;
+        select(match.capturedStart(), match.capturedEnd());
+        return true;
+    }
+
+    const Qt::CaseSensitivity cs = options.caseSensitive ? Qt::CaseSensitive : Qt::CaseInsensitive;
+    auto findBackward = [&](qsizetype from) -> qsizetype {
+        while (from >= 0) {
+            const qsizetype index = LiteralSearch::lastIndexOf(content, pattern, from, cs);
+            if (index < 0 || !options.wholeWords
+                || LiteralSearch::isWholeWordAt(content, index, pattern.size())) {
+                return index;
+            }
+            from = index - 1;
+        }
+        return -1;
+    };
+    auto findForward = [&](qsizetype from) -> qsizetype {
+        const QVector<SearchMatch> matches = FindAllEngine::searchRange(content, from, content.size(),
+                                                                        pattern, options, 1);
+        return matches.isEmpty() ? -1 : matches.first().position;
+    };
+
+    qsizetype index = backwards ? findBackward(selectionStart - 1) : findForward(selectionEnd);
+    if (index < 0 && wrapAround)
+        index = backwards ? findBackward(content.size()) : findForward(0);
+    if (index < 0)
+        return false;
+    select(index, index + pattern.size());
+    return true;
+}
+
+void LongLineView::updateMetrics()
+{
+    // The grid needs every cell the same width
+    renderFont = font();
+    if (!QFontInfo(renderFont).fixedPitch()) {
+        const qreal pointSize = renderFont.pointSizeF();
+        renderFont = QFontDatabase::systemFont(QFontDatabase::FixedFont);
+        if (pointSize > 0)
+            renderFont.setPointSizeF(pointSize);
+    }
+    const QFontMetricsF metrics(renderFont);
+    cellWidth = qMax<qreal>(1, metrics.horizontalAdvance(QLatin1Char('M')));
+    lineHeight = qMax(1, qCeil(metrics.height()));
+    ascent = qCeil(metrics.ascent());
+    updateScrollBars();
+    viewport()->update();
+}
+
+int LongLineView::visibleLines() const
+{
+    return qMax(1, viewport()->height() / lineHeight);
+}
+
+int LongLineView::visibleColumns() const
+{
+    return qMax(1, int(viewport()->width() / cellWidth));
+}
+
+void LongLineView::updateScrollBars()
+{
+    // Both bars scroll in whole cells, which keeps the range small for huge lines
+    verticalScrollBar()->setRange(0, qMax(0, int(lineStarts.size()) - visibleLines()));
+    verticalScrollBar()->setPageStep(visibleLines());
+    horizontalScrollBar()->setRange(0, int(qMax<qsizetype>(0, longestLine + 1 - visibleColumns())));
+    horizontalScrollBar()->setPageStep(visibleColumns());
+}
+
+void LongLineView::ensureCursorVisible()
+{
+    const int line = lineAt(cursor);
+    const qsizetype column = cursor - lineStarts.at(line);
+
+    QScrollBar *vertical = verticalScrollBar();
+    if (line < vertical->value())
+        vertical->setValue(line);
+    else if (line >= vertical->value() + visibleLines())
+        vertical->setValue(line - visibleLines() + 1);
+
+    // Jumps land with some context to the left of the cursor
+    QScrollBar *horizontal = horizontalScrollBar();
+    const int margin = visibleColumns() / 4;
+    if (column < horizontal->value())
+        horizontal->setValue(int(qMax<qsizetype>(0, column - margin)));
+    else if (column >= horizontal->value() + visibleColumns())
+        horizontal->setValue(int(column - visibleColumns() + 1 + margin));
+}
+
+void LongLineView::moveCursor(qsizetype position, bool keepAnchor, bool keepColumn)
+{
+    position = qBound<qsizetype>(0, position, content.size());
+    // Never split a surrogate pair
+    if (position > 0 && position < content.size() && content.at(position).isLowSurrogate())
+        position += position > cursor ? 1 : -1;
+
+    cursor = position;
+    if (!keepAnchor)
+        anchor = position;
+    const int line = lineAt(cursor);
+    if (!keepColumn)
+        desiredColumn = cursor - lineStarts.at(line);
+    ensureCursorVisible();
+    viewport()->update();
+    emit cursorPositionChanged(line, cursor - lineStarts.at(line));
+}
+
+qsizetype LongLineView::wordBoundary(qsizetype position, bool forward) const
+{
+    auto isWord = [this](qsizetype i) { return isWordCharacter(content.at(i)); };
+
+    if (forward) {
+        while (position < content.size() && !isWord(position))
+            ++position;
+        while (position < content.size() && isWord(position))
+            ++position;
+    } else {
+        while (position > 0 && !isWord(position - 1))
+            --position;
+        while (position > 0 && isWord(position - 1))
+            --position;
+    }
+    return position;
+}
+
+qsizetype LongLineView::positionAt(const QPoint &point) const
+{
+    const int line = qMin(int(lineStarts.size()) - 1,
+                          verticalScrollBar()->value() + qMax(0, point.y()) / lineHeight);
+    const qsizetype column = horizontalScrollBar()->value() + qRound(qMax(0, point.x()) / cellWidth);
+    return positionOf(line, column);
+}
+
+void LongLineView::paintEvent(QPaintEvent *)
+{
+    QPainter painter(viewport());
+    painter.setFont(renderFont);
+    painter.setPen(palette().color(QPalette::Text));
+
+    const int firstLine = verticalScrollBar()->value();
+    const qsizetype firstColumn = horizontalScrollBar()->value();
+    const qsizetype columns = visibleColumns() + 2;
+    const qsizetype selectionStart = qMin(cursor, anchor);
+    const qsizetype selectionEnd = qMax(cursor, anchor);
+
+    for (int row = 0; firstLine + row < lineStarts.size(); ++row) {
+        const int y = row * lineHeight;
+        if (y > viewport()->height())
+            break;
+        const int line = firstLine + row;
+        const qsizetype start = lineStarts.at(line);
+        const qsizetype length = lineLength(line);
+        const qsizetype from = qMin(length, firstColumn);
+        const qsizetype to = qMin(length, firstColumn + columns);
+
+        const qsizetype selectedFrom = qMax(selectionStart, start + from);
+        const qsizetype selectedTo = qMin(selectionEnd, start + to);
+        if (selectedFrom < selectedTo) {
+            painter.fillRect(QRectF((selectedFrom - start - firstColumn) * cellWidth, y,
+                                    (selectedTo - selectedFrom) * cellWidth, lineHeight),
+                             palette().color(QPalette::Highlight));
+        }
+
+        // Only the visible slice of the line is shaped
+        if (from < to) {
+            QString slice = content.mid(start + from, to - from);
+            slice.replace(QLatin1Char('\t'), QLatin1Char(' '));
+            painter.drawText(QPointF((from - firstColumn) * cellWidth, y + ascent), slice);
+        }
+    }
+
+    if (hasFocus()) {
+        const int line = lineAt(cursor);
+        const qreal x = (cursor - lineStarts.at(line) - firstColumn) * cellWidth;
+        const int y = (line - firstLine) * lineHeight;
+        painter.fillRect(QRectF(x, y, 2, lineHeight), palette().color(QPalette::Text));
+    }
+}
+
+void LongLineView::resizeEvent(QResizeEvent *event)
+{
+    QAbstractScrollArea::resizeEvent(event);
+    updateScrollBars();
+}
+
+void LongLineView::changeEvent(QEvent *event)
+{
+    QAbstractScrollArea::changeEvent(event);
+    if (event->type() == QEvent::FontChange)
+        updateMetrics();
+}
+
+void LongLineView::scrollContentsBy(int, int)
+{
+    viewport()->update();
+}
+
+void LongLineView::keyPressEvent(QKeyEvent *event)
+{
+    if (event->matches(QKeySequence::Copy)) {
+        copy();
+        return;
+    }
+    if (event->matches(QKeySequence::SelectAll)) {
+        selectAll();
+        return;
+    }
+
+    const bool keepAnchor = event->modifiers() & Qt::ShiftModifier;
+    const bool control = event->modifiers() & Qt::ControlModifier;
+    const int line = lineAt(cursor);
+
+    switch (event->key()) {
+    case Qt::Key_Left:
+        moveCursor(control ? wordBoundary(cursor, false) : cursor - 1, keepAnchor);
+        break;
+    case Qt::Key_Right:
+        moveCursor(control ? wordBoundary(cursor, true) : cursor + 1, keepAnchor);
+        break;
+    case Qt::Key_Up:
+        moveCursor(positionOf(line - 1, desiredColumn), keepAnchor, true);
+        break;
+    case Qt::Key_Down:
+        moveCursor(positionOf(line + 1, desiredColumn), keepAnchor, true);
+        break;
+    case Qt::Key_PageUp:
+        moveCursor(positionOf(line - visibleLines(), desiredColumn), keepAnchor, true);
+        break;
+    case Qt::Key_PageDown:
+        moveCursor(positionOf(line + visibleLines(), desiredColumn), keepAnchor, true);
+        break;
+    case Qt::Key_Home:
+        moveCursor(control ? 0 : lineStarts.at(line), keepAnchor);
+        break;
+    case Qt::Key_End:
+        moveCursor(control ? content.size() : lineStarts.at(line) + lineLength(line), keepAnchor);
+        break;
+    default:
+        QAbstractScrollArea::keyPressEvent(event);
+        break;
+    }
+}
+
+void LongLineView::mousePressEvent(QMouseEvent *event)
+{
+    if (event->button() == Qt::LeftButton)
+        moveCursor(positionAt(event->pos()), event->modifiers() & Qt::ShiftModifier);
+}
+
+void LongLineView::mouseMoveEvent(QMouseEvent *event)
+{
+    if (event->buttons() & Qt::LeftButton)
+        moveCursor(positionAt(event->pos()), true);
+}
+
+void LongLineView::mouseDoubleClickEvent(QMouseEvent *event)
+{
+    if (event->button() != Qt::LeftButton)
+        return;
+    qsizetype start = positionAt(event->pos());
+    qsizetype end = start;
+    while (start > 0 && isWordCharacter(content.at(start - 1)))
+        --start;
+    while (end < content.size() && isWordCharacter(content.at(end)))
+        ++end;
+    select(start, end);
+}
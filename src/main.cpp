@@ -1,10 +1,51 @@
 #include <QtWidgets/QApplication>
+#include <QCommandLineParser>
+#include <QFileInfo>
+#include <memory>
 #include "mainwindow.h"
 #include "crashhandler.h"
+#include "singleinstance.h"
+#include "startuptrace.h"
 
 int main(int argc, char *argv[])
 {
+    StartupTrace::start();
+    QStringList files;
+    bool wait = false;
+    {
+        // A core application is enough to read the arguments and pass them to a
+        // running instance, and costs a fraction of a QApplication
+        QCoreApplication launcher(argc, argv);
+        QCoreApplication::setApplicationName("Text Editor");
+        QCoreApplication::setApplicationVersion("1.0.0");
+        
+        QCommandLineParser parser;
+        const QCommandLineOption helpOption = parser.addHelpOption();
+        const QCommandLineOption versionOption = parser.addVersionOption();
+        QCommandLineOption waitOption("wait", "Return only once the files are closed again, for use as $EDITOR.");
+        parser.addOption(waitOption);
+        QCommandLineOption traceOption("startup-trace", "Print how long each startup phase took to stderr.");
+        parser.addOption(traceOption);
+        parser.addPositionalArgument("files", "Files to open.", "[files...]");
+        // Not process(): options meant for QApplication aren't errors here
+        parser.parse(QCoreApplication::arguments());
+        if (parser.isSet(helpOption))
+            parser.showHelp();
+        if (parser.isSet(versionOption))
+            parser.showVersion();
+        
+        wait = parser.isSet(waitOption);
+        StartupTrace::setEnabled(parser.isSet(traceOption));
+        for (const QString &file : parser.positionalArguments())
+            files.append(QFileInfo(file).absoluteFilePath());
+        
+        if (SingleInstance::forward(files, wait))
+            return 0;
+    }
+    StartupTrace::mark("arguments and instance check");
+    
     QApplication app(argc, argv);
+    StartupTrace::mark("QApplication");
     
     // Set application info
     QApplication::setApplicationName("Text Editor");
@@ -12,18 +53,48 @@ int main(int argc, char *argv[])
     QApplication::setOrganizationName("TextEditor");
     QApplication::setOrganizationDomain("texteditor.org");
     
-    // Initialize crash handler
+    // Only the handlers now; the log file and report waits for the first frame
     CrashHandler::initialize();
 #ifdef QT_DEBUG
     CrashHandler::enableDebugMode(true);
 #endif
     
     LOG_DEBUG("Application started");
+    StartupTrace::mark("crash handlers");
+    
+    // Listen before the window is built, so launches during startup find this instance
+    SingleInstance instance;
+    if (!instance.listen())
+        LOG_WARNING("Could not start the single-instance server");
+    StartupTrace::mark("single-instance server");
     
     MainWindow w;
     w.show();
+    StartupTrace::mark("show");
+    StartupTrace::afterFirstFrame(&w, [&w]() {
+        CrashHandler::initializeReporting();
+        StartupTrace::mark("crash reporting");
+        w.completeStartup();
+        StartupTrace::finish();
+    });
+    
+    QObject::connect(&instance, &SingleInstance::openRequested, &w, &MainWindow::openFiles);
+    QObject::connect(&w, &MainWindow::documentClosed, &instance, &SingleInstance::release);
+    
+    if (!files.isEmpty())
+        w.openFiles(files);
+    if (wait && !files.isEmpty()) {
+        // No instance was running, so this process is the one the caller waits on
+        auto remaining = std::make_shared<QStringList>(files);
+        QObject::connect(&w, &MainWindow::documentClosed, &app, [remaining](const QString &filePath) {
+            remaining->removeIf([&filePath](const QString &file) { return QFileInfo(file) == QFileInfo(filePath); });
+            if (remaining->isEmpty())
+                QApplication::quit();
+        });
+    }
     
     int result = app.exec();
     LOG_DEBUG("Application exiting with code: " + QString::number(result));
+    CrashHandler::shutdown();
     return result;
-} 
\ No newline at end of file
+}
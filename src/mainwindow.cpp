@@ -3,59 +3,122 @@
 #include "dialogs/finddialog.h"
 #include "dialogs/autocorrectdialog.h"
 #include "dialogs/recoverydialog.h"
+#include "findinfilespanel.h"
+#include "longlineview.h"
+#include "profileroverlay.h"
+#include "savescheduler.h"
+#include "autosaveservice.h"
 #include "sessionmanager.h"
+#include "documenthandle.h"
+#include "crashhandler.h"
+#include "startuptrace.h"
+#include "settingsstore.h"
 #include <QMessageBox>
 #include <QFileDialog>
 #include <QTextStream>
 #include <QCloseEvent>
 #include <QStatusBar>
+#include <QStackedWidget>
+#include <QTabBar>
+#include <QVBoxLayout>
+#include <QScrollBar>
+#include <QSignalBlocker>
 #include <QTextDocument>
+#include <QTextBlock>
 #include <QDir>
 #include <QFileInfo>
+#include <QSaveFile>
 
 MainWindow::MainWindow(QWidget *parent)
     : QMainWindow(parent)
     , ui(new Ui::MainWindow)
-    , textEdit(new CodeEditor)
+    , textEdit(nullptr)
+    , longLineView(new LongLineView)
+    , editorStack(new QStackedWidget)
+    , tabBar(new QTabBar)
+    , activeDocument(-1)
+    , showCounter(0)
+    , profilerOverlay(nullptr)
     , wordCountLabel(new QLabel(this))
     , autocorrectLabel(new QLabel(this))
     , findDialog(nullptr)
+    , findInFilesPanel(nullptr)
     , autocorrectDialog(nullptr)
-    , sessionManager(new SessionManager(textEdit, this))
+    , saveScheduler(new SaveScheduler(this))
+    , sessionManager(new SessionManager(saveScheduler, this))
     , autoCorrectEnabled(true)
+    , startupComplete(false)
 {
+    StartupTrace::mark("session manager");
     ui->setupUi(this);
-    setCentralWidget(textEdit);
+    editorStack->addWidget(longLineView);
+    
+    // Editors are made as tabs are shown and dropped again by trimLoadedDocuments()
+    tabBar->setTabsClosable(true);
+    tabBar->setDocumentMode(true);
+    tabBar->setExpanding(false);
+    QWidget *central = new QWidget;
+    QVBoxLayout *layout = new QVBoxLayout(central);
+    layout->setContentsMargins(0, 0, 0, 0);
+    layout->setSpacing(0);
+    layout->addWidget(tabBar);
+    layout->addWidget(editorStack);
+    setCentralWidget(central);
+    profilerOverlay = new ProfilerOverlay(editorStack);
+    connect(tabBar, &QTabBar::currentChanged, this, &MainWindow::activateDocument);
+    connect(tabBar, &QTabBar::tabCloseRequested, this, &MainWindow::closeDocument);
     
     createActions();
     createMenus();
     setupEditor();
     setupStatusBar();
-    initializeAutocorrect();
-    
-    connect(textEdit, &CodeEditor::textChanged, this, &MainWindow::handleTextChange);
-    connect(textEdit->document(), &QTextDocument::modificationChanged,
-            this, &MainWindow::documentWasModified);
+    StartupTrace::mark("window layout and actions");
     
     sessionManager->startAutoSave();
-    QTimer::singleShot(0, this, &MainWindow::checkForRecovery);
     
-    setCurrentFile(QString());
+    sessionManager->setDocumentProvider([this](QList<DocumentState> *states, int *active) {
+        states->clear();
+        for (const DocumentHandle *handle : std::as_const(documents))
+            states->append(handle->state());
+        *active = activeDocument;
+    });
+    restoreDocuments();
     setUnifiedTitleAndToolBarOnMac(true);
+    StartupTrace::mark("documents");
 }
 
 MainWindow::~MainWindow()
 {
+    CrashHandler::registerDocument(nullptr);
+    saveScheduler->saveAll();
+    
+    // The session asks the open documents for their last state, so it goes first
+    delete sessionManager;
+    textEdit = nullptr;
+    qDeleteAll(documents);
     delete ui;
     delete findDialog;
     delete autocorrectDialog;
 }
 
+void MainWindow::completeStartup()
+{
+    startupComplete = true;
+    for (DocumentHandle *handle : std::as_const(documents)) {
+        if (handle->isLoaded())
+            handle->editor()->setAnalysisDeferred(false);
+    }
+    StartupTrace::mark("highlighting and folds");
+    initializeAutocorrect();
+    checkForRecovery();
+    StartupTrace::mark("autocorrect and recovery check");
+}
+
 void MainWindow::checkForRecovery()
 {
     if (sessionManager->hasAutoSavedSession()) {
         SessionData lastSession = sessionManager->getLastSession();
-        RecoveryDialog *dialog = new RecoveryDialog(lastSession.filePath, lastSession.lastSaved, this);
+        RecoveryDialog *dialog = new RecoveryDialog(sessionManager->recoveredFilePath(), lastSession.lastSaved, this);
         
         connect(dialog, &RecoveryDialog::recoverSession, this, &MainWindow::recoverSession);
         connect(dialog, &RecoveryDialog::discardSession, this, &MainWindow::discardSession);
@@ -68,14 +131,40 @@ void MainWindow::checkForRecovery()
 void MainWindow::recoverSession()
 {
     SessionData lastSession = sessionManager->getLastSession();
-    textEdit->setPlainText(lastSession.content);
+    const QString filePath = sessionManager->recoveredFilePath();
+    const QString text = sessionManager->recoverContent();
     
-    QTextCursor cursor = textEdit->textCursor();
-    cursor.setPosition(lastSession.cursorPosition);
-    textEdit->setTextCursor(cursor);
+    // The journal may have followed a document other than the active one, so
+    // the text goes to that document's tab and stays modified until saved
+    int index = filePath.isEmpty() ? -1 : findDocument(filePath);
+    if (index < 0 && isActiveDocumentBlank()) {
+        index = activeDocument;
+        documents[index]->setFilePath(filePath);
+    }
+    if (index < 0) {
+        DocumentState state;
+        state.filePath = filePath;
+        state.modified = true;
+        index = addDocument(state);
+        switchToDocument(index);
+        showDocument(index, text);
+    } else {
+        activateDocument(index);
+        if (isLongLineMode()) {
+            longLineView->clear();
+            setLongLineMode(false);
+        }
+        textEdit->setDocumentText(text);
+        textEdit->document()->setModified(true);
+        updateCurrentFile();
+        updateWordCount();
+    }
     
-    if (!lastSession.filePath.isEmpty()) {
-        setCurrentFile(lastSession.filePath);
+    // The cursor was saved for the active document, which may not be the recovered one
+    if (filePath == lastSession.filePath) {
+        QTextCursor cursor = textEdit->textCursor();
+        cursor.setPosition(qBound(0, lastSession.cursorPosition, textEdit->document()->characterCount() - 1));
+        textEdit->setTextCursor(cursor);
     }
     
     // Clear the auto-saved session since we've recovered it
@@ -99,17 +188,290 @@ void MainWindow::discardSession()
 
 void MainWindow::setCurrentFile(const QString &fileName)
 {
-    currentFile = fileName;
-    sessionManager->setCurrentFile(fileName);
+    documents[activeDocument]->setFilePath(fileName);
     textEdit->document()->setModified(false);
+    updateCurrentFile();
+}
+
+void MainWindow::updateCurrentFile()
+{
+    currentFile = documents[activeDocument]->filePath();
+    sessionManager->setCurrentFile(currentFile);
     
     QString shownName = currentFile;
     if (currentFile.isEmpty())
         shownName = "untitled.txt";
     setWindowFilePath(shownName);
+    setWindowModified(textEdit->document()->isModified());
+    updateTabTitle(activeDocument);
+}
+
+// Only tab shells are made here; a document is read and highlighted when first shown
+void MainWindow::restoreDocuments()
+{
+    const SessionData session = sessionManager->getLastSession();
+    for (const DocumentState &state : session.documents)
+        addDocument(state);
+    if (documents.isEmpty())
+        addDocument(DocumentState());
+    activateDocument(qBound(0, session.activeDocument, int(documents.size()) - 1));
+}
+
+int MainWindow::addDocument(const DocumentState &state)
+{
+    documents.append(new DocumentHandle(state));
+    const int index = int(documents.size()) - 1;
+    const QSignalBlocker blocker(tabBar);
+    tabBar->addTab(QString());
+    updateTabTitle(index);
+    return index;
+}
+
+int MainWindow::findDocument(const QString &fileName) const
+{
+    const QFileInfo fileInfo(fileName);
+    for (int i = 0; i < documents.size(); ++i) {
+        const QString filePath = documents[i]->filePath();
+        if (!filePath.isEmpty() && QFileInfo(filePath) == fileInfo)
+            return i;
+    }
+    return -1;
+}
+
+// An untitled, unmodified and empty tab, which opening a file may reuse
+bool MainWindow::isActiveDocumentBlank() const
+{
+    return activeDocument >= 0 && documents[activeDocument]->filePath().isEmpty()
+        && !isLongLineMode() && !textEdit->document()->isModified() && textEdit->document()->isEmpty();
+}
+
+void MainWindow::updateTabTitle(int index)
+{
+    const DocumentHandle *handle = documents[index];
+    const QString filePath = handle->filePath();
+    const QString name = filePath.isEmpty() ? QString("untitled.txt") : QFileInfo(filePath).fileName();
+    tabBar->setTabText(index, handle->isModified() ? name + "*" : name);
+    tabBar->setTabToolTip(index, QDir::toNativeSeparators(filePath));
+}
+
+CodeEditor *MainWindow::createEditor()
+{
+    CodeEditor *editor = new CodeEditor;
+    editor->setFont(editorFont);
+    editor->setLineNumbersVisible(actionToggleLineNumbers->isChecked());
+    editor->setMinimapVisible(actionToggleMinimap->isChecked());
+    editor->setSaveScheduler(saveScheduler);
+    // The first document shows as plain text until completeStartup()
+    editor->setAnalysisDeferred(!startupComplete);
+    editorStack->addWidget(editor);
+    return editor;
+}
+
+// Points the window, its actions and the session at another editor
+void MainWindow::attachEditor(CodeEditor *editor)
+{
+    for (const QMetaObject::Connection &connection : std::as_const(editorConnections))
+        disconnect(connection);
+    editorConnections.clear();
+    textEdit = editor;
+    
+    editorConnections << connect(textEdit, &CodeEditor::textChanged, this, &MainWindow::handleTextChange)
+                      << connect(textEdit->document(), &QTextDocument::modificationChanged,
+                                 this, &MainWindow::documentWasModified)
+                      << connect(textEdit->document(), &QTextDocument::undoAvailable,
+                                 ui->actionUndo, &QAction::setEnabled)
+                      << connect(textEdit->document(), &QTextDocument::redoAvailable,
+                                 ui->actionRedo, &QAction::setEnabled);
+    if (findDialog) {
+        editorConnections << connect(textEdit, &CodeEditor::searchPatternError,
+                                     findDialog, &FindDialog::showMessage)
+                          << connect(textEdit, &CodeEditor::replaceAllFinished,
+                                     findDialog, &FindDialog::showReplaceSummary)
+                          << connect(textEdit, &CodeEditor::searchResultsChanged,
+                                     findDialog, &FindDialog::setMatchCount);
+    }
+    ui->actionUndo->setEnabled(textEdit->document()->isUndoAvailable());
+    ui->actionRedo->setEnabled(textEdit->document()->isRedoAvailable());
+    sessionManager->setEditor(textEdit);
+}
+
+void MainWindow::activateDocument(int index)
+{
+    if (index < 0 || index >= documents.size() || index == activeDocument)
+        return;
+    
+    DocumentHandle *handle = documents[index];
+    if (handle->isLoaded()) {
+        // Still has its editor, undo history and layout; only the view changes
+        switchToDocument(index);
+        setLongLineMode(false);
+        updateCurrentFile();
+        updateWordCount();
+        return;
+    }
+    
+    const DocumentState &state = handle->savedState();
+    QString text;
+    if (state.modified && !state.unsavedText.isNull()) {
+        text = state.unsavedText;
+    } else if (state.modified && !sessionManager->loadDocumentContent(state, &text)) {
+        // Opening empty but modified would let the next session save replace the text for good
+        const QString name = state.filePath.isEmpty() ? QString("untitled.txt") : QFileInfo(state.filePath).fileName();
+        QMessageBox::warning(this, tr("Text Editor"),
+                             tr("The unsaved changes to %1 could not be restored. "
+                                "Showing the file as it was last saved.").arg(name));
+        handle->setModified(false);
+        if (!state.filePath.isEmpty())
+            readFile(state.filePath, &text);
+    } else if (!state.modified && !state.filePath.isEmpty()) {
+        readFile(state.filePath, &text);
+    }
+    switchToDocument(index);
+    showDocument(index, text);
+}
+
+void MainWindow::switchToDocument(int index)
+{
+    const int previous = activeDocument;
+    const bool previousLongLines = isLongLineMode();
+    DocumentHandle *handle = documents[index];
+    if (!handle->isLoaded())
+        handle->attach(createEditor());
+    handle->lastShown = ++showCounter;
+    activeDocument = index;
+    attachEditor(handle->editor());
+    
+    {
+        const QSignalBlocker blocker(tabBar);
+        tabBar->setCurrentIndex(index);
+    }
+    if (previous >= 0 && previous != index) {
+        // The long-line view holds one text only, so that document is reread when shown again
+        if (previousLongLines)
+            documents[previous]->unload();
+        updateTabTitle(previous);
+    }
+}
+
+// Unloads the least recently shown documents until the loaded ones fit the budget
+void MainWindow::trimLoadedDocuments()
+{
+    for (;;) {
+        int loaded = 0;
+        qsizetype size = 0;
+        DocumentHandle *oldest = nullptr;
+        for (int i = 0; i < documents.size(); ++i) {
+            DocumentHandle *handle = documents[i];
+            if (!handle->isLoaded())
+                continue;
+            ++loaded;
+            size += handle->loadedSize();
+            if (i != activeDocument && (!oldest || handle->lastShown < oldest->lastShown))
+                oldest = handle;
+        }
+        if (!oldest || (loaded <= MAX_LOADED_DOCUMENTS && size <= LOADED_TEXT_BUDGET))
+            return;
+        oldest->unload();
+    }
+}
+
+void MainWindow::showDocument(int index, const QString &text)
+{
+    DocumentHandle *handle = documents[index];
+    const DocumentState state = handle->savedState();
+    QApplication::setOverrideCursor(Qt::WaitCursor);
+    // Huge lines would make the editor lay out and shape them whole. Unsaved
+    // text stays in the editor: the read-only view could not keep it modified
+    const bool longLines = !state.modified && LongLineView::needsLongLineMode(text);
+    if (longLines) {
+        longLineView->setText(text);
+        textEdit->setDocumentText(QString());
+    } else {
+        textEdit->setDocumentText(text);
+        longLineView->clear();
+    }
+    setLongLineMode(longLines);
+
+    // Enable syntax highlighting based on file extension
+    QFileInfo fileInfo(state.filePath);
+    textEdit->setLanguage(fileInfo.suffix().toLower());
+    
+    if (!longLines) {
+        textEdit->restoreFolds(state.foldedBlocks);
+        QTextCursor cursor = textEdit->textCursor();
+        cursor.setPosition(qBound(0, state.cursorPosition, textEdit->document()->characterCount() - 1));
+        textEdit->setTextCursor(cursor);
+        textEdit->verticalScrollBar()->setValue(state.scrollPosition);
+    }
+    QApplication::restoreOverrideCursor();
+    
+    handle->releaseSavedText();
+    textEdit->document()->setModified(state.modified);
+    updateCurrentFile();
+    updateWordCount();
+    trimLoadedDocuments();
+}
+
+bool MainWindow::closeDocument(int index)
+{
+    if (index < 0 || index >= documents.size())
+        return false;
+    
+    // Unsaved changes are shown before asking about them
+    DocumentHandle *handle = documents[index];
+    if (index != activeDocument && handle->isModified())
+        activateDocument(index);
+    if (index == activeDocument && !maybeSave())
+        return false;
+    
+    {
+        const QSignalBlocker blocker(tabBar);
+        tabBar->removeTab(index);
+    }
+    documents.removeAt(index);
+    if (index == activeDocument) {
+        // Another editor takes over before this one goes away
+        activeDocument = -1;
+        if (documents.isEmpty())
+            addDocument(DocumentState());
+        activateDocument(tabBar->currentIndex());
+    } else if (index < activeDocument) {
+        --activeDocument;
+    }
+    
+    const QString filePath = handle->filePath();
+    delete handle;
+    if (!filePath.isEmpty())
+        emit documentClosed(filePath);
+    return true;
 }
 
 void MainWindow::loadFile(const QString &fileName)
+{
+    const int existing = findDocument(fileName);
+    if (existing >= 0) {
+        activateDocument(existing);
+        return;
+    }
+    
+    QString text;
+    if (!readFile(fileName, &text))
+        return;
+    
+    DocumentState state;
+    state.filePath = fileName;
+    // A blank untitled tab is reused instead of being left behind
+    const bool blank = isActiveDocumentBlank();
+    const int index = blank ? activeDocument : addDocument(state);
+    if (blank)
+        documents[index]->setFilePath(fileName);
+    switchToDocument(index);
+    showDocument(index, text);
+    statusBar()->showMessage(isLongLineMode() ? tr("File has very long lines; opened read-only")
+                                              : tr("File loaded"), 2000);
+}
+
+bool MainWindow::readFile(const QString &fileName, QString *text)
 {
     QFile file(fileName);
     if (!file.open(QFile::ReadOnly | QFile::Text)) {
@@ -117,26 +479,20 @@ void MainWindow::loadFile(const QString &fileName)
                            tr("Cannot read file %1:\n%2.")
                            .arg(QDir::toNativeSeparators(fileName),
                                file.errorString()));
-        return;
+        return false;
     }
 
     QTextStream in(&file);
     QApplication::setOverrideCursor(Qt::WaitCursor);
-    textEdit->setPlainText(in.readAll());
+    *text = in.readAll();
     QApplication::restoreOverrideCursor();
-
-    // Enable syntax highlighting based on file extension
-    QFileInfo fileInfo(fileName);
-    textEdit->setLanguage(fileInfo.suffix().toLower());
-
-    setCurrentFile(fileName);
-    statusBar()->showMessage(tr("File loaded"), 2000);
-    updateWordCount();
+    return true;
 }
 
 bool MainWindow::saveFile(const QString &fileName)
 {
-    QFile file(fileName);
+    // Written to a temporary file and renamed over the original on commit
+    QSaveFile file(fileName);
     if (!file.open(QFile::WriteOnly | QFile::Text)) {
         QMessageBox::warning(this, tr("Text Editor"),
                            tr("Cannot write file %1:\n%2.")
@@ -146,8 +502,19 @@ bool MainWindow::saveFile(const QString &fileName)
     }
     
     QTextStream out(&file);
-    out << textEdit->toPlainText();
+    out << (isLongLineMode() ? longLineView->text() : textEdit->toPlainText());
+    out.flush();
+    if (!file.commit()) {
+        QMessageBox::warning(this, tr("Text Editor"),
+                           tr("Cannot write file %1:\n%2.")
+                           .arg(fileName)
+                           .arg(file.errorString()));
+        return false;
+    }
     
+    if (findInFilesPanel)
+        findInFilesPanel->notifyFileSaved(fileName);
+    saveScheduler->service()->forget(fileName);
     setCurrentFile(fileName);
     statusBar()->showMessage(tr("File saved"), 2000);
     return true;
@@ -182,28 +549,36 @@ void MainWindow::createActions()
     connect(ui->actionSaveAs, &QAction::triggered, this, [this]() { saveFileAs(); });
     ui->actionSaveAs->setShortcut(QKeySequence::SaveAs);
     
+    actionCloseTab = new QAction(tr("Close Tab"), this);
+    actionCloseTab->setShortcut(QKeySequence::Close);
+    connect(actionCloseTab, &QAction::triggered, this, [this]() { closeDocument(activeDocument); });
+    
     connect(ui->actionExit, &QAction::triggered, this, &QWidget::close);
     ui->actionExit->setShortcut(QKeySequence::Quit);
     
-    // Edit menu actions
-    connect(ui->actionUndo, &QAction::triggered, textEdit, &CodeEditor::undo);
+    // Edit menu actions; they act on whichever editor is active
+    connect(ui->actionUndo, &QAction::triggered, this, [this]() { textEdit->undo(); });
     ui->actionUndo->setShortcut(QKeySequence::Undo);
     
-    connect(ui->actionRedo, &QAction::triggered, textEdit, &CodeEditor::redo);
+    connect(ui->actionRedo, &QAction::triggered, this, [this]() { textEdit->redo(); });
     ui->actionRedo->setShortcut(QKeySequence::Redo);
     
-    connect(ui->actionCut, &QAction::triggered, textEdit, &CodeEditor::cut);
+    connect(ui->actionCut, &QAction::triggered, this, [this]() { textEdit->cut(); });
     ui->actionCut->setShortcut(QKeySequence::Cut);
     
-    connect(ui->actionCopy, &QAction::triggered, textEdit, &CodeEditor::copy);
+    connect(ui->actionCopy, &QAction::triggered, this, [this]() { textEdit->copy(); });
     ui->actionCopy->setShortcut(QKeySequence::Copy);
     
-    connect(ui->actionPaste, &QAction::triggered, textEdit, &CodeEditor::paste);
+    connect(ui->actionPaste, &QAction::triggered, this, [this]() { textEdit->paste(); });
     ui->actionPaste->setShortcut(QKeySequence::Paste);
     
     connect(ui->actionFind, &QAction::triggered, this, &MainWindow::showFindDialog);
     ui->actionFind->setShortcut(QKeySequence::Find);
     
+    actionFindInFiles = new QAction(tr("Find in Files..."), this);
+    actionFindInFiles->setShortcut(QKeySequence(Qt::CTRL | Qt::SHIFT | Qt::Key_F));
+    connect(actionFindInFiles, &QAction::triggered, this, &MainWindow::showFindInFiles);
+    
     connect(ui->actionAutoCorrect, &QAction::triggered, this, &MainWindow::showAutoCorrectDialog);
     
     // View menu actions
@@ -221,19 +596,39 @@ void MainWindow::createActions()
     actionToggleLineNumbers->setChecked(true);
     actionToggleLineNumbers->setShortcut(QKeySequence(Qt::CTRL | Qt::Key_L));
     
-    connect(actionZoomIn, &QAction::triggered, textEdit, [this]() {
-        QFont f = textEdit->font();
-        f.setPointSize(f.pointSize() + 1);
-        textEdit->setFont(f);
+    actionToggleMinimap = new QAction(tr("Show Minimap"), this);
+    actionToggleMinimap->setCheckable(true);
+    actionToggleMinimap->setChecked(true);
+    
+    // View settings apply to every loaded editor; createEditor() gives them to new ones
+    connect(actionZoomIn, &QAction::triggered, this, [this]() {
+        editorFont.setPointSize(editorFont.pointSize() + 1);
+        for (DocumentHandle *handle : std::as_const(documents))
+            if (handle->isLoaded())
+                handle->editor()->setFont(editorFont);
+    });
+    connect(actionZoomOut, &QAction::triggered, this, [this]() {
+        editorFont.setPointSize(qMax(editorFont.pointSize() - 1, 6));
+        for (DocumentHandle *handle : std::as_const(documents))
+            if (handle->isLoaded())
+                handle->editor()->setFont(editorFont);
+    });
+    connect(actionZoomReset, &QAction::triggered, this, [this]() {
+        textEdit->resetZoom();
+        editorFont = textEdit->font();
+        for (DocumentHandle *handle : std::as_const(documents))
+            if (handle->isLoaded())
+                handle->editor()->setFont(editorFont);
     });
-    connect(actionZoomOut, &QAction::triggered, textEdit, [this]() {
-        QFont f = textEdit->font();
-        f.setPointSize(qMax(f.pointSize() - 1, 6));
-        textEdit->setFont(f);
+    connect(actionToggleLineNumbers, &QAction::triggered, this, [this](bool checked) {
+        for (DocumentHandle *handle : std::as_const(documents))
+            if (handle->isLoaded())
+                handle->editor()->setLineNumbersVisible(checked);
     });
-    connect(actionZoomReset, &QAction::triggered, textEdit, &CodeEditor::resetZoom);
-    connect(actionToggleLineNumbers, &QAction::triggered, textEdit, [this](bool checked) {
-        textEdit->setLineNumbersVisible(checked);
+    connect(actionToggleMinimap, &QAction::triggered, this, [this](bool checked) {
+        for (DocumentHandle *handle : std::as_const(documents))
+            if (handle->isLoaded())
+                handle->editor()->setMinimapVisible(checked);
     });
     
     // Tools menu actions
@@ -249,10 +644,20 @@ void MainWindow::createActions()
     actionUnfoldAll = new QAction(tr("Unfold All"), this);
     actionUnfoldAll->setShortcut(QKeySequence(Qt::CTRL | Qt::SHIFT | Qt::Key_BracketRight));
     
-    connect(actionSettings, &QAction::triggered, textEdit, &CodeEditor::showSettingsDialog);
-    connect(actionToggleFolding, &QAction::triggered, textEdit, &CodeEditor::toggleFold);
-    connect(actionFoldAll, &QAction::triggered, textEdit, &CodeEditor::foldAll);
-    connect(actionUnfoldAll, &QAction::triggered, textEdit, &CodeEditor::unfoldAll);
+    connect(actionSettings, &QAction::triggered, this, [this]() { textEdit->showSettingsDialog(); });
+    connect(actionToggleFolding, &QAction::triggered, this, [this]() { textEdit->toggleFold(); });
+    connect(actionFoldAll, &QAction::triggered, this, [this]() { textEdit->foldAll(); });
+    connect(actionUnfoldAll, &QAction::triggered, this, [this]() { textEdit->unfoldAll(); });
+    
+    actionShowProfiler = new QAction(tr("Show Profiler"), this);
+    actionShowProfiler->setCheckable(true);
+    actionShowProfiler->setShortcut(QKeySequence(Qt::CTRL | Qt::ALT | Qt::Key_P));
+    
+    actionExportTrace = new QAction(tr("Export Profiler Trace..."), this);
+    actionExportTrace->setEnabled(false);
+    
+    connect(actionShowProfiler, &QAction::toggled, this, &MainWindow::toggleProfiler);
+    connect(actionExportTrace, &QAction::triggered, this, &MainWindow::exportProfilerTrace);
     
     // Help menu actions
     connect(ui->actionAbout, &QAction::triggered, this, &MainWindow::about);
@@ -261,13 +666,7 @@ void MainWindow::createActions()
     actionAboutQt = new QAction(tr("About Qt"), this);
     connect(actionAboutQt, &QAction::triggered, qApp, &QApplication::aboutQt);
     
-    // Update Undo/Redo state
-    connect(textEdit->document(), &QTextDocument::undoAvailable,
-            ui->actionUndo, &QAction::setEnabled);
-    connect(textEdit->document(), &QTextDocument::redoAvailable,
-            ui->actionRedo, &QAction::setEnabled);
-    
-    // Initialize Undo/Redo state
+    // Initialize Undo/Redo state; attachEditor() keeps it current
     ui->actionUndo->setEnabled(false);
     ui->actionRedo->setEnabled(false);
 }
@@ -275,17 +674,25 @@ void MainWindow::createActions()
 void MainWindow::createMenus()
 {
     // Add actions to existing menus from the UI file
+    ui->menuFile->insertAction(ui->actionExit, actionCloseTab);
+    
+    ui->menuEdit->addAction(actionFindInFiles);
+    
     ui->menuView->addAction(actionZoomIn);
     ui->menuView->addAction(actionZoomOut);
     ui->menuView->addAction(actionZoomReset);
     ui->menuView->addSeparator();
     ui->menuView->addAction(actionToggleLineNumbers);
+    ui->menuView->addAction(actionToggleMinimap);
     
     ui->menuTools->addAction(actionSettings);
     ui->menuTools->addSeparator();
     ui->menuTools->addAction(actionToggleFolding);
     ui->menuTools->addAction(actionFoldAll);
     ui->menuTools->addAction(actionUnfoldAll);
+    ui->menuTools->addSeparator();
+    ui->menuTools->addAction(actionShowProfiler);
+    ui->menuTools->addAction(actionExportTrace);
     
     ui->menuHelp->addAction(actionAboutQt);
     
@@ -298,6 +705,32 @@ void MainWindow::createMenus()
     menuBar()->addMenu(ui->menuHelp);
 }
 
+void MainWindow::toggleProfiler(bool enabled)
+{
+    // Scopes only start timing once the profiler is on, so it costs nothing until then
+    Profiler::setEnabled(enabled);
+    profilerOverlay->setVisible(enabled);
+    actionExportTrace->setEnabled(enabled);
+}
+
+void MainWindow::exportProfilerTrace()
+{
+    QString fileName = QFileDialog::getSaveFileName(this, tr("Export Profiler Trace"),
+                                                    QDir::home().filePath("toast-trace.json"),
+                                                    tr("Trace Files (*.json)"));
+    if (fileName.isEmpty())
+        return;
+
+    QString error;
+    if (!Profiler::exportChromeTrace(fileName, &error)) {
+        QMessageBox::warning(this, tr("Text Editor"),
+                             tr("Cannot write file %1:\n%2.")
+                             .arg(QDir::toNativeSeparators(fileName), error));
+        return;
+    }
+    statusBar()->showMessage(tr("Profiler trace exported"), 2000);
+}
+
 void MainWindow::showAutoCorrectDialog()
 {
     if (!autocorrectDialog) {
@@ -317,6 +750,7 @@ void MainWindow::toggleAutoCorrect()
 
 void MainWindow::handleTextChange()
 {
+    PROFILE_SCOPE(WindowTextChange);
     updateWordCount();
     
     if (!autoCorrectEnabled)
@@ -375,24 +809,43 @@ QString MainWindow::applyAutocorrect(const QString &text)
 
 void MainWindow::newFile()
 {
-    if (maybeSave()) {
-        textEdit->clear();
-        setCurrentFile(QString());
-    }
+    const int index = addDocument(DocumentState());
+    switchToDocument(index);
+    showDocument(index, QString());
 }
 
 void MainWindow::openFile()
 {
-    if (maybeSave()) {
-        QString fileName = QFileDialog::getOpenFileName(this,
-            tr("Open File"), QDir::currentPath(),
-            tr("Text Files (*.txt);;C++ Files (*.cpp *.h);;All Files (*)"),
-            nullptr,
-            QFileDialog::DontUseNativeDialog);
-        if (!fileName.isEmpty()) {
+    QString fileName = QFileDialog::getOpenFileName(this,
+        tr("Open File"), QDir::currentPath(),
+        tr("Text Files (*.txt);;C++ Files (*.cpp *.h);;All Files (*)"),
+        nullptr,
+        QFileDialog::DontUseNativeDialog);
+    if (!fileName.isEmpty()) {
+        loadFile(fileName);
+    }
+}
+
+// Files handed over from the command line or another launch
+void MainWindow::openFiles(const QStringList &files)
+{
+    for (const QString &fileName : files) {
+        if (QFileInfo::exists(fileName)) {
             loadFile(fileName);
+        } else if (findDocument(fileName) < 0) {
+            // A new file, created on the first save
+            DocumentState state;
+            state.filePath = fileName;
+            const int index = addDocument(state);
+            switchToDocument(index);
+            showDocument(index, QString());
         }
     }
+    
+    if (isMinimized())
+        showNormal();
+    raise();
+    activateWindow();
 }
 
 bool MainWindow::saveFile()
@@ -423,12 +876,30 @@ void MainWindow::about()
 
 void MainWindow::setupEditor()
 {
-    QFont font;
-    font.setFamily("Courier");
-    font.setFixedPitch(true);
-    font.setPointSize(10);
+    // Loaded editors follow font changes themselves; this is for new ones and the long-line view
+    auto applyFont = [this]() {
+        editorFont = SettingsStore::instance().font();
+        editorFont.setFixedPitch(true);
+        longLineView->setFont(editorFont);
+    };
+    applyFont();
+    SettingsStore::instance().subscribe(this, {SettingsStore::FontFamily, SettingsStore::FontSize}, applyFont);
+}
+
+void MainWindow::setLongLineMode(bool enabled)
+{
+    editorStack->setCurrentWidget(enabled ? static_cast<QWidget *>(longLineView) : textEdit);
+    // The long-line view is read-only and the hidden editor must not be changed
+    if (findDialog)
+        findDialog->setReplaceEnabled(!enabled);
     
-    textEdit->setFont(font);
+    // The long-line view is read-only, so there is nothing unsaved to dump
+    CrashHandler::registerDocument(enabled ? nullptr : &textEdit->documentSnapshot());
+}
+
+bool MainWindow::isLongLineMode() const
+{
+    return editorStack->currentWidget() == longLineView;
 }
 
 bool MainWindow::maybeSave()
@@ -461,6 +932,25 @@ void MainWindow::showFindDialog()
                 this, &MainWindow::findNext);
         connect(findDialog, &FindDialog::findPrevious,
                 this, &MainWindow::findPrevious);
+        connect(findDialog, &FindDialog::searchTextEdited,
+                this, &MainWindow::incrementalFind);
+        connect(findDialog, &FindDialog::replaceRequested, this, [this]() {
+            if (isLongLineMode())
+                return;
+            textEdit->replace(findDialog->searchText(), findDialog->replaceText(),
+                              findDialog->caseSensitive(), findDialog->wholeWords(),
+                              findDialog->regularExpression());
+        });
+        connect(findDialog, &FindDialog::replaceAllRequested, this, [this]() {
+            if (isLongLineMode())
+                return;
+            textEdit->replaceAll(findDialog->searchText(), findDialog->replaceText(),
+                                 findDialog->caseSensitive(), findDialog->wholeWords(),
+                                 findDialog->regularExpression());
+        });
+        // Connects the editor's search signals to the new dialog
+        attachEditor(textEdit);
+        findDialog->setReplaceEnabled(!isLongLineMode());
     }
     
     findDialog->show();
@@ -468,6 +958,83 @@ void MainWindow::showFindDialog()
     findDialog->activateWindow();
 }
 
+void MainWindow::showFindInFiles()
+{
+    if (!findInFilesPanel) {
+        findInFilesPanel = new FindInFilesPanel(this);
+        addDockWidget(Qt::BottomDockWidgetArea, findInFilesPanel);
+        connect(findInFilesPanel, &FindInFilesPanel::openLocation,
+                this, &MainWindow::openSearchResult);
+        connect(findInFilesPanel, &FindInFilesPanel::filesReplaced,
+                this, &MainWindow::reloadReplacedFiles);
+        if (!currentFile.isEmpty())
+            findInFilesPanel->setRootPath(QFileInfo(currentFile).absolutePath());
+    }
+
+    findInFilesPanel->show();
+    findInFilesPanel->raise();
+    findInFilesPanel->focusSearch();
+}
+
+void MainWindow::openSearchResult(const QString &filePath, int line, int column, int length)
+{
+    if (QFileInfo(filePath) != QFileInfo(currentFile)) {
+        loadFile(filePath);
+        if (QFileInfo(filePath) != QFileInfo(currentFile))
+            return;
+    }
+
+    if (isLongLineMode()) {
+        const qsizetype start = longLineView->positionOf(line - 1, column);
+        longLineView->select(start, start + length);
+        longLineView->setFocus();
+        return;
+    }
+
+    QTextBlock block = textEdit->document()->findBlockByNumber(line - 1);
+    if (!block.isValid())
+        return;
+    const int start = block.position() + qMin(column, block.length() - 1);
+    QTextCursor cursor(textEdit->document());
+    cursor.setPosition(start);
+    cursor.setPosition(qMin(start + length, textEdit->document()->characterCount() - 1),
+                       QTextCursor::KeepAnchor);
+    textEdit->setTextCursor(cursor);
+    textEdit->centerCursor();
+    textEdit->setFocus();
+}
+
+void MainWindow::reloadReplacedFiles(const QStringList &files)
+{
+    bool replaced = false;
+    for (const QString &filePath : files) {
+        const int index = findDocument(filePath);
+        if (index == activeDocument) {
+            replaced = true;
+        } else if (index >= 0 && !documents[index]->isModified()) {
+            // Reread from disk the next time its tab is shown
+            documents[index]->unload();
+        }
+    }
+    if (!replaced || currentFile.isEmpty())
+        return;
+
+    if (textEdit->document()->isModified()) {
+        QMessageBox::warning(this, tr("Text Editor"),
+                           tr("%1 was changed by Replace in Files, but has unsaved edits here.\n"
+                              "Saving will overwrite the replacements.")
+                           .arg(QDir::toNativeSeparators(currentFile)));
+        return;
+    }
+
+    QString text;
+    if (!readFile(currentFile, &text))
+        return;
+    // Keeps the cursor, scroll position and folds where they were
+    documents[activeDocument]->storeState();
+    showDocument(activeDocument, text);
+}
+
 void MainWindow::findNext()
 {
     if (findDialog) {
@@ -482,6 +1049,14 @@ void MainWindow::findPrevious()
     }
 }
 
+void MainWindow::incrementalFind()
+{
+    if (findDialog) {
+        textEdit->incrementalFind(findDialog->searchText(), findDialog->caseSensitive(),
+                                  findDialog->wholeWords(), findDialog->regularExpression());
+    }
+}
+
 bool MainWindow::find(const QString &searchString, bool forward)
 {
     if (searchString.isEmpty()) {
@@ -489,31 +1064,24 @@ bool MainWindow::find(const QString &searchString, bool forward)
         return false;
     }
 
-    QTextDocument::FindFlags flags;
-    if (findDialog && findDialog->caseSensitive())
-        flags |= QTextDocument::FindCaseSensitively;
-    if (findDialog && findDialog->wholeWords())
-        flags |= QTextDocument::FindWholeWords;
-    if (!forward)
-        flags |= QTextDocument::FindBackward;
-
-    QTextCursor cursor = textEdit->textCursor();
-    QTextCursor found = textEdit->document()->find(searchString, cursor, flags);
-
-    if (found.isNull()) {
-        // If not found, try from the beginning/end
-        cursor = QTextCursor(textEdit->document());
-        if (!forward)
-            cursor.movePosition(QTextCursor::End);
-        found = textEdit->document()->find(searchString, cursor, flags);
-        
-        if (found.isNull()) {
+    bool caseSensitive = findDialog && findDialog->caseSensitive();
+    bool wholeWords = findDialog && findDialog->wholeWords();
+    bool regularExpression = findDialog && findDialog->regularExpression();
+    if (isLongLineMode()) {
+        SearchOptions options;
+        options.caseSensitive = caseSensitive;
+        options.wholeWords = wholeWords;
+        options.regularExpression = regularExpression;
+        if (!longLineView->find(searchString, options, !forward, true)) {
             statusBar()->showMessage(tr("'%1' not found").arg(searchString), 2000);
             return false;
         }
+        return true;
+    }
+    if (!textEdit->find(searchString, caseSensitive, wholeWords, !forward, true, regularExpression)) {
+        statusBar()->showMessage(tr("'%1' not found").arg(searchString), 2000);
+        return false;
     }
-
-    textEdit->setTextCursor(found);
     return true;
 }
 
@@ -527,4 +1095,6 @@ void MainWindow::updateWordCount()
 void MainWindow::documentWasModified()
 {
     setWindowModified(textEdit->document()->isModified());
+    if (activeDocument >= 0)
+        updateTabTitle(activeDocument);
 } 
\ No newline at end of file
@@ -0,0 +1,352 @@
+#include "minimap.h"
+#include "syntax/syntaxhighlighter.h"
+#include <QPlainTextEdit>
+#include <QScrollBar>
+#include <QPainter>
+#include <QMouseEvent>
+#include <QTextDocument>
+#include <QTextBlock>
+#include <QVarLengthArray>
+#include <algorithm>
+
+Minimap::Minimap(QPlainTextEdit *editor, SyntaxHighlighter *highlighter)
+    : QWidget(editor), editor(editor), document(editor->document()), highlighter(highlighter),
+      lastBlockCount(document->blockCount()), dirtyFirst(-1), dirtyLast(-1), fullRender(true),
+      structureSerial(0), rendering(false)
+{
+    renderPool.setMaxThreadCount(1);
+
+    // Coalesce bursts of edits into one render
+    renderTimer = new QTimer(this);
+    renderTimer->setSingleShot(true);
+    renderTimer->setInterval(100);
+    connect(renderTimer, &QTimer::timeout, this, &Minimap::startRender);
+
+    connect(document, &QTextDocument::contentsChange, this, &Minimap::handleContentsChange);
+    connect(editor->verticalScrollBar(), &QScrollBar::valueChanged, this, [this]() { update(); });
+
+    setCursor(Qt::PointingHandCursor);
+    lineCells.resize(lastBlockCount);
+    updateColors();
+    markDirty(0, lastBlockCount - 1);
+}
+
+Minimap::~Minimap()
+{
+    renderPool.waitForDone();
+}
+
+QSize Minimap::sizeHint() const
+{
+    return QSize(MINIMAP_WIDTH, 0);
+}
+
+void Minimap::updateColors()
+{
+    const QColor plain = editor->palette().color(QPalette::Text);
+    colors.clear();
+    for (int i = 0; i < int(TokenClass::Count); ++i) {
+        QColor color = highlighter ? highlighter->tokenColor(TokenClass(i)) : QColor();
+        if (!color.isValid())
+            color = plain;
+        color.setAlpha(170);
+        colors.append(qPremultiply(color.rgba()));
+    }
+    fullRender = true;
+    renderTimer->start();
+}
+
+void Minimap::setSearchMatchLines(const QVector<int> &lines)
+{
+    matchLines = lines;
+    rebuildOverlay();
+    update();
+}
+
+void Minimap::setFoldedRegions(const QVector<QPair<int, int>> &regions)
+{
+    folds = regions;
+    rebuildOverlay();
+    update();
+}
+
+void Minimap::handleContentsChange(int position, int charsRemoved, int charsAdded)
+{
+    Q_UNUSED(charsRemoved);
+    const int blockCount = document->blockCount();
+    const int first = document->findBlock(position).blockNumber();
+    const int last = qMax(first, document->findBlock(position + charsAdded).blockNumber());
+
+    // Keep one cell row per block; inserted and removed lines follow 'first'
+    const int delta = blockCount - lastBlockCount;
+    if (delta > 0) {
+        lineCells.insert(qMin(first + 1, int(lineCells.size())), delta, QByteArray());
+    } else if (delta < 0) {
+        const int from = qMin(first + 1, int(lineCells.size()));
+        lineCells.remove(from, qMin(-delta, int(lineCells.size()) - from));
+    }
+    if (delta != 0) {
+        ++structureSerial;
+        lastBlockCount = blockCount;
+        fullRender = true;
+    }
+    lineCells.resize(blockCount);
+    markDirty(first, last);
+}
+
+void Minimap::markDirty(int firstLine, int lastLine)
+{
+    if (dirtyFirst < 0) {
+        dirtyFirst = firstLine;
+        dirtyLast = lastLine;
+    } else {
+        dirtyFirst = qMin(dirtyFirst, firstLine);
+        dirtyLast = qMax(dirtyLast, lastLine);
+    }
+    if (!rendering)
+        renderTimer->start();
+}
+
+void Minimap::startRender()
+{
+    if (rendering || (dirtyFirst < 0 && !fullRender))
+        return;
+
+    // Only the text and token runs of dirty lines are copied on this thread,
+    // a bounded number at a time so a freshly loaded file streams in
+    const int lineCount = document->blockCount();
+    QVector<SourceLine> lines;
+    int first = -1;
+    int last = -1;
+    if (dirtyFirst >= 0 && dirtyFirst < lineCount) {
+        first = dirtyFirst;
+        last = qMin(qMin(dirtyLast, lineCount - 1), first + MAX_LINES_PER_RENDER - 1);
+        lines.reserve(last - first + 1);
+        QTextBlock block = document->findBlockByNumber(first);
+        for (int i = first; i <= last && block.isValid(); ++i, block = block.next()) {
+            SourceLine line;
+            line.text = block.text().left(MAX_SOURCE_CHARS);
+            if (BlockData *data = BlockData::of(block))
+                line.tokens = data->tokens;
+            lines.append(line);
+        }
+        if (last >= qMin(dirtyLast, lineCount - 1))
+            dirtyFirst = dirtyLast = -1;
+        else
+            dirtyFirst = last + 1;
+    } else {
+        dirtyFirst = dirtyLast = -1;
+    }
+
+    const bool full = fullRender;
+    fullRender = false;
+    rendering = true;
+
+    const quint64 serial = structureSerial;
+    const QVector<QByteArray> cells = lineCells;
+    const QImage base = image;
+    const QVector<QRgb> palette = colors;
+    const QSize displaySize = size();
+    const qreal pixelRatio = devicePixelRatioF();
+    renderPool.start([this, cells, first, last, lines, base, full, palette, displaySize, pixelRatio,
+                      serial]() {
+        RenderResult result = render(cells, first, lines, base, full, palette, displaySize, pixelRatio);
+        result.serial = serial;
+        QMetaObject::invokeMethod(this, [this, result, first, last]() {
+            finishRender(result, first, last);
+        }, Qt::QueuedConnection);
+    });
+}
+
+void Minimap::finishRender(const RenderResult &result, int firstLine, int lastLine)
+{
+    rendering = false;
+
+    if (result.serial != structureSerial) {
+        // Lines moved while the worker ran, so its rows no longer line up
+        if (firstLine >= 0)
+            markDirty(firstLine, qMax(lastLine, document->blockCount() - 1));
+        fullRender = true;
+        renderTimer->start();
+        return;
+    }
+
+    lineCells = result.cells;
+    image = result.image;
+    pixmap = QPixmap::fromImage(result.display);
+    rebuildOverlay();
+    update();
+
+    if (dirtyFirst >= 0 || fullRender)
+        renderTimer->start();
+}
+
+int Minimap::rowCountFor(int lineCount)
+{
+    return qBound(1, lineCount, MAX_ROWS);
+}
+
+QByteArray Minimap::rasteriseLine(const SourceLine &line)
+{
+    QByteArray cells(MINIMAP_WIDTH, 0);
+    const int length = qMin(int(line.text.size()), MAX_SOURCE_CHARS);
+
+    // Cell values are token class + 1, so 0 stays blank
+    QVarLengthArray<char, MAX_SOURCE_CHARS> classes(length);
+    std::fill(classes.begin(), classes.end(), char(int(TokenClass::Plain) + 1));
+    for (const TokenRun &run : line.tokens) {
+        const int end = qMin(length, run.start + run.length);
+        for (int i = qMax(0, run.start); i < end; ++i)
+            classes[i] = char(int(run.tokenClass) + 1);
+    }
+
+    int column = 0;
+    for (int i = 0; i < length && column < MINIMAP_WIDTH; ++i) {
+        const QChar c = line.text.at(i);
+        if (c == QLatin1Char('\t')) {
+            column = (column / 4 + 1) * 4;
+            continue;
+        }
+        if (!c.isSpace())
+            cells[column] = classes[i];
+        ++column;
+    }
+    return cells;
+}
+
+Minimap::RenderResult Minimap::render(QVector<QByteArray> cells, int firstLine,
+                                      const QVector<SourceLine> &lines, QImage image, bool full,
+                                      const QVector<QRgb> &colors, QSize displaySize, qreal pixelRatio)
+{
+    for (int i = 0; i < lines.size() && firstLine + i < cells.size(); ++i)
+        cells[firstLine + i] = rasteriseLine(lines.at(i));
+
+    // Beyond MAX_ROWS lines, each row samples one line of its stretch
+    const qint64 lineCount = qMax<qint64>(1, cells.size());
+    const int rows = rowCountFor(int(lineCount));
+    const QSize size(MINIMAP_WIDTH, rows * LINE_HEIGHT);
+    int firstRow = 0;
+    int lastRow = rows - 1;
+    if (full || image.size() != size) {
+        image = QImage(size, QImage::Format_ARGB32_Premultiplied);
+        image.fill(Qt::transparent);
+    } else if (lines.isEmpty()) {
+        lastRow = -1;
+    } else {
+        firstRow = int(firstLine * rows / lineCount);
+        lastRow = qMin(rows - 1, int((firstLine + lines.size()) * rows / lineCount));
+    }
+
+    for (int row = firstRow; row <= lastRow; ++row) {
+        const int line = int(row * lineCount / rows);
+        if (line >= cells.size())
+            break;
+        const QByteArray &lineCells = cells.at(line);
+        QRgb *pixels = reinterpret_cast<QRgb *>(image.scanLine(row * LINE_HEIGHT));
+        for (int x = 0; x < MINIMAP_WIDTH; ++x) {
+            const int cell = x < lineCells.size() ? quint8(lineCells.at(x)) : 0;
+            pixels[x] = cell > 0 && cell <= colors.size() ? colors.at(cell - 1) : 0;
+        }
+    }
+
+    RenderResult result;
+    const int height = qMax(1, qMin(displaySize.height(), image.height()));
+    const Qt::TransformationMode mode = image.height() > height ? Qt::SmoothTransformation
+                                                                : Qt::FastTransformation;
+    result.display = image.scaled(QSize(qMax(1, displaySize.width()), height) * pixelRatio,
+                                  Qt::IgnoreAspectRatio, mode);
+    result.display.setDevicePixelRatio(pixelRatio);
+    result.cells = cells;
+    result.image = image;
+    result.serial = 0;
+    return result;
+}
+
+int Minimap::displayHeight() const
+{
+    return qMax(1, qMin(height(), rowCountFor(document->blockCount()) * LINE_HEIGHT));
+}
+
+int Minimap::lineAtY(int y) const
+{
+    const qint64 lineCount = document->blockCount();
+    return int(qBound<qint64>(0, qint64(y) * lineCount / displayHeight(), lineCount - 1));
+}
+
+void Minimap::rebuildOverlay()
+{
+    if (matchLines.isEmpty() && folds.isEmpty()) {
+        overlay = QPixmap();
+        return;
+    }
+
+    const qreal pixelRatio = devicePixelRatioF();
+    overlay = QPixmap(size() * pixelRatio);
+    overlay.setDevicePixelRatio(pixelRatio);
+    overlay.fill(Qt::transparent);
+
+    const qint64 lineCount = qMax(1, document->blockCount());
+    const int height = displayHeight();
+    auto yForLine = [lineCount, height](int line) { return int(qint64(line) * height / lineCount); };
+
+    QPainter painter(&overlay);
+    const QColor foldColor(128, 128, 128, 140);
+    for (const QPair<int, int> &fold : folds) {
+        const int top = yForLine(fold.first);
+        painter.fillRect(0, top, 3, qMax(1, yForLine(fold.second + 1) - top), foldColor);
+    }
+
+    const QColor matchColor(255, 160, 0, 200);
+    int lastY = -1;
+    for (int line : matchLines) {
+        const int y = yForLine(line);
+        if (y == lastY)
+            continue;
+        painter.fillRect(0, y, width(), 2, matchColor);
+        lastY = y;
+    }
+}
+
+void Minimap::paintEvent(QPaintEvent *)
+{
+    QPainter painter(this);
+    painter.fillRect(rect(), editor->palette().color(QPalette::Base));
+    if (!pixmap.isNull())
+        painter.drawPixmap(0, 0, pixmap);
+    if (!overlay.isNull())
+        painter.drawPixmap(0, 0, overlay);
+
+    // The box showing what the editor has on screen
+    const QScrollBar *bar = editor->verticalScrollBar();
+    const qint64 lineCount = qMax(1, document->blockCount());
+    const int height = displayHeight();
+    const int top = int(qint64(bar->value()) * height / lineCount);
+    const int bottom = int(qint64(bar->value() + bar->pageStep()) * height / lineCount);
+    painter.fillRect(QRect(0, top, width(), qMax(2, bottom - top)), QColor(128, 128, 128, 60));
+}
+
+void Minimap::resizeEvent(QResizeEvent *event)
+{
+    QWidget::resizeEvent(event);
+    rebuildOverlay();
+    fullRender = true;
+    renderTimer->start();
+}
+
+void Minimap::scrollToY(int y)
+{
+    QScrollBar *bar = editor->verticalScrollBar();
+    bar->setValue(lineAtY(y) - bar->pageStep() / 2);
+}
+
+void Minimap::mousePressEvent(QMouseEvent *event)
+{
+    if (event->button() == Qt::LeftButton)
+        scrollToY(event->pos().y());
+}
+
+void Minimap::mouseMoveEvent(QMouseEvent *event)
+{
+    if (event->buttons() & Qt::LeftButton)
+        scrollToY(event->pos().y());
+}
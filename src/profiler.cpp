@@ -0,0 +1,182 @@
+#include "profiler.h"
+#include <QtCore/QMutex>
+#include <QtCore/QMutexLocker>
+#include <QtCore/QSaveFile>
+#include <QtCore/QThread>
+#include <algorithm>
+
+std::atomic<bool> Profiler::enabled(false);
+
+namespace {
+
+struct TraceEvent {
+    qint64 start;
+    qint64 duration;
+    quintptr thread;
+    ProfileSection section;
+};
+
+struct SectionWindow {
+    qint64 durations[Profiler::WINDOW_SIZE];
+    int next = 0;
+    int filled = 0;
+    qint64 calls = 0;
+};
+
+// Everything is preallocated on first use so recording never allocates
+struct ProfilerState {
+    QMutex mutex;
+    SectionWindow windows[int(ProfileSection::Count)];
+    QVector<TraceEvent> trace;
+    int traceNext = 0;
+    int traceFilled = 0;
+    qint64 origin = 0; // trace timestamps start here
+
+    ProfilerState() { trace.resize(Profiler::MAX_TRACE_EVENTS); }
+};
+
+ProfilerState &state()
+{
+    static ProfilerState instance;
+    return instance;
+}
+
+int bucketFor(qint64 nanoseconds)
+{
+    qint64 micros = nanoseconds / 1000;
+    int bucket = 0;
+    while (micros > 0 && bucket < Profiler::HISTOGRAM_BUCKETS - 1) {
+        micros >>= 1;
+        ++bucket;
+    }
+    return bucket;
+}
+
+} // namespace
+
+void Profiler::setEnabled(bool enable)
+{
+    if (enable && !isEnabled())
+        reset();
+    enabled.store(enable, std::memory_order_relaxed);
+}
+
+void Profiler::reset()
+{
+    ProfilerState &s = state();
+    QMutexLocker locker(&s.mutex);
+    for (SectionWindow &window : s.windows)
+        window = SectionWindow();
+    s.traceNext = 0;
+    s.traceFilled = 0;
+    s.origin = now();
+}
+
+void Profiler::record(ProfileSection section, qint64 start, qint64 end)
+{
+    ProfilerState &s = state();
+    const qint64 duration = end - start;
+    QMutexLocker locker(&s.mutex);
+
+    SectionWindow &window = s.windows[int(section)];
+    window.durations[window.next] = duration;
+    window.next = (window.next + 1) % WINDOW_SIZE;
+    window.filled = qMin(window.filled + 1, int(WINDOW_SIZE));
+    ++window.calls;
+
+    TraceEvent &event = s.trace[s.traceNext];
+    event.start = start;
+    event.duration = duration;
+    event.thread = quintptr(QThread::currentThreadId());
+    event.section = section;
+    s.traceNext = (s.traceNext + 1) % MAX_TRACE_EVENTS;
+    s.traceFilled = qMin(s.traceFilled + 1, int(MAX_TRACE_EVENTS));
+}
+
+const char *Profiler::sectionName(ProfileSection section)
+{
+    switch (section) {
+    case ProfileSection::EditorPaint: return "CodeEditor::paintEvent";
+    case ProfileSection::GutterPaint: return "CodeEditor::lineNumberAreaPaintEvent";
+    case ProfileSection::Highlight: return "SyntaxHighlighter::highlightBlock";
+    case ProfileSection::EditorTextChange: return "CodeEditor::handleTextChanged";
+    case ProfileSection::AutoSave: return "SessionManager::autoSave";
+    case ProfileSection::WindowTextChange: return "MainWindow::handleTextChange";
+    case ProfileSection::Count: break;
+    }
+    return "";
+}
+
+QVector<ProfileStats> Profiler::statistics()
+{
+    ProfilerState &s = state();
+    QVector<ProfileStats> result;
+    for (int i = 0; i < int(ProfileSection::Count); ++i) {
+        ProfileStats stats;
+        stats.name = sectionName(ProfileSection(i));
+        stats.histogram.fill(0, HISTOGRAM_BUCKETS);
+
+        QVector<qint64> durations;
+        {
+            QMutexLocker locker(&s.mutex);
+            const SectionWindow &window = s.windows[i];
+            stats.calls = window.calls;
+            durations.assign(window.durations, window.durations + window.filled);
+        }
+
+        stats.samples = durations.size();
+        if (!durations.isEmpty()) {
+            for (qint64 duration : durations)
+                ++stats.histogram[bucketFor(duration)];
+            std::sort(durations.begin(), durations.end());
+            stats.median = durations.at(durations.size() / 2);
+            stats.p95 = durations.at(qMin(int(durations.size()) - 1, int(durations.size() * 95 / 100)));
+            stats.max = durations.last();
+        }
+        result.append(stats);
+    }
+    return result;
+}
+
+bool Profiler::exportChromeTrace(const QString &filePath, QString *errorMessage)
+{
+    ProfilerState &s = state();
+    QVector<TraceEvent> events;
+    qint64 origin;
+    {
+        QMutexLocker locker(&s.mutex);
+        events.reserve(s.traceFilled);
+        const int first = (s.traceNext - s.traceFilled + MAX_TRACE_EVENTS) % MAX_TRACE_EVENTS;
+        for (int i = 0; i < s.traceFilled; ++i)
+            events.append(s.trace.at((first + i) % MAX_TRACE_EVENTS));
+        origin = s.origin;
+    }
+
+    // Complete ("X") events with microsecond timestamps
+    QByteArray json;
+    json.reserve(events.size() * 110 + 64);
+    json += "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    for (int i = 0; i < events.size(); ++i) {
+        const TraceEvent &event = events.at(i);
+        if (i > 0)
+            json += ',';
+        json += "\n{\"name\":\"";
+        json += sectionName(event.section);
+        json += "\",\"cat\":\"toast\",\"ph\":\"X\",\"pid\":1,\"tid\":";
+        json += QByteArray::number(quint64(event.thread));
+        json += ",\"ts\":";
+        json += QByteArray::number(double(event.start - origin) / 1000.0, 'f', 3);
+        json += ",\"dur\":";
+        json += QByteArray::number(double(event.duration) / 1000.0, 'f', 3);
+        json += '}';
+    }
+    json += "\n]}\n";
+
+    QSaveFile file(filePath);
+    if (!file.open(QIODevice::WriteOnly) || file.write(json) != json.size() || !file.commit()) {
+        if (errorMessage)
+            *errorMessage = file.errorString();
+        return false;
+    }
+    return true;
+}
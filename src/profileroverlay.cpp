@@ -0,0 +1,113 @@
+#include "profileroverlay.h"
+#include <QPainter>
+#include <QEvent>
+#include <QFontDatabase>
+#include <algorithm>
+
+ProfilerOverlay::ProfilerOverlay(QWidget *parent)
+    : QWidget(parent)
+{
+    setAttribute(Qt::WA_TransparentForMouseEvents);
+    setFont(QFontDatabase::systemFont(QFontDatabase::FixedFont));
+
+    refreshTimer = new QTimer(this);
+    refreshTimer->setInterval(250);
+    connect(refreshTimer, &QTimer::timeout, this, &ProfilerOverlay::refresh);
+
+    parent->installEventFilter(this);
+    hide();
+}
+
+void ProfilerOverlay::showEvent(QShowEvent *event)
+{
+    QWidget::showEvent(event);
+    refresh();
+    refreshTimer->start();
+}
+
+void ProfilerOverlay::hideEvent(QHideEvent *event)
+{
+    QWidget::hideEvent(event);
+    refreshTimer->stop();
+}
+
+bool ProfilerOverlay::eventFilter(QObject *watched, QEvent *event)
+{
+    if (watched == parent() && event->type() == QEvent::Resize)
+        reposition();
+    return QWidget::eventFilter(watched, event);
+}
+
+void ProfilerOverlay::refresh()
+{
+    stats = Profiler::statistics();
+    reposition();
+    raise();
+    update();
+}
+
+void ProfilerOverlay::reposition()
+{
+    const QFontMetrics metrics(font());
+    const int textWidth = metrics.horizontalAdvance(QLatin1Char('0')) * 78;
+    const int width = textWidth + Profiler::HISTOGRAM_BUCKETS * BAR_WIDTH + 3 * MARGIN;
+    const int height = (int(ProfileSection::Count) + 1) * ROW_HEIGHT + 2 * MARGIN;
+    const QWidget *area = parentWidget();
+    setGeometry(area->width() - width - MARGIN, MARGIN, width, height);
+}
+
+QString ProfilerOverlay::formatDuration(qint64 nanoseconds)
+{
+    if (nanoseconds >= 1000000)
+        return QString::number(nanoseconds / 1e6, 'f', 2) + QStringLiteral("ms");
+    return QString::number(nanoseconds / 1e3, 'f', 1) + QStringLiteral("us");
+}
+
+void ProfilerOverlay::paintEvent(QPaintEvent *)
+{
+    QPainter painter(this);
+    painter.fillRect(rect(), QColor(20, 20, 20, 210));
+    painter.setPen(QColor(230, 230, 230));
+
+    const QFontMetrics metrics(font());
+    const int histogramLeft = width() - MARGIN - Profiler::HISTOGRAM_BUCKETS * BAR_WIDTH;
+    int y = MARGIN;
+    painter.drawText(QRect(MARGIN, y, histogramLeft - 2 * MARGIN, ROW_HEIGHT), Qt::AlignVCenter,
+                     QStringLiteral("%1 %2 %3 %4 %5")
+                         .arg(QStringLiteral("section"), -38)
+                         .arg(QStringLiteral("calls"), 8)
+                         .arg(QStringLiteral("p50"), 9)
+                         .arg(QStringLiteral("p95"), 9)
+                         .arg(QStringLiteral("max"), 9));
+    painter.drawText(QRect(histogramLeft, y, width() - histogramLeft, ROW_HEIGHT), Qt::AlignVCenter,
+                     QStringLiteral("1us..16ms"));
+    y += ROW_HEIGHT;
+
+    for (const ProfileStats &section : stats) {
+        QString name = QString::fromLatin1(section.name);
+        name = metrics.elidedText(name, Qt::ElideLeft, metrics.horizontalAdvance(QLatin1Char('0')) * 38);
+        painter.setPen(QColor(230, 230, 230));
+        painter.drawText(QRect(MARGIN, y, histogramLeft - 2 * MARGIN, ROW_HEIGHT), Qt::AlignVCenter,
+                         QStringLiteral("%1 %2 %3 %4 %5")
+                             .arg(name, -38)
+                             .arg(section.calls, 8)
+                             .arg(formatDuration(section.median), 9)
+                             .arg(formatDuration(section.p95), 9)
+                             .arg(formatDuration(section.max), 9));
+
+        // Bars are scaled to the fullest bucket; slow buckets turn red
+        const int peak = section.histogram.isEmpty()
+            ? 0 : *std::max_element(section.histogram.begin(), section.histogram.end());
+        for (int bucket = 0; peak > 0 && bucket < section.histogram.size(); ++bucket) {
+            const int count = section.histogram.at(bucket);
+            if (count == 0)
+                continue;
+            const int barHeight = qMax(1, count * (ROW_HEIGHT - 4) / peak);
+            const QColor color = bucket >= FRAME_BUDGET_BUCKET ? QColor(230, 80, 60)
+                                                               : QColor(90, 190, 110);
+            painter.fillRect(histogramLeft + bucket * BAR_WIDTH, y + ROW_HEIGHT - 2 - barHeight,
+                             BAR_WIDTH - 1, barHeight, color);
+        }
+        y += ROW_HEIGHT;
+    }
+}
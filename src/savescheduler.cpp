@@ -0,0 +1,104 @@
+#include "savescheduler.h"
+#include "autosaveservice.h"
+
+SaveScheduler::SaveScheduler(QObject *parent)
+    : QObject(parent)
+{
+    clock.start();
+    timer = new QTimer(this);
+    timer->setSingleShot(true);
+    connect(timer, &QTimer::timeout, this, &SaveScheduler::runDue);
+    saveService = new AutoSaveService(this);
+}
+
+void SaveScheduler::addClient(QObject *client, int maxLatencyMs, const std::function<void()> &save)
+{
+    Client entry;
+    entry.save = save;
+    entry.maxLatency = maxLatencyMs;
+    clients.insert(client, entry);
+    connect(client, &QObject::destroyed, this, [this](QObject *object) {
+        clients.remove(object);
+    });
+}
+
+void SaveScheduler::removeClient(QObject *client)
+{
+    disconnect(client, &QObject::destroyed, this, nullptr);
+    clients.remove(client);
+    reschedule();
+}
+
+void SaveScheduler::setMaxLatency(QObject *client, int maxLatencyMs)
+{
+    auto it = clients.find(client);
+    if (it == clients.end())
+        return;
+    it->maxLatency = maxLatencyMs;
+    reschedule();
+}
+
+void SaveScheduler::markDirty(QObject *client)
+{
+    auto it = clients.find(client);
+    if (it == clients.end())
+        return;
+    const qint64 now = clock.elapsed();
+    if (it->firstDirty < 0)
+        it->firstDirty = now;
+    it->lastEdit = now;
+    reschedule();
+}
+
+void SaveScheduler::saveAll()
+{
+    // Copy first: a save callback may add or remove clients
+    const QList<QObject *> dirty = clients.keys();
+    for (QObject *client : dirty) {
+        auto it = clients.find(client);
+        if (it == clients.end() || it->firstDirty < 0)
+            continue;
+        it->firstDirty = it->lastEdit = -1;
+        const std::function<void()> save = it->save;
+        save();
+    }
+    reschedule();
+}
+
+qint64 SaveScheduler::dueTime(const Client &client) const
+{
+    return qMin(client.lastEdit + IDLE_DELAY, client.firstDirty + client.maxLatency);
+}
+
+void SaveScheduler::runDue()
+{
+    const qint64 now = clock.elapsed();
+    const QList<QObject *> keys = clients.keys();
+    for (QObject *client : keys) {
+        auto it = clients.find(client);
+        if (it == clients.end() || it->firstDirty < 0 || dueTime(*it) > now)
+            continue;
+        it->firstDirty = it->lastEdit = -1;
+        const std::function<void()> save = it->save;
+        save();
+    }
+    reschedule();
+}
+
+void SaveScheduler::reschedule()
+{
+    // One timer for everybody, armed for the earliest due client
+    qint64 earliest = -1;
+    for (const Client &client : std::as_const(clients)) {
+        if (client.firstDirty < 0)
+            continue;
+        const qint64 due = dueTime(client);
+        if (earliest < 0 || due < earliest)
+            earliest = due;
+    }
+    if (earliest < 0) {
+        timer->stop();
+        return;
+    }
+    timer->start(int(qMax<qint64>(0, earliest - clock.elapsed())));
+}
@@ -0,0 +1,373 @@
+#include "search/filesearch.h"
+#include <QtConcurrent/QtConcurrent>
+#include <QtCore/QDir>
+#include <QtCore/QDirIterator>
+#include <QtCore/QFile>
+#include <QtCore/QFileInfo>
+#include <QtCore/QRegularExpression>
+#include <QtCore/QSemaphore>
+#include <QtCore/QStack>
+#include <QtCore/QStringDecoder>
+#include <atomic>
+#include <cstring>
+
+struct FileSearch::State {
+    QString root;
+    QStringList files; // searched instead of walking the tree when useFileList is set
+    bool useFileList = false;
+    QString pattern;
+    QByteArray literalUtf8; // byte-level prefilter for case-sensitive literals
+    SearchOptions options;
+    IgnoreRules ignoreRules;
+    std::atomic<bool> canceled{false};
+    std::atomic<int> hitCount{0};
+    std::atomic<int> filesSearched{0};
+    std::atomic<int> filesSkipped{0}; // too large to search
+
+    bool isStopped() const { return canceled.load(std::memory_order_relaxed); }
+};
+
+namespace {
+
+QStringList readIgnoreFile(const QString &path)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text))
+        return QStringList();
+    return QString::fromUtf8(file.readAll()).split(QLatin1Char('\n'));
+}
+
+}
+
+void IgnoreRules::load(const QString &rootPath)
+{
+    names.clear();
+    paths.clear();
+    addPatterns(FileSearch::defaultIgnorePatterns());
+    addPatterns(readIgnoreFile(rootPath + QStringLiteral("/.gitignore")));
+    addPatterns(readIgnoreFile(rootPath + QStringLiteral("/.toastignore")));
+}
+
+void IgnoreRules::addPatterns(const QStringList &lines)
+{
+    for (QString line : lines) {
+        line = line.trimmed();
+        if (line.isEmpty() || line.startsWith(QLatin1Char('#')) || line.startsWith(QLatin1Char('!')))
+            continue;
+        if (line.endsWith(QLatin1Char('/')))
+            line.chop(1);
+
+        const bool anchored = line.contains(QLatin1Char('/'));
+        if (line.startsWith(QLatin1Char('/')))
+            line.remove(0, 1);
+        const QRegularExpression expression(QRegularExpression::wildcardToRegularExpression(line));
+        if (!expression.isValid())
+            continue;
+        if (anchored)
+            paths.append(expression);
+        else
+            names.append(expression);
+    }
+}
+
+bool IgnoreRules::isIgnored(const QString &name, const QString &relativePath) const
+{
+    for (const QRegularExpression &expression : names) {
+        if (expression.match(name).hasMatch())
+            return true;
+    }
+    for (const QRegularExpression &expression : paths) {
+        if (expression.match(relativePath).hasMatch())
+            return true;
+    }
+    return false;
+}
+
+FileSearch::FileSearch(QObject *parent)
+    : QObject(parent)
+{
+    walkerPool.setMaxThreadCount(1);
+}
+
+FileSearch::~FileSearch()
+{
+    // The walk waits for its batches before it returns, so joining the
+    // walker is enough to know no thread still holds 'this'
+    cancel();
+    walkerPool.waitForDone();
+}
+
+QStringList FileSearch::defaultIgnorePatterns()
+{
+    return {
+        QStringLiteral(".git"), QStringLiteral(".hg"), QStringLiteral(".svn"),
+        QStringLiteral("node_modules"), QStringLiteral("__pycache__"), QStringLiteral(".cache"),
+        QStringLiteral("*.o"), QStringLiteral("*.obj"), QStringLiteral("*.so"), QStringLiteral("*.dll"),
+        QStringLiteral("*.a"), QStringLiteral("*.lib"), QStringLiteral("*.exe"), QStringLiteral("*.pdb")
+    };
+}
+
+void FileSearch::start(const QString &rootPath, const QString &pattern, const SearchOptions &options)
+{
+    cancel();
+
+    QSharedPointer<State> state(new State);
+    state->root = QDir(rootPath).absolutePath();
+    state->pattern = pattern;
+    state->options = options;
+    if (options.caseSensitive && !options.regularExpression && !options.wholeWords)
+        state->literalUtf8 = pattern.toUtf8();
+
+    state->ignoreRules.load(state->root);
+
+    current = state;
+    walker = QtConcurrent::run(&walkerPool, [this, state]() { walk(state); });
+}
+
+void FileSearch::startInFiles(const QString &rootPath, const QStringList &files,
+                              const QString &pattern, const SearchOptions &options)
+{
+    cancel();
+
+    QSharedPointer<State> state(new State);
+    state->root = QDir(rootPath).absolutePath();
+    state->files = files;
+    state->useFileList = true;
+    state->pattern = pattern;
+    state->options = options;
+    if (options.caseSensitive && !options.regularExpression && !options.wholeWords)
+        state->literalUtf8 = pattern.toUtf8();
+
+    current = state;
+    walker = QtConcurrent::run(&walkerPool, [this, state]() { walk(state); });
+}
+
+void FileSearch::listFiles(const QString &rootPath, const IgnoreRules &rules,
+                           const std::function<bool()> &isCanceled,
+                           const std::function<void(const QFileInfo &)> &visitFile,
+                           const std::function<void(const QString &)> &visitDirectory)
+{
+    const QDir rootDir(rootPath);
+    QStack<QString> directories;
+    directories.push(rootPath);
+
+    while (!directories.isEmpty() && !isCanceled()) {
+        const QString directory = directories.pop();
+        if (visitDirectory)
+            visitDirectory(directory);
+
+        QDirIterator it(directory,
+                        QDir::AllEntries | QDir::NoDotAndDotDot | QDir::Hidden | QDir::NoSymLinks);
+        while (it.hasNext() && !isCanceled()) {
+            it.next();
+            const QFileInfo info = it.fileInfo();
+            if (rules.isIgnored(info.fileName(), rootDir.relativeFilePath(info.filePath())))
+                continue;
+
+            if (info.isDir()) {
+                directories.push(info.filePath());
+            } else if (info.isFile()) {
+                visitFile(info);
+            }
+        }
+    }
+}
+
+bool FileSearch::looksBinary(const char *data, qint64 size)
+{
+    // A NUL byte near the start is as good a test as any
+    return std::memchr(data, 0, size_t(qMin<qint64>(size, 8192))) != nullptr;
+}
+
+bool FileSearch::readTextFile(const QString &filePath, QString *text, bool *hasBom)
+{
+    if (hasBom)
+        *hasBom = false;
+    QFile file(filePath);
+    if (!file.open(QIODevice::ReadOnly))
+        return false;
+    const qint64 size = file.size();
+    if (size > MAX_FILE_SIZE)
+        return false;
+    if (size == 0) {
+        text->clear();
+        return true;
+    }
+
+    QByteArray buffer;
+    const char *bytes = reinterpret_cast<const char *>(file.map(0, size));
+    qint64 length = size;
+    if (!bytes) {
+        buffer = file.readAll();
+        bytes = buffer.constData();
+        length = buffer.size();
+    }
+    if (looksBinary(bytes, length))
+        return false;
+
+    if (hasBom)
+        *hasBom = QByteArrayView(bytes, length).startsWith("\xEF\xBB\xBF");
+
+    // Refuse anything that would not survive a round trip back to UTF-8
+    QStringDecoder decoder(QStringDecoder::Utf8, QStringDecoder::Flag::Stateless);
+    *text = decoder(QByteArrayView(bytes, length));
+    return !decoder.hasError();
+}
+
+void FileSearch::cancel()
+{
+    if (current) {
+        current->canceled = true;
+        current.clear();
+    }
+}
+
+bool FileSearch::isRunning() const
+{
+    return current && walker.isRunning();
+}
+
+void FileSearch::walk(const QSharedPointer<State> &state)
+{
+    // Bound the number of batches queued on the pool so a huge tree is
+    // never fully materialised in memory
+    const int maxInFlight = qMax(2, QThreadPool::globalInstance()->maxThreadCount() * 2);
+    QSemaphore inFlight(maxInFlight);
+
+    QStringList batch;
+
+    auto submit = [&]() {
+        if (batch.isEmpty())
+            return;
+        inFlight.acquire();
+        const QStringList files = batch;
+        batch.clear();
+        QThreadPool::globalInstance()->start([this, state, files, &inFlight]() {
+            searchBatch(state, files);
+            inFlight.release();
+        });
+    };
+    auto addFile = [&](const QString &filePath) {
+        batch.append(filePath);
+        if (batch.size() >= BATCH_SIZE)
+            submit();
+    };
+
+    if (state->useFileList) {
+        for (const QString &filePath : std::as_const(state->files)) {
+            if (state->isStopped())
+                break;
+            addFile(filePath);
+        }
+    } else {
+        listFiles(state->root, state->ignoreRules,
+                  [&state]() { return state->isStopped(); },
+                  [&addFile](const QFileInfo &info) { addFile(info.filePath()); });
+    }
+    if (!state->isStopped())
+        submit();
+
+    // Wait for the batches still running
+    inFlight.acquire(maxInFlight);
+
+    const int hits = qMin(state->hitCount.load(), int(MAX_HITS));
+    const int files = state->filesSearched.load();
+    const int skipped = state->filesSkipped.load();
+    const bool truncated = state->hitCount.load() >= MAX_HITS;
+    QMetaObject::invokeMethod(this, [this, state, hits, files, skipped, truncated]() {
+        if (state == current) {
+            current.clear();
+            emit finished(hits, files, skipped, truncated);
+        }
+    }, Qt::QueuedConnection);
+}
+
+void FileSearch::searchBatch(const QSharedPointer<State> &state, const QStringList &files)
+{
+    QVector<FileSearchHit> hits;
+    for (const QString &filePath : files) {
+        if (state->isStopped())
+            return;
+        searchFile(state.data(), filePath, &hits);
+        state->filesSearched.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    const int searched = state->filesSearched.load();
+    QMetaObject::invokeMethod(this, [this, state, hits, searched]() {
+        if (state != current)
+            return;
+        if (!hits.isEmpty())
+            emit hitsFound(hits);
+        emit progress(searched);
+    }, Qt::QueuedConnection);
+}
+
+void FileSearch::searchFile(State *state, const QString &filePath, QVector<FileSearchHit> *hits)
+{
+    QFile file(filePath);
+    if (!file.open(QIODevice::ReadOnly))
+        return;
+    const qint64 size = file.size();
+    if (size == 0)
+        return;
+    if (size > MAX_FILE_SIZE) {
+        state->filesSkipped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    QByteArray buffer;
+    const char *bytes = reinterpret_cast<const char *>(file.map(0, size));
+    qint64 length = size;
+    if (!bytes) {
+        buffer = file.readAll();
+        bytes = buffer.constData();
+        length = buffer.size();
+    }
+    if (looksBinary(bytes, length))
+        return;
+
+    // Most files do not contain the pattern; rule them out before decoding
+    if (!state->literalUtf8.isEmpty()
+        && QByteArrayView(bytes, length).indexOf(state->literalUtf8) < 0) {
+        return;
+    }
+
+    const QString text = QString::fromUtf8(bytes, length);
+    file.close();
+
+    const int remaining = MAX_HITS - state->hitCount.load(std::memory_order_relaxed);
+    if (remaining <= 0) {
+        state->canceled = true;
+        return;
+    }
+    const QVector<SearchMatch> matches = FindAllEngine::searchRange(text, 0, text.size(), state->pattern,
+                                                                    state->options, remaining);
+    if (matches.isEmpty())
+        return;
+    state->hitCount.fetch_add(matches.size(), std::memory_order_relaxed);
+
+    // Matches are in order, so lines are counted in a single forward pass
+    const QChar *data = text.constData();
+    int line = 1;
+    qsizetype lineStart = 0;
+    qsizetype scanned = 0;
+    for (const SearchMatch &match : matches) {
+        for (; scanned < match.position; ++scanned) {
+            if (data[scanned] == QLatin1Char('\n')) {
+                ++line;
+                lineStart = scanned + 1;
+            }
+        }
+
+        qsizetype lineEnd = text.indexOf(QLatin1Char('\n'), match.position);
+        if (lineEnd < 0)
+            lineEnd = text.size();
+        const int column = int(match.position - lineStart);
+        const qsizetype previewStart = column > MAX_PREVIEW / 2 ? match.position - MAX_PREVIEW / 4 : lineStart;
+        QString preview = text.mid(previewStart, qMin<qsizetype>(lineEnd - previewStart, MAX_PREVIEW));
+        if (preview.endsWith(QLatin1Char('\r')))
+            preview.chop(1);
+
+        hits->append({filePath, line, column, match.length, preview});
+    }
+}
@@ -0,0 +1,296 @@
+#include "search/findallengine.h"
+#include "search/literalsearch.h"
+#include "search/regexsearch.h"
+#include <QtConcurrent/QtConcurrent>
+#include <QtCore/QThreadPool>
+#include <algorithm>
+
+namespace {
+
+bool matchBefore(const SearchMatch &match, int position)
+{
+    return match.position < position;
+}
+
+}
+
+FindAllEngine::FindAllEngine(QObject *parent)
+    : QObject(parent), watcher(nullptr), nextChunkToMerge(0), complete(false)
+{
+}
+
+FindAllEngine::~FindAllEngine()
+{
+    cancel();
+}
+
+void FindAllEngine::start(const QString &text, const QString &pattern, const SearchOptions &options)
+{
+    cancel();
+
+    snapshot = text;
+    currentPattern = pattern;
+    currentOptions = options;
+    merged.clear();
+    chunks.clear();
+    nextChunkToMerge = 0;
+    complete = false;
+
+    if (pattern.isEmpty() || text.isEmpty()) {
+        complete = true;
+        emit matchesChanged(0);
+        emit finished(0);
+        return;
+    }
+
+    if (options.regularExpression) {
+        const QRegularExpression expression = RegexSearch::compile(pattern, options.caseSensitive,
+                                                                   options.wholeWords);
+        chunks.append(qMakePair(qsizetype(0), text.size()));
+        chunkResults = QVector<QVector<SearchMatch>>(1);
+        chunkReady = QVector<bool>(1, false);
+
+        const QString searchText = snapshot;
+        watch(QtConcurrent::run([searchText, expression](QPromise<QVector<SearchMatch>> &promise) {
+            QVector<SearchMatch> matches = RegexSearch::searchRange(
+                searchText, 0, searchText.size(), expression, -1,
+                [&promise]() { return promise.isCanceled(); });
+            if (!promise.isCanceled())
+                promise.addResult(matches);
+        }));
+        return;
+    }
+
+    // A few chunks per core keeps every worker busy without tiny tasks
+    const qsizetype workers = qMax(1, QThreadPool::globalInstance()->maxThreadCount());
+    const qsizetype chunkSize = qMax(MIN_CHUNK_SIZE, text.size() / (workers * 4) + 1);
+    for (qsizetype begin = 0; begin < text.size(); begin += chunkSize) {
+        chunks.append(qMakePair(begin, qMin(text.size(), begin + chunkSize)));
+    }
+    chunkResults = QVector<QVector<SearchMatch>>(chunks.size());
+    chunkReady = QVector<bool>(chunks.size(), false);
+
+    const QString searchText = snapshot;
+    watch(QtConcurrent::mapped(chunks,
+        [searchText, pattern, options](const QPair<qsizetype, qsizetype> &range) {
+            return searchRange(searchText, range.first, range.second, pattern, options);
+        }));
+}
+
+bool FindAllEngine::refine(const QString &text, const QString &pattern, const SearchOptions &options)
+{
+    const Qt::CaseSensitivity cs = options.caseSensitive ? Qt::CaseSensitive : Qt::CaseInsensitive;
+
+    // Narrowing is only exact when the previous run covered this very
+    // snapshot and its pattern cannot overlap itself: then every occurrence
+    // of the longer pattern starts at one of the previous matches. Whole-word
+    // results depend on where the match ends, so they always rescan.
+    if (!complete || options != currentOptions || options.wholeWords || options.regularExpression
+        || text.constData() != snapshot.constData() || text.size() != snapshot.size()
+        || pattern.size() <= currentPattern.size()
+        || !LiteralSearch::equals(QStringView(pattern).left(currentPattern.size()), currentPattern, cs)
+        || isSelfOverlapping(currentPattern, cs)) {
+        return false;
+    }
+
+    const QVector<SearchMatch> candidates = merged;
+    cancel();
+    currentPattern = pattern;
+    merged.clear();
+    chunks = { qMakePair(qsizetype(0), text.size()) };
+    chunkResults = QVector<QVector<SearchMatch>>(1);
+    chunkReady = QVector<bool>(1, false);
+    nextChunkToMerge = 0;
+    complete = false;
+
+    const QString searchText = snapshot;
+    watch(QtConcurrent::run([searchText, pattern, candidates, cs](QPromise<QVector<SearchMatch>> &promise) {
+        const QStringView view(searchText);
+        const qsizetype length = pattern.size();
+        QVector<SearchMatch> matches;
+        qsizetype lastEnd = 0;
+
+        for (int i = 0; i < candidates.size(); ++i) {
+            if ((i & 0xffff) == 0 && promise.isCanceled())
+                return;
+            const qsizetype position = candidates.at(i).position;
+            if (position < lastEnd || position + length > view.size())
+                continue;
+            if (LiteralSearch::equals(view.mid(position, length), pattern, cs)) {
+                matches.append({int(position), int(length)});
+                lastEnd = position + length;
+            }
+        }
+        promise.addResult(matches);
+    }));
+    return true;
+}
+
+void FindAllEngine::watch(const QFuture<QVector<SearchMatch>> &future)
+{
+    watcher = new QFutureWatcher<QVector<SearchMatch>>(this);
+    connect(watcher, &QFutureWatcher<QVector<SearchMatch>>::resultReadyAt,
+            this, &FindAllEngine::handleResultReady);
+    connect(watcher, &QFutureWatcher<QVector<SearchMatch>>::finished,
+            this, &FindAllEngine::handleFinished);
+    watcher->setFuture(future);
+}
+
+bool FindAllEngine::isSelfOverlapping(const QString &pattern, Qt::CaseSensitivity cs)
+{
+    const QStringView view(pattern);
+    for (qsizetype k = 1; k < view.size(); ++k) {
+        if (LiteralSearch::equals(view.left(k), view.right(k), cs))
+            return true;
+    }
+    return false;
+}
+
+void FindAllEngine::cancel()
+{
+    if (!watcher)
+        return;
+
+    // Let an abandoned search wind down on its own instead of blocking here
+    QFutureWatcher<QVector<SearchMatch>> *old = watcher;
+    watcher = nullptr;
+    old->disconnect(this);
+    old->cancel();
+    if (old->isFinished()) {
+        old->deleteLater();
+    } else {
+        connect(old, &QFutureWatcher<QVector<SearchMatch>>::finished, old, &QObject::deleteLater);
+    }
+}
+
+void FindAllEngine::clear()
+{
+    cancel();
+    snapshot.clear();
+    currentPattern.clear();
+    merged.clear();
+    chunks.clear();
+    chunkResults.clear();
+    chunkReady.clear();
+    nextChunkToMerge = 0;
+    complete = false;
+}
+
+bool FindAllEngine::isRunning() const
+{
+    return watcher && !watcher->isFinished();
+}
+
+int FindAllEngine::indexOfMatchAt(int position) const
+{
+    int index = firstMatchFrom(position);
+    if (index < merged.size() && merged.at(index).position == position)
+        return index;
+    return -1;
+}
+
+int FindAllEngine::firstMatchFrom(int position) const
+{
+    auto it = std::lower_bound(merged.constBegin(), merged.constEnd(), position, matchBefore);
+    return int(it - merged.constBegin());
+}
+
+QVector<SearchMatch> FindAllEngine::searchRange(const QString &text, qsizetype begin, qsizetype end,
+                                                const QString &pattern, const SearchOptions &options,
+                                                int maxCount)
+{
+    if (options.regularExpression) {
+        return RegexSearch::searchRange(text, begin, end,
+                                        RegexSearch::compile(pattern, options.caseSensitive, options.wholeWords),
+                                        maxCount);
+    }
+
+    QVector<SearchMatch> matches;
+    const QStringView view(text);
+    const qsizetype length = pattern.size();
+    const Qt::CaseSensitivity cs = options.caseSensitive ? Qt::CaseSensitive : Qt::CaseInsensitive;
+
+    // Matches must start inside [begin, end) but may run past the end,
+    // so a match straddling two chunks belongs to the one it starts in
+    const QStringView window = view.left(qMin(text.size(), end + length - 1));
+    qsizetype from = begin;
+    while (maxCount < 0 || matches.size() < maxCount) {
+        const qsizetype index = LiteralSearch::indexOf(window, pattern, from, cs);
+        if (index < 0 || index >= end)
+            break;
+        if (options.wholeWords && !LiteralSearch::isWholeWordAt(view, index, length)) {
+            from = index + 1;
+            continue;
+        }
+        matches.append({int(index), int(length)});
+        from = index + length;
+    }
+    return matches;
+}
+
+void FindAllEngine::handleResultReady(int index)
+{
+    if (!watcher || index < 0 || index >= chunks.size())
+        return;
+
+    chunkResults[index] = watcher->resultAt(index);
+    chunkReady[index] = true;
+    mergeReadyChunks();
+}
+
+void FindAllEngine::handleFinished()
+{
+    if (!watcher)
+        return;
+
+    mergeReadyChunks();
+    watcher->deleteLater();
+    watcher = nullptr;
+    complete = true;
+    emit finished(merged.size());
+}
+
+void FindAllEngine::mergeReadyChunks()
+{
+    const int before = merged.size();
+
+    while (nextChunkToMerge < chunks.size() && chunkReady.at(nextChunkToMerge)) {
+        const QVector<SearchMatch> &chunk = chunkResults.at(nextChunkToMerge);
+        const int allowed = merged.isEmpty() ? 0 : merged.last().position + merged.last().length;
+        int i = 0;
+
+        // A match that straddled the boundary can shift the alignment of a
+        // self-overlapping pattern; rescan until we meet a match the chunk
+        // also found and take the rest of the chunk from there.
+        if (!chunk.isEmpty() && chunk.first().position < allowed) {
+            qsizetype from = allowed;
+            const qsizetype end = chunks.at(nextChunkToMerge).second;
+            while (true) {
+                QVector<SearchMatch> next = searchRange(snapshot, from, end, currentPattern,
+                                                        currentOptions, 1);
+                if (next.isEmpty()) {
+                    i = chunk.size();
+                    break;
+                }
+                const SearchMatch match = next.first();
+                auto it = std::lower_bound(chunk.constBegin() + i, chunk.constEnd(),
+                                           match.position, matchBefore);
+                i = int(it - chunk.constBegin());
+                if (it != chunk.constEnd() && it->position == match.position)
+                    break;
+                merged.append(match);
+                from = match.position + match.length;
+            }
+        }
+
+        for (; i < chunk.size(); ++i) {
+            merged.append(chunk.at(i));
+        }
+        chunkResults[nextChunkToMerge] = QVector<SearchMatch>();
+        ++nextChunkToMerge;
+    }
+
+    if (merged.size() != before) {
+        emit matchesChanged(merged.size());
+    }
+}
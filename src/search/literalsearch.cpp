@@ -0,0 +1,261 @@
+#include "search/literalsearch.h"
+#include <atomic>
+#include <cstring>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || (defined(__i386__) && defined(__SSE2__)))
+#define TOAST_X86_SEARCH_KERNELS 1
+#include <immintrin.h>
+#endif
+
+namespace {
+
+typedef bool (*VerifyFn)(const char16_t *candidate, const char16_t *needle, qsizetype length);
+
+// Code units the first and last pattern characters may take in the text
+struct Probe {
+    char16_t first[2];
+    char16_t last[2];
+};
+
+typedef qsizetype (*ScanFn)(const char16_t *text, qsizetype size, qsizetype from,
+                            const char16_t *needle, qsizetype length,
+                            const Probe &probe, VerifyFn verify);
+
+bool verifyExact(const char16_t *candidate, const char16_t *needle, qsizetype length)
+{
+    return std::memcmp(candidate, needle, size_t(length) * sizeof(char16_t)) == 0;
+}
+
+bool verifyFolded(const char16_t *candidate, const char16_t *needle, qsizetype length)
+{
+    return QStringView(candidate, length).compare(QStringView(needle, length), Qt::CaseInsensitive) == 0;
+}
+
+bool probeVariants(QChar c, Qt::CaseSensitivity cs, char16_t *variants)
+{
+    if (cs == Qt::CaseSensitive) {
+        variants[0] = variants[1] = c.unicode();
+        return true;
+    }
+
+    // Only ASCII has a closed two-member case class; 'k' and 's' also fold
+    // from KELVIN SIGN and LONG S, so those go through the slow path.
+    const QChar folded = c.toCaseFolded();
+    if (folded.unicode() >= 0x80 || folded == QLatin1Char('k') || folded == QLatin1Char('s'))
+        return false;
+    variants[0] = folded.toLower().unicode();
+    variants[1] = folded.toUpper().unicode();
+    return true;
+}
+
+bool makeProbe(QStringView needle, Qt::CaseSensitivity cs, Probe *probe)
+{
+    return probeVariants(needle.front(), cs, probe->first)
+        && probeVariants(needle.back(), cs, probe->last);
+}
+
+qsizetype scanScalar(const char16_t *text, qsizetype size, qsizetype from,
+                     const char16_t *needle, qsizetype length,
+                     const Probe &probe, VerifyFn verify)
+{
+    const qsizetype lastStart = size - length;
+    for (qsizetype i = from; i <= lastStart; ++i) {
+        const char16_t a = text[i];
+        const char16_t b = text[i + length - 1];
+        if ((a == probe.first[0] || a == probe.first[1])
+            && (b == probe.last[0] || b == probe.last[1])
+            && verify(text + i, needle, length)) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+#ifdef TOAST_X86_SEARCH_KERNELS
+
+qsizetype scanSse2(const char16_t *text, qsizetype size, qsizetype from,
+                   const char16_t *needle, qsizetype length,
+                   const Probe &probe, VerifyFn verify)
+{
+    const __m128i first0 = _mm_set1_epi16(short(probe.first[0]));
+    const __m128i first1 = _mm_set1_epi16(short(probe.first[1]));
+    const __m128i last0 = _mm_set1_epi16(short(probe.last[0]));
+    const __m128i last1 = _mm_set1_epi16(short(probe.last[1]));
+    const qsizetype lastStart = size - length;
+
+    qsizetype i = from;
+    for (; i + 8 <= lastStart + 1; i += 8) {
+        const __m128i head = _mm_loadu_si128(reinterpret_cast<const __m128i *>(text + i));
+        const __m128i tail = _mm_loadu_si128(reinterpret_cast<const __m128i *>(text + i + length - 1));
+        const __m128i hit = _mm_and_si128(
+            _mm_or_si128(_mm_cmpeq_epi16(head, first0), _mm_cmpeq_epi16(head, first1)),
+            _mm_or_si128(_mm_cmpeq_epi16(tail, last0), _mm_cmpeq_epi16(tail, last1)));
+
+        // Two mask bits per 16-bit lane; keep one
+        unsigned mask = unsigned(_mm_movemask_epi8(hit)) & 0x5555u;
+        while (mask) {
+            const qsizetype candidate = i + (__builtin_ctz(mask) >> 1);
+            if (verify(text + candidate, needle, length))
+                return candidate;
+            mask &= mask - 1;
+        }
+    }
+    return scanScalar(text, size, i, needle, length, probe, verify);
+}
+
+__attribute__((target("avx2")))
+qsizetype scanAvx2(const char16_t *text, qsizetype size, qsizetype from,
+                   const char16_t *needle, qsizetype length,
+                   const Probe &probe, VerifyFn verify)
+{
+    const __m256i first0 = _mm256_set1_epi16(short(probe.first[0]));
+    const __m256i first1 = _mm256_set1_epi16(short(probe.first[1]));
+    const __m256i last0 = _mm256_set1_epi16(short(probe.last[0]));
+    const __m256i last1 = _mm256_set1_epi16(short(probe.last[1]));
+    const qsizetype lastStart = size - length;
+
+    qsizetype i = from;
+    for (; i + 16 <= lastStart + 1; i += 16) {
+        const __m256i head = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(text + i));
+        const __m256i tail = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(text + i + length - 1));
+        const __m256i hit = _mm256_and_si256(
+            _mm256_or_si256(_mm256_cmpeq_epi16(head, first0), _mm256_cmpeq_epi16(head, first1)),
+            _mm256_or_si256(_mm256_cmpeq_epi16(tail, last0), _mm256_cmpeq_epi16(tail, last1)));
+
+        unsigned mask = unsigned(_mm256_movemask_epi8(hit)) & 0x55555555u;
+        while (mask) {
+            const qsizetype candidate = i + (__builtin_ctz(mask) >> 1);
+            if (verify(text + candidate, needle, length))
+                return candidate;
+            mask &= mask - 1;
+        }
+    }
+    return scanSse2(text, size, i, needle, length, probe, verify);
+}
+
+#endif // TOAST_X86_SEARCH_KERNELS
+
+LiteralSearch::Kernel detectKernel()
+{
+#ifdef TOAST_X86_SEARCH_KERNELS
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+        return LiteralSearch::Avx2;
+    return LiteralSearch::Sse2;
+#else
+    return LiteralSearch::Scalar;
+#endif
+}
+
+std::atomic<int> &kernelSlot()
+{
+    static std::atomic<int> slot(int(detectKernel()));
+    return slot;
+}
+
+ScanFn scanFunction()
+{
+    switch (kernelSlot().load(std::memory_order_relaxed)) {
+#ifdef TOAST_X86_SEARCH_KERNELS
+    case LiteralSearch::Avx2:
+        return scanAvx2;
+    case LiteralSearch::Sse2:
+        return scanSse2;
+#endif
+    default:
+        return scanScalar;
+    }
+}
+
+}
+
+qsizetype LiteralSearch::indexOf(QStringView haystack, QStringView needle, qsizetype from,
+                                 Qt::CaseSensitivity cs)
+{
+    from = qMax<qsizetype>(0, from);
+    const qsizetype length = needle.size();
+    if (length == 0)
+        return from <= haystack.size() ? from : -1;
+    if (from > haystack.size() - length)
+        return -1;
+
+    Probe probe;
+    if (!makeProbe(needle, cs, &probe))
+        return haystack.indexOf(needle, from, cs);
+
+    return scanFunction()(haystack.utf16(), haystack.size(), from, needle.utf16(), length,
+                          probe, cs == Qt::CaseSensitive ? verifyExact : verifyFolded);
+}
+
+qsizetype LiteralSearch::lastIndexOf(QStringView haystack, QStringView needle, qsizetype from,
+                                     Qt::CaseSensitivity cs)
+{
+    const qsizetype length = needle.size();
+    from = qMin(from, haystack.size() - length);
+    if (from < 0)
+        return -1;
+    if (length == 0)
+        return from;
+
+    Probe probe;
+    if (!makeProbe(needle, cs, &probe))
+        return haystack.lastIndexOf(needle, from, cs);
+
+    const char16_t *text = haystack.utf16();
+    const char16_t *pattern = needle.utf16();
+    const VerifyFn verify = cs == Qt::CaseSensitive ? verifyExact : verifyFolded;
+    for (qsizetype i = from; i >= 0; --i) {
+        const char16_t a = text[i];
+        const char16_t b = text[i + length - 1];
+        if ((a == probe.first[0] || a == probe.first[1])
+            && (b == probe.last[0] || b == probe.last[1])
+            && verify(text + i, pattern, length)) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+bool LiteralSearch::equals(QStringView a, QStringView b, Qt::CaseSensitivity cs)
+{
+    if (a.size() != b.size())
+        return false;
+    if (cs == Qt::CaseSensitive)
+        return verifyExact(a.utf16(), b.utf16(), a.size());
+    return verifyFolded(a.utf16(), b.utf16(), a.size());
+}
+
+bool LiteralSearch::isWholeWordAt(QStringView text, qsizetype position, qsizetype length)
+{
+    if (position > 0 && text.at(position - 1).isLetterOrNumber())
+        return false;
+    const qsizetype end = position + length;
+    if (end < text.size() && text.at(end).isLetterOrNumber())
+        return false;
+    return true;
+}
+
+LiteralSearch::Kernel LiteralSearch::activeKernel()
+{
+    return Kernel(kernelSlot().load(std::memory_order_relaxed));
+}
+
+void LiteralSearch::setKernel(Kernel kernel)
+{
+    // Never pick a kernel the CPU cannot run
+    if (kernel > detectKernel())
+        kernel = detectKernel();
+    kernelSlot().store(int(kernel), std::memory_order_relaxed);
+}
+
+const char *LiteralSearch::kernelName(Kernel kernel)
+{
+    switch (kernel) {
+    case Avx2:
+        return "AVX2";
+    case Sse2:
+        return "SSE2";
+    default:
+        return "scalar";
+    }
+}
@@ -0,0 +1,365 @@
+#include "search/projectreplace.h"
+#include "search/filesearch.h"
+#include "search/replaceengine.h"
+#include <QtConcurrent/QtConcurrent>
+#include <QtCore/QDateTime>
+#include <QtCore/QDir>
+#include <QtCore/QFile>
+#include <QtCore/QFileInfo>
+#include <QtCore/QTemporaryFile>
+#include <filesystem>
+#include <system_error>
+
+#ifdef Q_OS_UNIX
+#include <unistd.h>
+#endif
+
+namespace {
+
+qsizetype lineStart(const QString &text, qsizetype position)
+{
+    if (position <= 0)
+        return 0;
+    return text.lastIndexOf(QLatin1Char('\n'), position - 1) + 1;
+}
+
+qsizetype lineEnd(const QString &text, qsizetype position)
+{
+    const qsizetype index = text.indexOf(QLatin1Char('\n'), position);
+    return index < 0 ? text.size() : index;
+}
+
+void appendLines(QString *diff, QStringView lines, QLatin1String prefix)
+{
+    for (QStringView line : lines.split(QLatin1Char('\n'))) {
+        if (line.endsWith(QLatin1Char('\r')))
+            line.chop(1);
+        diff->append(prefix);
+        diff->append(line);
+        diff->append(QLatin1Char('\n'));
+    }
+}
+
+}
+
+ProjectReplace::ProjectReplace(QObject *parent)
+    : QObject(parent), computeWatcher(nullptr), committing(false)
+{
+    commitPool.setMaxThreadCount(1);
+}
+
+ProjectReplace::~ProjectReplace()
+{
+    cancel();
+    // A half-finished commit would leave temporaries behind, so let it end
+    commitPool.waitForDone();
+}
+
+void ProjectReplace::compute(const QStringList &files, const QString &pattern,
+                             const QString &replacement, const SearchOptions &options)
+{
+    cancel();
+
+    computeWatcher = new QFutureWatcher<FileEdit>(this);
+    connect(computeWatcher, &QFutureWatcher<FileEdit>::finished,
+            this, &ProjectReplace::handleComputeFinished);
+    computeWatcher->setFuture(QtConcurrent::mapped(files,
+        [pattern, replacement, options](const QString &filePath) {
+            return computeEdit(filePath, pattern, replacement, options);
+        }));
+}
+
+void ProjectReplace::cancel()
+{
+    if (!computeWatcher)
+        return;
+
+    QFutureWatcher<FileEdit> *old = computeWatcher;
+    computeWatcher = nullptr;
+    old->disconnect(this);
+    old->cancel();
+    if (old->isFinished()) {
+        old->deleteLater();
+    } else {
+        connect(old, &QFutureWatcher<FileEdit>::finished, old, &QObject::deleteLater);
+    }
+}
+
+bool ProjectReplace::isBusy() const
+{
+    return committing || (computeWatcher && !computeWatcher->isFinished());
+}
+
+void ProjectReplace::handleComputeFinished()
+{
+    if (!computeWatcher)
+        return;
+
+    QVector<FileEdit> edits;
+    int skipped = 0;
+    const QFuture<FileEdit> future = computeWatcher->future();
+    for (int i = 0; i < future.resultCount(); ++i) {
+        FileEdit edit = future.resultAt(i);
+        if (edit.count < 0)
+            ++skipped;
+        else if (edit.count > 0)
+            edits.append(std::move(edit));
+    }
+    computeWatcher->deleteLater();
+    computeWatcher = nullptr;
+    emit editsReady(edits, skipped);
+}
+
+FileEdit ProjectReplace::computeEdit(const QString &filePath, const QString &pattern,
+                                     const QString &replacement, const SearchOptions &options)
+{
+    FileEdit edit;
+    edit.filePath = filePath;
+
+    const QFileInfo info(filePath);
+    edit.size = info.size();
+    edit.modified = info.lastModified().toMSecsSinceEpoch();
+    QString text;
+    if (!FileSearch::readTextFile(filePath, &text, &edit.hasBom)) {
+        edit.count = -1;
+        return edit;
+    }
+
+    // The text itself is dropped here; holding every file until the user
+    // confirms would keep the whole project in memory
+    edit.spans = ReplaceEngine::spans(text, pattern, replacement, options);
+    edit.count = int(edit.spans.size());
+    return edit;
+}
+
+bool ProjectReplace::applyEdit(const FileEdit &edit, QString *text)
+{
+    QString original;
+    bool hasBom = false;
+    if (!FileSearch::readTextFile(edit.filePath, &original, &hasBom) || hasBom != edit.hasBom)
+        return false;
+
+    QString result;
+    result.reserve(original.size());
+    qsizetype copied = 0;
+    for (const ReplaceSpan &span : edit.spans) {
+        if (span.position < copied || span.position + qsizetype(span.length) > original.size())
+            return false;
+        result += QStringView(original).mid(copied, span.position - copied);
+        result += span.text;
+        copied = span.position + span.length;
+    }
+    result += QStringView(original).mid(copied);
+    *text = result;
+    return true;
+}
+
+void ProjectReplace::commit(const QVector<FileEdit> &edits)
+{
+    if (committing)
+        return;
+
+    committing = true;
+    commitPool.start([this, edits]() {
+        const QString error = commitEdits(edits);
+        QMetaObject::invokeMethod(this, [this, edits, error]() {
+            committing = false;
+            if (!error.isEmpty()) {
+                emit commitFailed(error);
+                return;
+            }
+            QStringList files;
+            int replacements = 0;
+            for (const FileEdit &edit : edits) {
+                files.append(edit.filePath);
+                replacements += edit.count;
+            }
+            emit committed(files, replacements);
+        }, Qt::QueuedConnection);
+    });
+}
+
+QString ProjectReplace::commitEdits(const QVector<FileEdit> &edits)
+{
+    // Nothing is written if a file changed after the preview was computed
+    for (const FileEdit &edit : edits) {
+        const QFileInfo info(edit.filePath);
+        if (!info.exists() || info.size() != edit.size
+            || info.lastModified().toMSecsSinceEpoch() != edit.modified) {
+            return tr("%1 changed on disk since the preview; no files were changed.")
+                   .arg(QDir::toNativeSeparators(edit.filePath));
+        }
+    }
+
+    // Each file is read again, rebuilt and written in parallel; a worker
+    // only holds the file it is on
+    const QList<QString> temporaries = QtConcurrent::blockingMapped(edits,
+        [](const FileEdit &edit) {
+            QString text;
+            if (!applyEdit(edit, &text))
+                return QString();
+            return writeTemporary(edit.filePath, text, edit.hasBom);
+        });
+    auto removeAll = [](const QStringList &paths) {
+        for (const QString &path : paths) {
+            if (!path.isEmpty())
+                QFile::remove(path);
+        }
+    };
+
+    const int failedWrite = temporaries.indexOf(QString());
+    if (failedWrite >= 0) {
+        removeAll(temporaries);
+        return tr("Could not write %1; no files were changed.")
+               .arg(QDir::toNativeSeparators(edits.at(failedWrite).filePath));
+    }
+
+    // Hard links keep the originals for a rollback without copying them
+    QStringList backups;
+    for (const FileEdit &edit : edits) {
+        const QString backup = linkBackup(edit.filePath);
+        if (backup.isEmpty()) {
+            removeAll(temporaries);
+            removeAll(backups);
+            return tr("Could not back up %1; no files were changed.")
+                   .arg(QDir::toNativeSeparators(edit.filePath));
+        }
+        backups.append(backup);
+    }
+
+    int swapped = 0;
+    while (swapped < edits.size() && replaceFile(temporaries.at(swapped), edits.at(swapped).filePath))
+        ++swapped;
+    if (swapped == edits.size()) {
+        removeAll(backups);
+        return QString();
+    }
+
+    removeAll(temporaries.mid(swapped));
+    removeAll(backups.mid(swapped));
+
+    // Put back the files already replaced, through the same atomic path
+    QStringList unrestored;
+    for (int i = 0; i < swapped; ++i) {
+        const FileEdit &edit = edits.at(i);
+        if (!replaceFile(backups.at(i), edit.filePath)) {
+            unrestored.append(tr("%1 (the original is kept as %2)")
+                              .arg(QDir::toNativeSeparators(edit.filePath),
+                                   QDir::toNativeSeparators(backups.at(i))));
+        }
+    }
+
+    const QString failed = QDir::toNativeSeparators(edits.at(swapped).filePath);
+    if (!unrestored.isEmpty()) {
+        return tr("Could not replace %1, and these files could not be restored:\n%2")
+               .arg(failed, unrestored.join(QLatin1Char('\n')));
+    }
+    return tr("Could not replace %1; no files were changed.").arg(failed);
+}
+
+QString ProjectReplace::writeTemporary(const QString &filePath, const QString &text, bool hasBom)
+{
+    // Same directory as the target so the final rename never crosses devices
+    const QFileInfo info(filePath);
+    QTemporaryFile file(info.absolutePath() + QLatin1String("/.") + info.fileName()
+                        + QLatin1String(".XXXXXX"));
+    file.setAutoRemove(false);
+    if (!file.open())
+        return QString();
+
+    // A byte order mark the file had is kept
+    const QByteArray bytes = hasBom ? "\xEF\xBB\xBF" + text.toUtf8() : text.toUtf8();
+    bool ok = file.write(bytes) == bytes.size() && file.flush();
+#ifdef Q_OS_UNIX
+    ok = ok && ::fsync(file.handle()) == 0;
+#endif
+    ok = ok && file.setPermissions(QFile::permissions(filePath));
+    if (!ok) {
+        file.remove();
+        return QString();
+    }
+    file.close();
+    return file.fileName();
+}
+
+QString ProjectReplace::linkBackup(const QString &filePath)
+{
+    // A unique name next to the original, which then becomes a second link to it
+    const QFileInfo info(filePath);
+    QTemporaryFile file(info.absolutePath() + QLatin1String("/.") + info.fileName()
+                        + QLatin1String(".orig.XXXXXX"));
+    file.setAutoRemove(false);
+    if (!file.open())
+        return QString();
+    const QString backup = file.fileName();
+    file.close();
+    QFile::remove(backup);
+
+    std::error_code error;
+    std::filesystem::create_hard_link(std::filesystem::path(filePath.toStdU16String()),
+                                      std::filesystem::path(backup.toStdU16String()), error);
+    // File systems without hard links get a copy
+    if (error && !QFile::copy(filePath, backup))
+        return QString();
+    return backup;
+}
+
+bool ProjectReplace::replaceFile(const QString &source, const QString &target)
+{
+    // Unlike QFile::rename this replaces an existing target in one step
+    std::error_code error;
+    std::filesystem::rename(std::filesystem::path(source.toStdU16String()),
+                            std::filesystem::path(target.toStdU16String()), error);
+    return !error;
+}
+
+QString ProjectReplace::previewDiff(const FileEdit &edit)
+{
+    const QFileInfo info(edit.filePath);
+    if (info.size() != edit.size || info.lastModified().toMSecsSinceEpoch() != edit.modified)
+        return tr("%1 changed on disk since the search.").arg(QDir::toNativeSeparators(edit.filePath));
+    QString text;
+    if (!FileSearch::readTextFile(edit.filePath, &text))
+        return tr("Could not read %1.").arg(QDir::toNativeSeparators(edit.filePath));
+    const QVector<ReplaceSpan> &spans = edit.spans;
+
+    QString diff;
+    int hunks = 0;
+    int lineNumber = 1;
+    qsizetype counted = 0;
+    int i = 0;
+    while (i < spans.size()) {
+        if (hunks == MAX_PREVIEW_HUNKS) {
+            diff += tr("... %n more change(s)\n", nullptr, int(spans.size() - i));
+            break;
+        }
+
+        // Matches that share a line are shown together
+        const qsizetype begin = lineStart(text, spans.at(i).position);
+        qsizetype end = lineEnd(text, spans.at(i).position + spans.at(i).length);
+        int last = i + 1;
+        while (last < spans.size() && spans.at(last).position <= end) {
+            end = qMax(end, lineEnd(text, spans.at(last).position + spans.at(last).length));
+            ++last;
+        }
+
+        lineNumber += int(QStringView(text).mid(counted, begin - counted).count(QLatin1Char('\n')));
+        counted = begin;
+
+        QString after;
+        qsizetype copied = begin;
+        for (int k = i; k < last; ++k) {
+            after += QStringView(text).mid(copied, spans.at(k).position - copied);
+            after += spans.at(k).text;
+            copied = spans.at(k).position + spans.at(k).length;
+        }
+        after += QStringView(text).mid(copied, end - copied);
+
+        diff += QStringLiteral("@@ %1 @@\n").arg(lineNumber);
+        appendLines(&diff, QStringView(text).mid(begin, end - begin), QLatin1String("- "));
+        appendLines(&diff, after, QLatin1String("+ "));
+        ++hunks;
+        i = last;
+    }
+    return diff;
+}
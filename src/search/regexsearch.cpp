@@ -0,0 +1,175 @@
+#include "search/regexsearch.h"
+#include <QtCore/QCache>
+#include <QtCore/QMutex>
+#include <QtCore/QMutexLocker>
+
+namespace {
+
+const int CACHE_SIZE = 32; // compiled patterns kept around
+
+QMutex cacheMutex;
+
+QCache<QString, QRegularExpression> &expressionCache()
+{
+    static QCache<QString, QRegularExpression> cache(CACHE_SIZE);
+    return cache;
+}
+
+// Reads a group number after a \ or $ at text[*index]; returns -1 when none
+int readGroupNumber(const QString &text, qsizetype *index, bool braced)
+{
+    qsizetype i = *index;
+    int number = -1;
+    int digits = 0;
+    while (i < text.size() && text.at(i).isDigit() && digits < 2) {
+        number = qMax(0, number) * 10 + text.at(i).digitValue();
+        ++i;
+        ++digits;
+    }
+    if (braced) {
+        if (digits == 0 || i >= text.size() || text.at(i) != QLatin1Char('}'))
+            return -1;
+        ++i;
+    }
+    if (number >= 0)
+        *index = i;
+    return number;
+}
+
+}
+
+QRegularExpression RegexSearch::compile(const QString &pattern, bool caseSensitive, bool wholeWords)
+{
+    const QString key = QString::number(int(caseSensitive) | int(wholeWords) << 1)
+                        + QLatin1Char(':') + pattern;
+
+    QMutexLocker locker(&cacheMutex);
+    if (QRegularExpression *cached = expressionCache().object(key))
+        return *cached;
+
+    QRegularExpression::PatternOptions options = QRegularExpression::MultilineOption
+                                               | QRegularExpression::UseUnicodePropertiesOption;
+    if (!caseSensitive)
+        options |= QRegularExpression::CaseInsensitiveOption;
+
+    // A non-capturing wrapper keeps the user's group numbers intact
+    const QString source = wholeWords ? QStringLiteral("\\b(?:%1)\\b").arg(pattern) : pattern;
+    QRegularExpression expression(source, options);
+    if (expression.isValid()) {
+        expression.optimize();
+        expressionCache().insert(key, new QRegularExpression(expression));
+    }
+    return expression;
+}
+
+QVector<SearchMatch> RegexSearch::searchRange(const QString &text, qsizetype begin, qsizetype end,
+                                              const QRegularExpression &expression, int maxCount,
+                                              const std::function<bool()> &isCanceled)
+{
+    QVector<SearchMatch> matches;
+    if (!expression.isValid())
+        return matches;
+
+    // Empty matches cannot be selected or highlighted, so they are skipped
+    // Cancellation is polled by iteration, not by match count, so runs of
+    // skipped empty matches and sparse results can still be stopped
+    QRegularExpressionMatchIterator it = expression.globalMatch(text, begin);
+    for (int iteration = 0; maxCount < 0 || matches.size() < maxCount; ++iteration) {
+        if (isCanceled && (iteration & 0xff) == 0 && isCanceled())
+            break;
+        if (!it.hasNext())
+            break;
+        const QRegularExpressionMatch match = it.next();
+        if (match.capturedStart() >= end)
+            break;
+        if (match.capturedLength() > 0)
+            matches.append({int(match.capturedStart()), int(match.capturedLength())});
+    }
+    return matches;
+}
+
+QRegularExpressionMatch RegexSearch::matchFrom(const QRegularExpression &expression,
+                                               const QString &text, qsizetype from)
+{
+    QRegularExpressionMatchIterator it = expression.globalMatch(text, qBound<qsizetype>(0, from, text.size()));
+    while (it.hasNext()) {
+        const QRegularExpressionMatch match = it.next();
+        if (match.capturedLength() > 0)
+            return match;
+    }
+    return QRegularExpressionMatch();
+}
+
+QRegularExpressionMatch RegexSearch::matchBefore(const QRegularExpression &expression,
+                                                 const QString &text, qsizetype before)
+{
+    before = qMin(before, text.size());
+
+    // Scan growing windows behind 'before' so a match near the cursor is
+    // found without walking the whole document from the top
+    for (qsizetype window = 64 * 1024; before > 0; window *= 4) {
+        const qsizetype start = qMax<qsizetype>(0, before - window);
+        QRegularExpressionMatch last;
+        QRegularExpressionMatchIterator it = expression.globalMatch(text, start);
+        while (it.hasNext()) {
+            const QRegularExpressionMatch match = it.next();
+            if (match.capturedStart() >= before)
+                break;
+            if (match.capturedLength() > 0)
+                last = match;
+        }
+        if (last.hasMatch() || start == 0)
+            return last;
+    }
+    return QRegularExpressionMatch();
+}
+
+QRegularExpressionMatch RegexSearch::matchAt(const QRegularExpression &expression,
+                                             const QString &text, qsizetype position)
+{
+    const QRegularExpressionMatch match = expression.match(text, position, QRegularExpression::NormalMatch,
+                                                           QRegularExpression::AnchorAtOffsetMatchOption);
+    if (match.hasMatch() && match.capturedLength() > 0)
+        return match;
+    return QRegularExpressionMatch();
+}
+
+QString RegexSearch::expandReplacement(const QString &replacement, const QRegularExpressionMatch &match)
+{
+    QString result;
+    result.reserve(replacement.size());
+
+    for (qsizetype i = 0; i < replacement.size(); ) {
+        const QChar c = replacement.at(i);
+        if ((c != QLatin1Char('\\') && c != QLatin1Char('$')) || i + 1 >= replacement.size()) {
+            result += c;
+            ++i;
+            continue;
+        }
+
+        const QChar next = replacement.at(i + 1);
+        if (next == c) {
+            result += c;
+            i += 2;
+            continue;
+        }
+        if (c == QLatin1Char('\\') && (next == QLatin1Char('n') || next == QLatin1Char('t'))) {
+            result += next == QLatin1Char('n') ? QLatin1Char('\n') : QLatin1Char('\t');
+            i += 2;
+            continue;
+        }
+
+        const bool braced = c == QLatin1Char('$') && next == QLatin1Char('{');
+        qsizetype index = i + (braced ? 2 : 1);
+        const int group = readGroupNumber(replacement, &index, braced);
+        if (group < 0) {
+            result += c;
+            ++i;
+            continue;
+        }
+        if (group <= match.lastCapturedIndex())
+            result += match.capturedView(group);
+        i = index;
+    }
+    return result;
+}
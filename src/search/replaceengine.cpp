@@ -0,0 +1,80 @@
+#include "search/replaceengine.h"
+#include "search/regexsearch.h"
+
+ReplaceEdit ReplaceEngine::build(const QString &snapshot, const QString &pattern,
+                                 const QString &replacement, const SearchOptions &options)
+{
+    ReplaceEdit edit;
+    if (pattern.isEmpty())
+        return edit;
+
+    if (options.regularExpression) {
+        const QRegularExpression expression = RegexSearch::compile(pattern, options.caseSensitive,
+                                                                   options.wholeWords);
+        qsizetype copied = -1;
+        QRegularExpressionMatchIterator it = expression.globalMatch(snapshot);
+        while (it.hasNext()) {
+            const QRegularExpressionMatch match = it.next();
+            if (match.capturedLength() == 0)
+                continue;
+            if (copied < 0) {
+                edit.start = int(match.capturedStart());
+                copied = edit.start;
+            }
+            edit.text += QStringView(snapshot).mid(copied, match.capturedStart() - copied);
+            edit.text += RegexSearch::expandReplacement(replacement, match);
+            copied = match.capturedEnd();
+            ++edit.count;
+        }
+        edit.end = int(qMax<qsizetype>(copied, edit.start));
+        return edit;
+    }
+
+    const QVector<SearchMatch> matches = FindAllEngine::searchRange(snapshot, 0, snapshot.size(),
+                                                                    pattern, options);
+    if (matches.isEmpty())
+        return edit;
+
+    edit.start = matches.first().position;
+    edit.end = matches.last().position + matches.last().length;
+    edit.count = matches.size();
+
+    // Literal replacements have a known size, so build it in one allocation
+    const qsizetype delta = replacement.size() - pattern.size();
+    edit.text.reserve(edit.end - edit.start + delta * matches.size());
+    qsizetype copied = edit.start;
+    for (const SearchMatch &match : matches) {
+        edit.text += QStringView(snapshot).mid(copied, match.position - copied);
+        edit.text += replacement;
+        copied = match.position + match.length;
+    }
+    return edit;
+}
+
+QVector<ReplaceSpan> ReplaceEngine::spans(const QString &snapshot, const QString &pattern,
+                                          const QString &replacement, const SearchOptions &options)
+{
+    QVector<ReplaceSpan> result;
+    if (pattern.isEmpty())
+        return result;
+
+    if (options.regularExpression) {
+        QRegularExpressionMatchIterator it = RegexSearch::compile(pattern, options.caseSensitive,
+                                                                  options.wholeWords).globalMatch(snapshot);
+        while (it.hasNext()) {
+            const QRegularExpressionMatch match = it.next();
+            if (match.capturedLength() > 0) {
+                result.append({int(match.capturedStart()), int(match.capturedLength()),
+                               RegexSearch::expandReplacement(replacement, match)});
+            }
+        }
+        return result;
+    }
+
+    const QVector<SearchMatch> matches = FindAllEngine::searchRange(snapshot, 0, snapshot.size(),
+                                                                    pattern, options);
+    result.reserve(matches.size());
+    for (const SearchMatch &match : matches)
+        result.append({match.position, match.length, replacement});
+    return result;
+}
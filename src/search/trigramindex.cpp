@@ -0,0 +1,702 @@
+#include "search/trigramindex.h"
+#include <QtConcurrent/QtConcurrent>
+#include <QtCore/QCryptographicHash>
+#include <QtCore/QDir>
+#include <QtCore/QDirIterator>
+#include <QtCore/QFileInfo>
+#include <QtCore/QFileSystemWatcher>
+#include <QtCore/QSaveFile>
+#include <QtCore/QStandardPaths>
+#include <QtCore/QTimer>
+#include <algorithm>
+#include <cstring>
+#include <numeric>
+#include <vector>
+
+namespace {
+
+// Native byte order: the index is a local cache, never shared between machines
+struct IndexHeader {
+    char magic[4];
+    quint32 version;
+    quint32 fileCount;
+    quint32 trigramCount;
+    quint64 filesOffset;
+    quint64 trigramsOffset;
+    quint64 postingsOffset;
+};
+
+struct TrigramEntry {
+    quint32 trigram;
+    quint32 count;
+    quint64 offset; // in postings, not bytes
+};
+
+const char INDEX_MAGIC[4] = {'T', 'T', 'R', 'I'};
+const quint32 INDEX_VERSION = 1;
+
+inline uchar foldByte(uchar c)
+{
+    return (c >= 'A' && c <= 'Z') ? uchar(c + 32) : c;
+}
+
+inline quint32 makeTrigram(uchar a, uchar b, uchar c)
+{
+    return quint32(a) << 16 | quint32(b) << 8 | quint32(c);
+}
+
+struct FileTrigrams {
+    QVector<quint32> trigrams; // sorted and unique
+    bool indexed = true;       // false when the file was too large to index
+};
+
+FileTrigrams extractTrigrams(const QString &filePath, qint64 maxSize)
+{
+    FileTrigrams result;
+    QFile file(filePath);
+    if (!file.open(QIODevice::ReadOnly))
+        return result;
+    const qint64 size = file.size();
+    if (size > maxSize) {
+        result.indexed = false;
+        return result;
+    }
+    if (size < 3)
+        return result;
+
+    QByteArray buffer;
+    const uchar *bytes = file.map(0, size);
+    if (!bytes) {
+        buffer = file.readAll();
+        bytes = reinterpret_cast<const uchar *>(buffer.constData());
+    }
+    const qint64 length = buffer.isNull() ? size : buffer.size();
+    if (FileSearch::looksBinary(reinterpret_cast<const char *>(bytes), length))
+        return result;
+
+    // One bit per possible trigram; only the bits we set are cleared again
+    thread_local std::vector<quint64> seen(1 << 18);
+    for (qint64 i = 0; i + 2 < length; ++i) {
+        const quint32 trigram = makeTrigram(foldByte(bytes[i]), foldByte(bytes[i + 1]), foldByte(bytes[i + 2]));
+        quint64 &word = seen[trigram >> 6];
+        const quint64 bit = quint64(1) << (trigram & 63);
+        if (!(word & bit)) {
+            word |= bit;
+            result.trigrams.append(trigram);
+        }
+    }
+    for (quint32 trigram : std::as_const(result.trigrams))
+        seen[trigram >> 6] = 0;
+    std::sort(result.trigrams.begin(), result.trigrams.end());
+    return result;
+}
+
+// Literal runs every match of a regular expression must contain. Anything
+// that makes a run optional or alternative (|, ?, *, {, groups with
+// modifiers or quantifiers) ends the run or, when unsure, gives up.
+QStringList requiredLiterals(const QString &pattern)
+{
+    QStringList runs;
+    QString run;
+    auto flush = [&]() {
+        if (run.size() >= 3)
+            runs.append(run);
+        run.clear();
+    };
+
+    for (qsizetype i = 0; i < pattern.size(); ++i) {
+        const QChar c = pattern.at(i);
+        switch (c.unicode()) {
+        case '\\':
+            if (i + 1 >= pattern.size())
+                return QStringList();
+            if (pattern.at(i + 1).isLetterOrNumber()) {
+                // Only escapes known to be one token end the run; longer ones
+                // (\x41, \cA, \k<name>, \p{..}, \Q..\E, back-references)
+                // would leave part of themselves behind as false literals
+                if (!QStringLiteral("wdsbntrWDSB").contains(pattern.at(i + 1)))
+                    return QStringList();
+                flush();
+            } else {
+                run += pattern.at(i + 1);
+            }
+            ++i;
+            break;
+        case '|':
+            return QStringList();
+        case '[': {
+            flush();
+            qsizetype j = i + 1;
+            if (j < pattern.size() && pattern.at(j) == QLatin1Char('^'))
+                ++j;
+            if (j < pattern.size() && pattern.at(j) == QLatin1Char(']'))
+                ++j;
+            while (j < pattern.size() && pattern.at(j) != QLatin1Char(']')) {
+                if (pattern.at(j) == QLatin1Char('\\')) {
+                    j += 2;
+                    continue;
+                }
+                // [:alpha:], [=a=] and [.a.] end in their own ']'
+                if (pattern.at(j) == QLatin1Char('[') && j + 1 < pattern.size()
+                    && QStringLiteral(":=.").contains(pattern.at(j + 1))) {
+                    const qsizetype end = pattern.indexOf(pattern.at(j + 1) + QStringLiteral("]"), j + 2);
+                    if (end < 0)
+                        return QStringList();
+                    j = end + 2;
+                    continue;
+                }
+                ++j;
+            }
+            i = j;
+            break;
+        }
+        case '(':
+            if (i + 1 < pattern.size() && pattern.at(i + 1) == QLatin1Char('?')) {
+                if (!(i + 2 < pattern.size() && pattern.at(i + 2) == QLatin1Char(':')))
+                    return QStringList();
+                i += 2;
+            }
+            flush();
+            break;
+        case ')':
+            if (i + 1 < pattern.size()
+                && QStringLiteral("*?{").contains(pattern.at(i + 1))) {
+                return QStringList();
+            }
+            flush();
+            break;
+        case '*':
+        case '?':
+        case '{':
+            run.chop(1);
+            flush();
+            if (c == QLatin1Char('{')) {
+                while (i < pattern.size() && pattern.at(i) != QLatin1Char('}'))
+                    ++i;
+            }
+            break;
+        case '+':
+        case '.':
+        case '^':
+        case '$':
+            flush();
+            break;
+        default:
+            run += c;
+            break;
+        }
+    }
+    flush();
+    return runs;
+}
+
+}
+
+TrigramIndex::TrigramIndex(const QString &rootPath, QObject *parent)
+    : QObject(parent)
+    , root(QDir(rootPath).absolutePath())
+    , mapped(nullptr)
+    , mappedSize(0)
+    , trigramTable(nullptr)
+    , trigramCount(0)
+    , postingData(nullptr)
+    , dirtySerial(0)
+    , watcher(new QFileSystemWatcher(this))
+    , validationTimer(new QTimer(this))
+    , canceled(std::make_shared<std::atomic<bool>>(false))
+    , ready(false)
+{
+    builderPool.setMaxThreadCount(1);
+    ignoreRules.load(root);
+
+    connect(watcher, &QFileSystemWatcher::directoryChanged,
+            this, &TrigramIndex::handleDirectoryChanged);
+
+    // Directory watches miss files rewritten in place, so re-check now and then
+    validationTimer->setInterval(VALIDATION_INTERVAL);
+    connect(validationTimer, &QTimer::timeout, this, &TrigramIndex::validate);
+}
+
+TrigramIndex::~TrigramIndex()
+{
+    // Builds and folder scans on the builder pool emit progress through
+    // 'this', so they are stopped and joined before any member goes away
+    canceled->store(true);
+    builderPool.waitForDone();
+    unmapIndex();
+}
+
+bool TrigramIndex::isBuilding() const
+{
+    return builder.isRunning();
+}
+
+QString TrigramIndex::indexPath() const
+{
+    const QByteArray key = QCryptographicHash::hash(root.toUtf8(), QCryptographicHash::Sha1).toHex();
+    return QStandardPaths::writableLocation(QStandardPaths::CacheLocation)
+           + QStringLiteral("/trigram/") + QString::fromLatin1(key) + QStringLiteral(".idx");
+}
+
+void TrigramIndex::open()
+{
+    if (mapIndex()) {
+        validate();
+    } else {
+        rebuild();
+    }
+}
+
+void TrigramIndex::markDirty(const QString &filePath)
+{
+    const QString path = QFileInfo(filePath).absoluteFilePath();
+    if (!path.startsWith(root + QLatin1Char('/')))
+        return;
+    dirtyFiles.insert(path, ++dirtySerial);
+    if (ready && dirtyFiles.size() > REBUILD_THRESHOLD)
+        rebuild();
+}
+
+void TrigramIndex::rebuild()
+{
+    if (isBuilding())
+        return;
+
+    const QString base = root;
+    const IgnoreRules rules = ignoreRules;
+    const QString path = indexPath();
+    const quint64 startSerial = dirtySerial;
+    const std::shared_ptr<std::atomic<bool>> cancelFlag = canceled;
+
+    builder = QtConcurrent::run(&builderPool, [this, base, rules, path, startSerial, cancelFlag]() {
+        auto isCanceled = [cancelFlag]() { return cancelFlag->load(std::memory_order_relaxed); };
+        const QDir rootDir(base);
+        QVector<Entry> files;
+        QStringList directories;
+        FileSearch::listFiles(base, rules, isCanceled,
+            [&](const QFileInfo &info) {
+                files.append({rootDir.relativeFilePath(info.filePath()),
+                              info.lastModified().toMSecsSinceEpoch(), info.size(), true});
+            },
+            [&](const QString &directory) { directories.append(directory); });
+        if (isCanceled())
+            return;
+
+        // Files are read on the shared pool; the ordered reduce appends ids
+        // in increasing order, so every posting list comes out sorted
+        QVector<int> ids(files.size());
+        std::iota(ids.begin(), ids.end(), 0);
+        QVector<char> indexedFlags(files.size(), 1);
+        QHash<quint32, QVector<quint32>> postings;
+        const QVector<Entry> &fileList = files;
+        int reduced = 0;
+
+        QtConcurrent::blockingMappedReduced<int>(ids,
+            [&fileList, &base, isCanceled](int id) {
+                if (isCanceled())
+                    return qMakePair(id, FileTrigrams());
+                return qMakePair(id, extractTrigrams(base + QLatin1Char('/') + fileList.at(id).path,
+                                                     MAX_INDEXED_FILE_SIZE));
+            },
+            [&](int &, const QPair<int, FileTrigrams> &result) {
+                indexedFlags[result.first] = result.second.indexed;
+                for (quint32 trigram : result.second.trigrams)
+                    postings[trigram].append(quint32(result.first));
+                if (++reduced % 1000 == 0) {
+                    const int count = reduced;
+                    QMetaObject::invokeMethod(this, [this, count]() { emit buildProgress(count); },
+                                              Qt::QueuedConnection);
+                }
+            },
+            QtConcurrent::OrderedReduce);
+        if (isCanceled())
+            return;
+
+        for (int i = 0; i < files.size(); ++i)
+            files[i].indexed = indexedFlags.at(i);
+        if (!writeIndex(path, files, postings))
+            return;
+
+        QMetaObject::invokeMethod(this, [this, directories, startSerial]() {
+            unmapIndex();
+            if (!mapIndex())
+                return;
+            // Files marked before the build started are now up to date
+            for (auto it = dirtyFiles.begin(); it != dirtyFiles.end(); ) {
+                if (it.value() <= startSerial)
+                    it = dirtyFiles.erase(it);
+                else
+                    ++it;
+            }
+            watchDirectories(directories);
+            ready = true;
+            validationTimer->start();
+            emit indexReady(entries.size());
+        }, Qt::QueuedConnection);
+    });
+}
+
+void TrigramIndex::validate()
+{
+    if (isBuilding())
+        return;
+
+    // Compare what is on disk with what was indexed, off the GUI thread
+    QHash<QString, QPair<qint64, qint64>> known;
+    known.reserve(entries.size());
+    for (const Entry &entry : std::as_const(entries))
+        known.insert(entry.path, qMakePair(entry.modified, entry.size));
+
+    const QString base = root;
+    const IgnoreRules rules = ignoreRules;
+    const std::shared_ptr<std::atomic<bool>> cancelFlag = canceled;
+
+    builder = QtConcurrent::run(&builderPool, [this, base, rules, known, cancelFlag]() {
+        auto isCanceled = [cancelFlag]() { return cancelFlag->load(std::memory_order_relaxed); };
+        const QDir rootDir(base);
+        QStringList changed;
+        QStringList directories;
+        FileSearch::listFiles(base, rules, isCanceled,
+            [&](const QFileInfo &info) {
+                auto it = known.constFind(rootDir.relativeFilePath(info.filePath()));
+                if (it == known.constEnd() || it->first != info.lastModified().toMSecsSinceEpoch()
+                    || it->second != info.size()) {
+                    changed.append(info.filePath());
+                }
+            },
+            [&](const QString &directory) { directories.append(directory); });
+        if (isCanceled())
+            return;
+
+        QMetaObject::invokeMethod(this, [this, changed, directories]() {
+            for (const QString &path : changed)
+                dirtyFiles.insert(path, ++dirtySerial);
+            watchDirectories(directories);
+            ready = true;
+            validationTimer->start();
+            emit indexReady(entries.size());
+            if (dirtyFiles.size() > REBUILD_THRESHOLD)
+                rebuild();
+        }, Qt::QueuedConnection);
+    });
+}
+
+void TrigramIndex::watchDirectories(const QStringList &directories)
+{
+    QStringList added;
+    for (const QString &directory : directories) {
+        if (watchedDirectories.size() + added.size() >= MAX_WATCHED_DIRECTORIES)
+            break;
+        if (!watchedDirectories.contains(directory))
+            added.append(directory);
+    }
+    if (added.isEmpty())
+        return;
+    watcher->addPaths(added);
+    for (const QString &directory : std::as_const(added))
+        watchedDirectories.insert(directory);
+}
+
+bool TrigramIndex::isStale(const QString &relativePath, const QFileInfo &info) const
+{
+    const int id = entryIds.value(relativePath, -1);
+    if (id < 0)
+        return true;
+    const Entry &entry = entries.at(id);
+    return entry.modified != info.lastModified().toMSecsSinceEpoch() || entry.size != info.size();
+}
+
+void TrigramIndex::handleDirectoryChanged(const QString &directory)
+{
+    if (!QFileInfo::exists(directory)) {
+        watchedDirectories.remove(directory);
+        return;
+    }
+
+    const QDir rootDir(root);
+    QStringList newDirectories;
+    QDirIterator it(directory, QDir::AllEntries | QDir::NoDotAndDotDot | QDir::Hidden | QDir::NoSymLinks);
+    while (it.hasNext()) {
+        it.next();
+        const QFileInfo info = it.fileInfo();
+        const QString relativePath = rootDir.relativeFilePath(info.filePath());
+        if (ignoreRules.isIgnored(info.fileName(), relativePath))
+            continue;
+
+        if (info.isDir()) {
+            if (!watchedDirectories.contains(info.filePath())
+                && !scanningDirectories.contains(info.filePath())) {
+                newDirectories.append(info.filePath());
+            }
+        } else if (info.isFile() && isStale(relativePath, info)) {
+            dirtyFiles.insert(info.filePath(), ++dirtySerial);
+        }
+    }
+
+    scanNewDirectories(newDirectories);
+    if (ready && dirtyFiles.size() > REBUILD_THRESHOLD)
+        rebuild();
+}
+
+// Everything in a new folder is unindexed. A copied-in tree can be huge, so
+// it is walked on the builder pool and the files are marked once it is done
+void TrigramIndex::scanNewDirectories(const QStringList &directories)
+{
+    if (directories.isEmpty())
+        return;
+    for (const QString &directory : directories)
+        scanningDirectories.insert(directory);
+
+    const IgnoreRules rules = ignoreRules;
+    const std::shared_ptr<std::atomic<bool>> cancelFlag = canceled;
+
+    builderPool.start([this, directories, rules, cancelFlag]() {
+        auto isCanceled = [cancelFlag]() { return cancelFlag->load(std::memory_order_relaxed); };
+        QStringList files;
+        QStringList found;
+        for (const QString &directory : directories) {
+            FileSearch::listFiles(directory, rules, isCanceled,
+                [&files](const QFileInfo &info) { files.append(info.filePath()); },
+                [&found](const QString &path) { found.append(path); });
+        }
+        if (isCanceled())
+            return;
+
+        QMetaObject::invokeMethod(this, [this, directories, files, found]() {
+            for (const QString &directory : directories)
+                scanningDirectories.remove(directory);
+            for (const QString &path : files)
+                dirtyFiles.insert(path, ++dirtySerial);
+            watchDirectories(found);
+            if (ready && dirtyFiles.size() > REBUILD_THRESHOLD)
+                rebuild();
+        }, Qt::QueuedConnection);
+    });
+}
+
+bool TrigramIndex::writeIndex(const QString &path, const QVector<Entry> &files,
+                              const QHash<quint32, QVector<quint32>> &postings)
+{
+    QDir().mkpath(QFileInfo(path).absolutePath());
+    QSaveFile out(path);
+    if (!out.open(QIODevice::WriteOnly))
+        return false;
+
+    QByteArray fileTable;
+    for (const Entry &entry : files) {
+        const QByteArray name = entry.path.toUtf8();
+        const quint32 flags = entry.indexed ? 1 : 0;
+        const quint32 length = quint32(name.size());
+        fileTable.append(reinterpret_cast<const char *>(&entry.modified), sizeof(entry.modified));
+        fileTable.append(reinterpret_cast<const char *>(&entry.size), sizeof(entry.size));
+        fileTable.append(reinterpret_cast<const char *>(&flags), sizeof(flags));
+        fileTable.append(reinterpret_cast<const char *>(&length), sizeof(length));
+        fileTable.append(name);
+    }
+    // Keep the trigram table 8-byte aligned in the mapping
+    while (fileTable.size() % 8)
+        fileTable.append('\0');
+
+    QVector<quint32> trigrams = postings.keys();
+    std::sort(trigrams.begin(), trigrams.end());
+
+    IndexHeader header;
+    std::memcpy(header.magic, INDEX_MAGIC, sizeof(header.magic));
+    header.version = INDEX_VERSION;
+    header.fileCount = quint32(files.size());
+    header.trigramCount = quint32(trigrams.size());
+    header.filesOffset = sizeof(IndexHeader);
+    header.trigramsOffset = header.filesOffset + quint64(fileTable.size());
+    header.postingsOffset = header.trigramsOffset + quint64(trigrams.size()) * sizeof(TrigramEntry);
+
+    QByteArray table;
+    table.reserve(trigrams.size() * int(sizeof(TrigramEntry)));
+    quint64 offset = 0;
+    for (quint32 trigram : std::as_const(trigrams)) {
+        const TrigramEntry entry = {trigram, quint32(postings.value(trigram).size()), offset};
+        table.append(reinterpret_cast<const char *>(&entry), sizeof(entry));
+        offset += entry.count;
+    }
+
+    out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    out.write(fileTable);
+    out.write(table);
+    for (quint32 trigram : std::as_const(trigrams)) {
+        const QVector<quint32> &list = postings.value(trigram);
+        out.write(reinterpret_cast<const char *>(list.constData()), qint64(list.size()) * sizeof(quint32));
+    }
+    return out.commit();
+}
+
+bool TrigramIndex::mapIndex()
+{
+    indexFile.setFileName(indexPath());
+    if (!indexFile.open(QIODevice::ReadOnly))
+        return false;
+
+    mappedSize = indexFile.size();
+    mapped = mappedSize >= qint64(sizeof(IndexHeader)) ? indexFile.map(0, mappedSize) : nullptr;
+    if (!mapped) {
+        unmapIndex();
+        return false;
+    }
+
+    IndexHeader header;
+    std::memcpy(&header, mapped, sizeof(header));
+    const quint64 postingsEnd = header.postingsOffset;
+    if (std::memcmp(header.magic, INDEX_MAGIC, sizeof(header.magic)) != 0
+        || header.version != INDEX_VERSION
+        || header.trigramsOffset % 8 != 0
+        || header.trigramsOffset + quint64(header.trigramCount) * sizeof(TrigramEntry) != postingsEnd
+        || postingsEnd > quint64(mappedSize)) {
+        unmapIndex();
+        return false;
+    }
+
+    entries.clear();
+    entryIds.clear();
+    unindexedFiles.clear();
+    entries.reserve(header.fileCount);
+    const uchar *p = mapped + header.filesOffset;
+    const uchar *end = mapped + header.trigramsOffset;
+    for (quint32 i = 0; i < header.fileCount; ++i) {
+        Entry entry;
+        quint32 flags;
+        quint32 length;
+        if (end - p < qint64(2 * sizeof(qint64) + 2 * sizeof(quint32))) {
+            unmapIndex();
+            return false;
+        }
+        std::memcpy(&entry.modified, p, sizeof(qint64));
+        std::memcpy(&entry.size, p + 8, sizeof(qint64));
+        std::memcpy(&flags, p + 16, sizeof(quint32));
+        std::memcpy(&length, p + 20, sizeof(quint32));
+        p += 24;
+        if (end - p < qint64(length)) {
+            unmapIndex();
+            return false;
+        }
+        entry.path = QString::fromUtf8(reinterpret_cast<const char *>(p), length);
+        entry.indexed = flags & 1;
+        p += length;
+        if (!entry.indexed)
+            unindexedFiles.append(root + QLatin1Char('/') + entry.path);
+        entryIds.insert(entry.path, entries.size());
+        entries.append(entry);
+    }
+
+    trigramTable = mapped + header.trigramsOffset;
+    trigramCount = header.trigramCount;
+    postingData = reinterpret_cast<const quint32 *>(mapped + header.postingsOffset);
+    return true;
+}
+
+void TrigramIndex::unmapIndex()
+{
+    if (mapped)
+        indexFile.unmap(const_cast<uchar *>(mapped));
+    indexFile.close();
+    mapped = nullptr;
+    mappedSize = 0;
+    trigramTable = nullptr;
+    trigramCount = 0;
+    postingData = nullptr;
+    entries.clear();
+    entryIds.clear();
+    unindexedFiles.clear();
+}
+
+const quint32 *TrigramIndex::postingList(quint32 trigram, quint32 *count) const
+{
+    const TrigramEntry *table = reinterpret_cast<const TrigramEntry *>(trigramTable);
+    const TrigramEntry *last = table + trigramCount;
+    const TrigramEntry *it = std::lower_bound(table, last, trigram,
+        [](const TrigramEntry &entry, quint32 value) { return entry.trigram < value; });
+    if (it == last || it->trigram != trigram)
+        return nullptr;
+
+    const quint64 begin = quint64(reinterpret_cast<const uchar *>(postingData + it->offset) - mapped);
+    if (begin + quint64(it->count) * sizeof(quint32) > quint64(mappedSize))
+        return nullptr;
+    *count = it->count;
+    return postingData + it->offset;
+}
+
+QVector<quint32> TrigramIndex::queryTrigrams(const QString &pattern, const SearchOptions &options)
+{
+    const QStringList fragments = options.regularExpression ? requiredLiterals(pattern) : QStringList(pattern);
+
+    QVector<quint32> trigrams;
+    for (const QString &fragment : fragments) {
+        const QByteArray bytes = fragment.toUtf8();
+        for (qsizetype i = 0; i + 2 < bytes.size(); ++i) {
+            const uchar a = foldByte(uchar(bytes.at(i)));
+            const uchar b = foldByte(uchar(bytes.at(i + 1)));
+            const uchar c = foldByte(uchar(bytes.at(i + 2)));
+            // Case-insensitive matches may differ from the query outside
+            // ASCII, and 'k'/'s' also match KELVIN SIGN and LONG S
+            if (!options.caseSensitive
+                && (a >= 0x80 || b >= 0x80 || c >= 0x80
+                    || a == 'k' || b == 'k' || c == 'k' || a == 's' || b == 's' || c == 's')) {
+                continue;
+            }
+            trigrams.append(makeTrigram(a, b, c));
+        }
+    }
+    std::sort(trigrams.begin(), trigrams.end());
+    trigrams.erase(std::unique(trigrams.begin(), trigrams.end()), trigrams.end());
+    return trigrams;
+}
+
+QStringList TrigramIndex::candidates(const QString &pattern, const SearchOptions &options,
+                                     bool *narrowed) const
+{
+    *narrowed = false;
+    if (!ready || !mapped)
+        return QStringList();
+
+    const QVector<quint32> trigrams = queryTrigrams(pattern, options);
+    if (trigrams.isEmpty())
+        return QStringList();
+    *narrowed = true;
+
+    // Intersect the posting lists, shortest first
+    QVector<QPair<const quint32 *, quint32>> lists;
+    bool missing = false;
+    for (quint32 trigram : trigrams) {
+        quint32 count = 0;
+        const quint32 *list = postingList(trigram, &count);
+        if (!list) {
+            missing = true;
+            break;
+        }
+        lists.append(qMakePair(list, count));
+    }
+
+    QVector<quint32> ids;
+    if (!missing) {
+        std::sort(lists.begin(), lists.end(),
+                  [](const QPair<const quint32 *, quint32> &a, const QPair<const quint32 *, quint32> &b) {
+                      return a.second < b.second;
+                  });
+        ids = QVector<quint32>(lists.first().first, lists.first().first + lists.first().second);
+        for (int i = 1; i < lists.size() && !ids.isEmpty(); ++i) {
+            QVector<quint32> next;
+            std::set_intersection(ids.constBegin(), ids.constEnd(),
+                                  lists.at(i).first, lists.at(i).first + lists.at(i).second,
+                                  std::back_inserter(next));
+            ids.swap(next);
+        }
+    }
+
+    QSet<QString> files;
+    for (quint32 id : std::as_const(ids)) {
+        if (id < quint32(entries.size()))
+            files.insert(root + QLatin1Char('/') + entries.at(id).path);
+    }
+    for (const QString &path : unindexedFiles)
+        files.insert(path);
+    for (auto it = dirtyFiles.constBegin(); it != dirtyFiles.constEnd(); ++it)
+        files.insert(it.key());
+    return files.values();
+}
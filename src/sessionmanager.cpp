@@ -1,47 +1,159 @@
 #include "sessionmanager.h"
 #include "editor.h"
+#include "profiler.h"
+#include "crashhandler.h"
+#include "editjournal.h"
+#include "autosaveservice.h"
+#include "savescheduler.h"
 #include <QFile>
 #include <QDir>
+#include <QFileInfo>
+#include <QJsonArray>
 #include <QJsonDocument>
 #include <QJsonObject>
 #include <QStandardPaths>
 #include <QTextStream>
 #include <QApplication>
+#include <QSet>
 
-SessionManager::SessionManager(CodeEditor *editor, QObject *parent)
+namespace {
+
+QJsonObject documentToJson(const DocumentState &document)
+{
+    QJsonObject obj;
+    obj["filePath"] = document.filePath;
+    obj["cursorPosition"] = document.cursorPosition;
+    obj["scrollPosition"] = document.scrollPosition;
+    obj["modified"] = document.modified;
+
+    QJsonArray folds;
+    for (int block : document.foldedBlocks)
+        folds.append(block);
+    obj["foldedBlocks"] = folds;
+
+    QJsonArray chunks;
+    for (const QByteArray &id : document.contentChunks)
+        chunks.append(QString::fromLatin1(id.toHex()));
+    obj["content"] = chunks;
+    return obj;
+}
+
+DocumentState documentFromJson(const QJsonObject &obj)
+{
+    DocumentState document;
+    document.filePath = obj["filePath"].toString();
+    document.cursorPosition = obj["cursorPosition"].toInt();
+    document.scrollPosition = obj["scrollPosition"].toInt();
+    document.modified = obj["modified"].toBool();
+    for (const QJsonValue &block : obj["foldedBlocks"].toArray())
+        document.foldedBlocks.append(block.toInt());
+    for (const QJsonValue &id : obj["content"].toArray())
+        document.contentChunks.append(QByteArray::fromHex(id.toString().toLatin1()));
+    return document;
+}
+
+} // namespace
+
+SessionManager::SessionManager(SaveScheduler *scheduler, QObject *parent)
     : QObject(parent)
-    , editor(editor)
-    , autoSaveTimer(new QTimer(this))
+    , editor(nullptr)
+    , scheduler(scheduler)
+    , journal(nullptr)
+    , contentStore(getContentDirectory())
     , documentModified(false)
 {
-    autoSaveTimer->setInterval(AUTO_SAVE_INTERVAL);
-    connect(autoSaveTimer, &QTimer::timeout, this, &SessionManager::autoSave);
-    connect(editor, &CodeEditor::textChanged, this, &SessionManager::handleTextChanged);
+    ioPool.setMaxThreadCount(1);
+    ioPool.start([this]() { contentStore.scan(); });
+
+    // Keep the last run's journal aside for recovery before this run starts its own
+    if (EditJournal::hasData(getJournalDirectory())) {
+        EditJournal::discard(getRecoveryJournalDirectory());
+        QDir().rename(getJournalDirectory(), getRecoveryJournalDirectory());
+    }
+    journal = new EditJournal(getJournalDirectory(), this);
     
     loadSessionData();
 }
 
 SessionManager::~SessionManager()
 {
-    if (documentModified) {
-        saveSession();
+    saveSession();
+    ioPool.waitForDone();
+
+    // Unsaved text is in the session now; the journal only matters after a crash
+    delete journal;
+    journal = nullptr;
+    EditJournal::discard(getJournalDirectory());
+}
+
+// The journal follows the document being edited. It is only restarted from
+// a checkpoint at the first edit after a switch or a load, so flipping
+// between tabs writes nothing.
+void SessionManager::setEditor(CodeEditor *newEditor)
+{
+    if (editor == newEditor) {
+        return;
+    }
+    if (editor) {
+        disconnect(editor, nullptr, this, nullptr);
+        disconnect(editor, nullptr, journal, nullptr);
+    }
+    editor = newEditor;
+    connect(editor, &CodeEditor::textChanged, this, &SessionManager::handleTextChanged);
+    connect(editor, &CodeEditor::textEdited, this, &SessionManager::followEdits);
+    connect(editor, &CodeEditor::documentReset, this, [this]() {
+        if (journalEditor == editor)
+            journalEditor = nullptr;
+    });
+    handleTextChanged();
+}
+
+void SessionManager::followEdits(int position, int charsRemoved, const QString &inserted)
+{
+    // The snapshot already includes this edit, so a fresh checkpoint replaces the record.
+    // A huge paste is cheaper that way too.
+    if (journalEditor != editor || !journal->append(position, charsRemoved, inserted)) {
+        journalEditor = editor;
+        currentSession.journalFilePath = currentFilePath;
+        journal->checkpoint(editor->documentSnapshot());
     }
 }
 
 void SessionManager::startAutoSave()
 {
-    autoSaveTimer->start();
+    scheduler->addClient(this, AUTO_SAVE_MAX_LATENCY, [this]() { autoSave(); });
+    if (documentModified) {
+        scheduler->markDirty(this);
+    }
 }
 
 void SessionManager::stopAutoSave()
 {
-    autoSaveTimer->stop();
+    scheduler->removeClient(this);
+}
+
+void SessionManager::setDocumentProvider(const std::function<void(QList<DocumentState> *, int *)> &provider)
+{
+    documentProvider = provider;
+}
+
+// Only called when a document is first shown, so a large session costs nothing up front
+bool SessionManager::loadDocumentContent(const DocumentState &document, QString *text) const
+{
+    QByteArray data;
+    if (!ChunkStore::load(getContentDirectory(), document.contentChunks, &data)) {
+        return false;
+    }
+    *text = QString::fromUtf8(data);
+    return true;
 }
 
 void SessionManager::setCurrentFile(const QString &filePath)
 {
     currentFilePath = filePath;
     currentSession.filePath = filePath;
+    if (journalEditor && journalEditor == editor)
+        currentSession.journalFilePath = filePath;
     saveSessionData();
 }
 
@@ -52,6 +164,24 @@ QString SessionManager::getAutoSaveFilePath() const
     return basePath + "/autosave.txt";
 }
 
+QString SessionManager::getJournalDirectory() const
+{
+    QString basePath = QStandardPaths::writableLocation(QStandardPaths::AppDataLocation);
+    return basePath + "/journal";
+}
+
+QString SessionManager::getRecoveryJournalDirectory() const
+{
+    QString basePath = QStandardPaths::writableLocation(QStandardPaths::AppDataLocation);
+    return basePath + "/journal-recovery";
+}
+
+QString SessionManager::getContentDirectory() const
+{
+    QString basePath = QStandardPaths::writableLocation(QStandardPaths::AppDataLocation);
+    return basePath + "/session-content";
+}
+
 QString SessionManager::getSessionFilePath() const
 {
     QString basePath = QStandardPaths::writableLocation(QStandardPaths::AppDataLocation);
@@ -61,34 +191,37 @@ QString SessionManager::getSessionFilePath() const
 
 void SessionManager::autoSave()
 {
-    if (!documentModified) {
+    PROFILE_SCOPE(AutoSave);
+    if (!documentModified || !editor) {
         return;
     }
 
-    QFile file(getAutoSaveFilePath());
-    if (file.open(QIODevice::WriteOnly | QIODevice::Text)) {
-        QTextStream out(&file);
-        out << editor->toPlainText();
-        file.close();
-        
-        currentSession.content = editor->toPlainText();
-        currentSession.cursorPosition = editor->textCursor().position();
-        currentSession.lastSaved = QDateTime::currentDateTime();
-        currentSession.isAutoSaved = true;
-        
-        saveSessionData();
-        documentModified = false;
+    // The journal already holds every edit; only fold it into a new
+    // checkpoint once it has grown enough to make replay slow
+    journal->flush();
+    if (journalEditor && journal->bytesSinceCheckpoint() > COMPACT_THRESHOLD) {
+        journal->checkpoint(journalEditor->documentSnapshot());
     }
+
+    currentSession.cursorPosition = editor->textCursor().position();
+    currentSession.lastSaved = QDateTime::currentDateTime();
+    currentSession.isAutoSaved = true;
+
+    saveSessionData();
+    documentModified = false;
 }
 
 void SessionManager::handleTextChanged()
 {
     documentModified = true;
+    scheduler->markDirty(this);
 }
 
 bool SessionManager::hasAutoSavedSession() const
 {
-    return currentSession.isAutoSaved && QFile::exists(getAutoSaveFilePath());
+    return currentSession.isAutoSaved
+        && (CrashHandler::hasRecoveryDump() || EditJournal::hasData(getRecoveryJournalDirectory())
+            || QFile::exists(getAutoSaveFilePath()));
 }
 
 SessionData SessionManager::getLastSession() const
@@ -96,9 +229,41 @@ SessionData SessionManager::getLastSession() const
     return currentSession;
 }
 
+// The text to restore, from the most precise source available
+QString SessionManager::recoverContent() const
+{
+    if (CrashHandler::hasRecoveryDump()) {
+        return CrashHandler::readRecoveryDump();
+    }
+
+    QString text;
+    if (EditJournal::recover(getRecoveryJournalDirectory(), &text)) {
+        return text;
+    }
+
+    // Autosave files written before the journal existed
+    QFile autoSaveFile(getAutoSaveFilePath());
+    if (autoSaveFile.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        QTextStream in(&autoSaveFile);
+        text = in.readAll();
+    }
+    return text;
+}
+
+QString SessionManager::recoveredFilePath() const
+{
+    // The crash dump is of the active document; the journal of the last one edited
+    if (!CrashHandler::hasRecoveryDump() && EditJournal::hasData(getRecoveryJournalDirectory())) {
+        return recoveryJournalFilePath;
+    }
+    return currentSession.filePath;
+}
+
 void SessionManager::clearAutoSavedSession()
 {
     QFile::remove(getAutoSaveFilePath());
+    CrashHandler::clearRecoveryDump();
+    EditJournal::discard(getRecoveryJournalDirectory());
     currentSession.isAutoSaved = false;
     saveSessionData();
 }
@@ -117,36 +282,78 @@ void SessionManager::loadSessionData()
         QJsonObject obj = doc.object();
         
         currentSession.filePath = obj["filePath"].toString();
+        // Older sessions journaled the active document only
+        recoveryJournalFilePath = obj["journalFilePath"].toString(currentSession.filePath);
         currentSession.cursorPosition = obj["cursorPosition"].toInt();
         currentSession.lastSaved = QDateTime::fromString(obj["lastSaved"].toString(), Qt::ISODate);
         currentSession.isAutoSaved = obj["isAutoSaved"].toBool();
         
-        file.close();
+        for (const QJsonValue &document : obj["documents"].toArray()) {
+            currentSession.documents.append(documentFromJson(document.toObject()));
+        }
+        currentSession.activeDocument = obj["activeDocument"].toInt(-1);
         
-        // Load auto-saved content if it exists
-        if (currentSession.isAutoSaved) {
-            QFile autoSaveFile(getAutoSaveFilePath());
-            if (autoSaveFile.open(QIODevice::ReadOnly | QIODevice::Text)) {
-                QTextStream in(&autoSaveFile);
-                currentSession.content = in.readAll();
-                autoSaveFile.close();
-            }
+        // Sessions written before multiple documents only name one file
+        if (!obj.contains("documents") && !currentSession.filePath.isEmpty()) {
+            DocumentState document;
+            document.filePath = currentSession.filePath;
+            document.cursorPosition = currentSession.cursorPosition;
+            currentSession.documents.append(document);
+            currentSession.activeDocument = 0;
         }
+        
+        file.close();
+    }
+
+    // A crash can come before the first autosave marked the session, but the
+    // crash dump and the journal are written as soon as there is something to keep
+    if (CrashHandler::hasRecoveryDump()) {
+        currentSession.lastSaved = QFileInfo(CrashHandler::recoveryFilePath()).lastModified();
+        currentSession.isAutoSaved = true;
+    } else if (EditJournal::hasData(getRecoveryJournalDirectory())) {
+        currentSession.lastSaved = QFileInfo(getRecoveryJournalDirectory()).lastModified();
+        currentSession.isAutoSaved = true;
     }
 }
 
 void SessionManager::saveSessionData()
 {
-    QJsonObject obj;
-    obj["filePath"] = currentSession.filePath;
-    obj["cursorPosition"] = currentSession.cursorPosition;
-    obj["lastSaved"] = currentSession.lastSaved.toString(Qt::ISODate);
-    obj["isAutoSaved"] = currentSession.isAutoSaved;
-    
-    QJsonDocument doc(obj);
-    QFile file(getSessionFilePath());
-    if (file.open(QIODevice::WriteOnly)) {
-        file.write(doc.toJson());
-        file.close();
+    if (documentProvider) {
+        documentProvider(&currentSession.documents, &currentSession.activeDocument);
     }
-} 
\ No newline at end of file
+    
+    const SessionData session = currentSession;
+    const QString sessionPath = getSessionFilePath();
+    ioPool.start([this, session, sessionPath]() {
+        // Chunks go first, so the session file never names one that isn't on disk
+        QSet<QByteArray> live;
+        QJsonArray documents;
+        for (DocumentState document : session.documents) {
+            if (!document.unsavedText.isNull()) {
+                const QByteArray data = document.unsavedText.toUtf8();
+                document.contentChunks = contentStore.store(data);
+                if (document.contentChunks.isEmpty() && !data.isEmpty()) {
+                    return;
+                }
+            }
+            for (const QByteArray &id : std::as_const(document.contentChunks)) {
+                live.insert(id);
+            }
+            documents.append(documentToJson(document));
+        }
+        
+        QJsonObject obj;
+        obj["filePath"] = session.filePath;
+        obj["journalFilePath"] = session.journalFilePath;
+        obj["cursorPosition"] = session.cursorPosition;
+        obj["lastSaved"] = session.lastSaved.toString(Qt::ISODate);
+        obj["isAutoSaved"] = session.isAutoSaved;
+        obj["documents"] = documents;
+        obj["activeDocument"] = session.activeDocument;
+        
+        QJsonDocument doc(obj);
+        if (AutoSaveService::writeSnapshot(sessionPath, QString::fromUtf8(doc.toJson())).isEmpty()) {
+            contentStore.retain(live);
+        }
+    });
+}
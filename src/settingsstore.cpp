@@ -0,0 +1,154 @@
+#include "settingsstore.h"
+#include <QCoreApplication>
+#include <QSettings>
+
+namespace {
+
+struct KeyInfo {
+    const char *name;
+    const char *legacyName; // in the dialog's old "TextEditor/Settings" store
+};
+
+const KeyInfo KEYS[SettingsStore::KeyCount] = {
+    {"editor/font/family", "font/family"},
+    {"editor/font/size", "font/size"},
+    {"editor/tabSize", "editor/tabSize"},
+    {"editor/autoIndent", "editor/autoIndent"},
+    {"editor/lineWrapping", "editor/lineWrapping"},
+    {"editor/theme", "theme/name"},
+    {"editor/colors/background", "theme/editorBackground"},
+    {"editor/colors/foreground", "theme/editorForeground"},
+    {"editor/colors/lineNumberBackground", "theme/lineNumberBackground"},
+    {"editor/colors/lineNumberForeground", "theme/lineNumberForeground"},
+    {"editor/colors/currentLine", "theme/currentLine"},
+    {"editor/autoSave/enabled", "autoSave/enabled"},
+    {"editor/autoSave/interval", "autoSave/interval"},
+};
+
+} // namespace
+
+SettingsStore &SettingsStore::instance()
+{
+    static SettingsStore store;
+    return store;
+}
+
+SettingsStore::SettingsStore()
+    : dirtyKeys(0)
+{
+    writeTimer = new QTimer(this);
+    writeTimer->setSingleShot(true);
+    writeTimer->setInterval(WRITE_DELAY);
+    connect(writeTimer, &QTimer::timeout, this, &SettingsStore::flush);
+    if (QCoreApplication *app = QCoreApplication::instance())
+        connect(app, &QCoreApplication::aboutToQuit, this, &SettingsStore::flush);
+    load();
+}
+
+SettingsStore::~SettingsStore()
+{
+    flush();
+}
+
+QVariant SettingsStore::defaultValue(Key key)
+{
+    switch (key) {
+    case FontFamily: return QString("Monospace");
+    case FontSize: return 12;
+    case TabSize: return 4;
+    case AutoIndent: return true;
+    case LineWrapping: return false;
+    case Theme: return QString("Light");
+    case EditorBackground: return QColor(Qt::white);
+    case EditorForeground: return QColor(Qt::black);
+    case LineNumberBackground: return QColor(Qt::lightGray);
+    case LineNumberForeground: return QColor(Qt::black);
+    case CurrentLine: return QColor(Qt::yellow).lighter(160);
+    case AutoSaveEnabled: return false;
+    case AutoSaveInterval: return 5;
+    case KeyCount: break;
+    }
+    return QVariant();
+}
+
+void SettingsStore::load()
+{
+    QSettings settings;
+    QSettings legacy("TextEditor", "Settings");
+    for (int i = 0; i < KeyCount; ++i) {
+        const Key key = Key(i);
+        const QVariant fallback = defaultValue(key);
+        QVariant stored = settings.value(KEYS[i].name);
+        if (!stored.isValid()) {
+            stored = legacy.value(KEYS[i].legacyName);
+            if (stored.isValid())
+                dirtyKeys |= 1u << i;
+        }
+        // Text-based backends hand back strings, so coerce to the default's type
+        if (!stored.isValid() || !stored.convert(fallback.metaType()))
+            stored = fallback;
+        values[i] = stored;
+    }
+    if (dirtyKeys)
+        writeTimer->start();
+}
+
+void SettingsStore::setValue(Key key, const QVariant &value)
+{
+    setValues({{key, value}});
+}
+
+void SettingsStore::setValues(const QHash<Key, QVariant> &changes)
+{
+    quint32 changed = 0;
+    for (auto it = changes.constBegin(); it != changes.constEnd(); ++it) {
+        if (values[it.key()] == it.value())
+            continue;
+        values[it.key()] = it.value();
+        changed |= 1u << it.key();
+    }
+    if (!changed)
+        return;
+
+    dirtyKeys |= changed;
+    writeTimer->start();
+    for (int i = 0; i < KeyCount; ++i) {
+        if (changed & (1u << i))
+            emit valueChanged(Key(i), values[i]);
+    }
+
+    // Copy first: a callback may subscribe or destroy a receiver
+    const QList<Subscription> current = subscriptions;
+    for (const Subscription &subscription : current) {
+        if (subscription.receiver && (subscription.keys & changed))
+            subscription.changed();
+    }
+}
+
+void SettingsStore::subscribe(QObject *receiver, const QList<Key> &keys, const std::function<void()> &changed)
+{
+    Subscription subscription;
+    subscription.receiver = receiver;
+    subscription.keys = 0;
+    for (Key key : keys)
+        subscription.keys |= 1u << key;
+    subscription.changed = changed;
+    subscriptions.append(subscription);
+    // Guards are already cleared when destroyed() is emitted
+    connect(receiver, &QObject::destroyed, this, [this]() {
+        subscriptions.removeIf([](const Subscription &entry) { return entry.receiver.isNull(); });
+    });
+}
+
+void SettingsStore::flush()
+{
+    writeTimer->stop();
+    if (!dirtyKeys)
+        return;
+    QSettings settings;
+    for (int i = 0; i < KeyCount; ++i) {
+        if (dirtyKeys & (1u << i))
+            settings.setValue(KEYS[i].name, values[i]);
+    }
+    dirtyKeys = 0;
+}
@@ -0,0 +1,117 @@
+#include "singleinstance.h"
+#include <QLocalServer>
+#include <QLocalSocket>
+#include <QDataStream>
+#include <QCryptographicHash>
+#include <QDir>
+#include <QFileInfo>
+
+SingleInstance::SingleInstance(QObject *parent)
+    : QObject(parent), server(nullptr)
+{
+}
+
+QString SingleInstance::serverName()
+{
+    // One server per user, without putting the user's home path in the name
+    const QByteArray home = QDir::homePath().toUtf8();
+    return "TextEditor-" + QString::fromLatin1(QCryptographicHash::hash(home, QCryptographicHash::Sha1).toHex().left(16));
+}
+
+bool SingleInstance::listen()
+{
+    server = new QLocalServer(this);
+    server->setSocketOptions(QLocalServer::UserAccessOption);
+    if (!server->listen(serverName())) {
+        // A crashed instance can leave its socket behind. Only a socket nobody
+        // answers on is stale: a live or busy instance still accepts, and
+        // removing its socket would orphan it.
+        QLocalSocket probe;
+        probe.connectToServer(serverName());
+        if (probe.waitForConnected(CONNECT_TIMEOUT))
+            return false;
+        if (probe.error() != QLocalSocket::ConnectionRefusedError
+            && probe.error() != QLocalSocket::ServerNotFoundError)
+            return false;
+        QLocalServer::removeServer(serverName());
+        if (!server->listen(serverName()))
+            return false;
+    }
+    connect(server, &QLocalServer::newConnection, this, &SingleInstance::handleConnection);
+    return true;
+}
+
+bool SingleInstance::forward(const QStringList &files, bool wait)
+{
+    QLocalSocket socket;
+    socket.connectToServer(serverName());
+    if (!socket.waitForConnected(CONNECT_TIMEOUT))
+        return false;
+
+    QByteArray message;
+    QDataStream out(&message, QIODevice::WriteOnly);
+    out << PROTOCOL_VERSION << wait << files;
+    socket.write(message);
+    if (!socket.waitForBytesWritten(CONNECT_TIMEOUT))
+        return false;
+
+    // The running instance hangs up once the files are closed, or when it exits
+    if (wait && !files.isEmpty()) {
+        if (socket.state() == QLocalSocket::ConnectedState)
+            socket.waitForDisconnected(-1);
+    } else {
+        socket.disconnectFromServer();
+    }
+    return true;
+}
+
+void SingleInstance::handleConnection()
+{
+    while (QLocalSocket *socket = server->nextPendingConnection()) {
+        connect(socket, &QLocalSocket::readyRead, this, [this, socket]() { readMessage(socket); });
+        connect(socket, &QLocalSocket::disconnected, this, [this, socket]() {
+            waiting.remove(socket);
+            socket->deleteLater();
+        });
+    }
+}
+
+void SingleInstance::readMessage(QLocalSocket *socket)
+{
+    QDataStream in(socket);
+    in.startTransaction();
+    quint32 version = 0;
+    bool wait = false;
+    QStringList files;
+    in >> version >> wait >> files;
+    // Waits for the rest of the message if it hasn't all arrived
+    if (!in.commitTransaction())
+        return;
+    if (version != PROTOCOL_VERSION) {
+        socket->disconnectFromServer();
+        return;
+    }
+
+    if (wait && !files.isEmpty())
+        waiting.insert(socket, files);
+    emit openRequested(files);
+}
+
+void SingleInstance::release(const QString &filePath)
+{
+    const QFileInfo closed(filePath);
+    QList<QLocalSocket *> done;
+    for (auto it = waiting.begin(); it != waiting.end();) {
+        it->removeIf([&closed](const QString &file) { return QFileInfo(file) == closed; });
+        if (it->isEmpty()) {
+            done.append(it.key());
+            it = waiting.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    // Hanging up can emit disconnected() right away, so only after the loop
+    for (QLocalSocket *socket : done)
+        socket->disconnectFromServer();
+}
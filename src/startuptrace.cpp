@@ -0,0 +1,84 @@
+#include "startuptrace.h"
+#include <QEvent>
+#include <QTimer>
+#include <QWidget>
+#include <cstdio>
+
+QElapsedTimer StartupTrace::clock;
+QList<StartupTrace::Phase> StartupTrace::phases;
+bool StartupTrace::enabled = false;
+
+namespace {
+
+// A window that never paints (started minimised, say) still gets its
+// deferred work after FALLBACK_DELAY
+class FirstFrameWatcher : public QObject
+{
+public:
+    FirstFrameWatcher(QWidget *window, const std::function<void()> &next)
+        : QObject(window), window(window), next(next)
+    {
+        window->installEventFilter(this);
+        QTimer::singleShot(FALLBACK_DELAY, this, [this]() { run("no frame yet"); });
+    }
+
+protected:
+    bool eventFilter(QObject *, QEvent *event) override
+    {
+        if (event->type() == QEvent::Paint)
+            run("first frame");
+        return false;
+    }
+
+private:
+    void run(const char *phase)
+    {
+        if (done)
+            return;
+        done = true;
+        window->removeEventFilter(this);
+        StartupTrace::mark(phase);
+        // Queued, so the frame is on screen before anything else runs
+        QTimer::singleShot(0, window, next);
+        deleteLater();
+    }
+
+    QWidget *window;
+    std::function<void()> next;
+    bool done = false;
+
+    static const int FALLBACK_DELAY = 1000; // ms
+};
+
+} // namespace
+
+void StartupTrace::start()
+{
+    clock.start();
+    phases.clear();
+}
+
+void StartupTrace::mark(const char *phase)
+{
+    if (clock.isValid())
+        phases.append({phase, clock.nsecsElapsed()});
+}
+
+void StartupTrace::finish()
+{
+    if (!enabled)
+        return;
+    std::fprintf(stderr, "Startup trace (ms):\n");
+    qint64 previous = 0;
+    for (const Phase &phase : std::as_const(phases)) {
+        std::fprintf(stderr, "%9.2f %+9.2f  %s\n",
+                     phase.end / 1e6, (phase.end - previous) / 1e6, phase.name);
+        previous = phase.end;
+    }
+    phases.clear();
+}
+
+void StartupTrace::afterFirstFrame(QWidget *window, const std::function<void()> &next)
+{
+    new FirstFrameWatcher(window, next);
+}
@@ -1,9 +1,30 @@
 #include "syntax/syntaxhighlighter.h"
+#include "profiler.h"
 #include <QJsonDocument>
 #include <QJsonObject>
 #include <QJsonArray>
 #include <QFile>
 
+namespace {
+
+// Definitions are parsed once per process and shared by every editor
+QJsonObject languageSource(const QString &language)
+{
+    static QHash<QString, QJsonObject> sources;
+    auto it = sources.constFind(language);
+    if (it != sources.constEnd())
+        return *it;
+
+    QJsonObject root;
+    QFile file(QString(":/syntax/%1.json").arg(language.toLower()));
+    if (file.open(QIODevice::ReadOnly))
+        root = QJsonDocument::fromJson(file.readAll()).object();
+    sources.insert(language, root);
+    return root;
+}
+
+} // namespace
+
 SyntaxHighlighter::SyntaxHighlighter(QTextDocument *parent)
     : QSyntaxHighlighter(parent),
       multiLineCommentStartIndex(-1),
@@ -76,6 +97,9 @@ void SyntaxHighlighter::createLanguageMap()
 void SyntaxHighlighter::setLanguage(const QString &extension)
 {
     QString language = extensionToLanguage.value(extension.toLower(), "Text");
+    // Text already in the document was highlighted with this language as it went in
+    if (language == currentLanguage.name)
+        return;
     loadLanguageDefinition(language);
     rehighlight();
 }
@@ -86,16 +110,9 @@ void SyntaxHighlighter::loadLanguageDefinition(const QString &language)
     currentLanguage = LanguageDefinition();
     currentLanguage.name = language;
 
-    // Load language definition from JSON file
-    QString filename = QString(":/syntax/%1.json").arg(language.toLower());
-    QFile file(filename);
-    
-    if (!file.open(QIODevice::ReadOnly)) {
+    const QJsonObject root = languageSource(language);
+    if (root.isEmpty())
         return;
-    }
-
-    QJsonDocument doc = QJsonDocument::fromJson(file.readAll());
-    QJsonObject root = doc.object();
 
     // Load keywords
     QJsonArray keywords = root["keywords"].toArray();
@@ -144,15 +161,15 @@ void SyntaxHighlighter::loadLanguageDefinition(const QString &language)
         
         // Set format based on type
         QString type = ruleObj["type"].toString();
-        if (type == "keyword") rule.format = keywordFormat;
-        else if (type == "type") rule.format = typeFormat;
-        else if (type == "literal") rule.format = literalFormat;
-        else if (type == "builtin") rule.format = builtinFormat;
-        else if (type == "comment") rule.format = commentFormat;
-        else if (type == "string") rule.format = quotationFormat;
-        else if (type == "function") rule.format = functionFormat;
-        else if (type == "operator") rule.format = operatorFormat;
-        else if (type == "number") rule.format = numberFormat;
+        if (type == "keyword") { rule.format = keywordFormat; rule.tokenClass = TokenClass::Keyword; }
+        else if (type == "type") { rule.format = typeFormat; rule.tokenClass = TokenClass::Type; }
+        else if (type == "literal") { rule.format = literalFormat; rule.tokenClass = TokenClass::Literal; }
+        else if (type == "builtin") { rule.format = builtinFormat; rule.tokenClass = TokenClass::Builtin; }
+        else if (type == "comment") { rule.format = commentFormat; rule.tokenClass = TokenClass::Comment; }
+        else if (type == "string") { rule.format = quotationFormat; rule.tokenClass = TokenClass::String; }
+        else if (type == "function") { rule.format = functionFormat; rule.tokenClass = TokenClass::Function; }
+        else if (type == "operator") { rule.format = operatorFormat; rule.tokenClass = TokenClass::Operator; }
+        else if (type == "number") { rule.format = numberFormat; rule.tokenClass = TokenClass::Number; }
 
         currentLanguage.rules.append(rule);
     }
@@ -175,6 +192,44 @@ void SyntaxHighlighter::updateTheme(const QColor &defaultForeground)
 }
 
 void SyntaxHighlighter::highlightBlock(const QString &text)
+{
+    PROFILE_SCOPE(Highlight);
+    pendingTokens.clear();
+    highlightTokens(text);
+
+    // Keep the runs with the block so views like the minimap can reuse them
+    BlockData *data = static_cast<BlockData *>(currentBlockUserData());
+    if (!data) {
+        data = new BlockData;
+        setCurrentBlockUserData(data);
+    }
+    data->tokens = pendingTokens;
+}
+
+void SyntaxHighlighter::applyFormat(int start, int count, const QTextCharFormat &format,
+                                    TokenClass tokenClass)
+{
+    setFormat(start, count, format);
+    pendingTokens.append({start, count, tokenClass});
+}
+
+QColor SyntaxHighlighter::tokenColor(TokenClass tokenClass) const
+{
+    switch (tokenClass) {
+    case TokenClass::Keyword: return keywordFormat.foreground().color();
+    case TokenClass::Type: return typeFormat.foreground().color();
+    case TokenClass::Literal: return literalFormat.foreground().color();
+    case TokenClass::Builtin: return builtinFormat.foreground().color();
+    case TokenClass::Comment: return commentFormat.foreground().color();
+    case TokenClass::String: return quotationFormat.foreground().color();
+    case TokenClass::Function: return functionFormat.foreground().color();
+    case TokenClass::Operator: return operatorFormat.foreground().color();
+    case TokenClass::Number: return numberFormat.foreground().color();
+    default: return QColor();
+    }
+}
+
+void SyntaxHighlighter::highlightTokens(const QString &text)
 {
     // Handle multi-line comments
     highlightMultiLineComments(text);
@@ -186,7 +241,7 @@ void SyntaxHighlighter::highlightBlock(const QString &text)
     if (!currentLanguage.singleLineComment.isEmpty()) {
         int commentStart = text.indexOf(currentLanguage.singleLineComment);
         if (commentStart >= 0) {
-            setFormat(commentStart, text.length() - commentStart, commentFormat);
+            applyFormat(commentStart, text.length() - commentStart, commentFormat, TokenClass::Comment);
             return;
         }
     }
@@ -196,7 +251,7 @@ void SyntaxHighlighter::highlightBlock(const QString &text)
         QRegularExpressionMatchIterator matchIterator = rule.pattern.globalMatch(text);
         while (matchIterator.hasNext()) {
             QRegularExpressionMatch match = matchIterator.next();
-            setFormat(match.capturedStart(), match.capturedLength(), rule.format);
+            applyFormat(match.capturedStart(), match.capturedLength(), rule.format, rule.tokenClass);
         }
     }
 
@@ -205,21 +260,21 @@ void SyntaxHighlighter::highlightBlock(const QString &text)
     QRegularExpressionMatchIterator numberMatches = numberRegex.globalMatch(text);
     while (numberMatches.hasNext()) {
         QRegularExpressionMatch match = numberMatches.next();
-        setFormat(match.capturedStart(), match.capturedLength(), numberFormat);
+        applyFormat(match.capturedStart(), match.capturedLength(), numberFormat, TokenClass::Number);
     }
 
     // Functions
     QRegularExpressionMatchIterator functionMatches = functionRegex.globalMatch(text);
     while (functionMatches.hasNext()) {
         QRegularExpressionMatch match = functionMatches.next();
-        setFormat(match.capturedStart(), match.capturedLength(), functionFormat);
+        applyFormat(match.capturedStart(), match.capturedLength(), functionFormat, TokenClass::Function);
     }
 
     // Operators
     QRegularExpressionMatchIterator operatorMatches = operatorRegex.globalMatch(text);
     while (operatorMatches.hasNext()) {
         QRegularExpressionMatch match = operatorMatches.next();
-        setFormat(match.capturedStart(), match.capturedLength(), operatorFormat);
+        applyFormat(match.capturedStart(), match.capturedLength(), operatorFormat, TokenClass::Operator);
     }
 
     // Keywords
@@ -228,7 +283,7 @@ void SyntaxHighlighter::highlightBlock(const QString &text)
         QRegularExpressionMatchIterator matches = keywordRegex.globalMatch(text);
         while (matches.hasNext()) {
             QRegularExpressionMatch match = matches.next();
-            setFormat(match.capturedStart(), match.capturedLength(), keywordFormat);
+            applyFormat(match.capturedStart(), match.capturedLength(), keywordFormat, TokenClass::Keyword);
         }
     }
 
@@ -238,7 +293,7 @@ void SyntaxHighlighter::highlightBlock(const QString &text)
         QRegularExpressionMatchIterator matches = typeRegex.globalMatch(text);
         while (matches.hasNext()) {
             QRegularExpressionMatch match = matches.next();
-            setFormat(match.capturedStart(), match.capturedLength(), typeFormat);
+            applyFormat(match.capturedStart(), match.capturedLength(), typeFormat, TokenClass::Type);
         }
     }
 
@@ -248,7 +303,7 @@ void SyntaxHighlighter::highlightBlock(const QString &text)
         QRegularExpressionMatchIterator matches = builtinRegex.globalMatch(text);
         while (matches.hasNext()) {
             QRegularExpressionMatch match = matches.next();
-            setFormat(match.capturedStart(), match.capturedLength(), builtinFormat);
+            applyFormat(match.capturedStart(), match.capturedLength(), builtinFormat, TokenClass::Builtin);
         }
     }
 }
@@ -268,13 +323,13 @@ void SyntaxHighlighter::highlightMultiLineComments(const QString &text)
         int endIndex = text.indexOf(currentLanguage.multiLineCommentEnd);
         if (endIndex == -1) {
             // Comment continues to next block
-            setFormat(0, text.length(), commentFormat);
+            applyFormat(0, text.length(), commentFormat, TokenClass::Comment);
             setCurrentBlockState(1);
             return;
         }
         // Found end of comment
         endIndex += currentLanguage.multiLineCommentEnd.length();
-        setFormat(0, endIndex, commentFormat);
+        applyFormat(0, endIndex, commentFormat, TokenClass::Comment);
         startIndex = endIndex;
         isInMultiLineComment = false;
     }
@@ -299,7 +354,7 @@ void SyntaxHighlighter::highlightMultiLineComments(const QString &text)
             isInMultiLineComment = false;
         }
 
-        setFormat(commentStart, commentLength, commentFormat);
+        applyFormat(commentStart, commentLength, commentFormat, TokenClass::Comment);
         startIndex = (commentEnd == -1) ? -1 : commentEnd + currentLanguage.multiLineCommentEnd.length();
     }
 } 
\ No newline at end of file